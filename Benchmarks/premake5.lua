@@ -0,0 +1,106 @@
+project "KernelBenchmark"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++20"
+   staticruntime "off"
+
+   files
+   {
+      "src/KernelBenchmark.cpp",
+
+      "../RayTracing/src/RayTracingHelper.h",
+      "../RayTracing/src/RayTracingHelper.cpp",
+   }
+
+   includedirs
+   {
+      "../Walnut/vendor/glm",
+
+      "../Vendor",
+      "../RayTracing/src",
+   }
+
+   targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+   objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+   filter "system:windows"
+      systemversion "latest"
+
+   filter "configurations:Debug"
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   filter "configurations:Dist"
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
+
+project "RenderBenchmark"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++20"
+   staticruntime "off"
+
+   -- The whole renderer minus the app entry point, rendered headlessly
+   files
+   {
+      "src/RenderBenchmark.cpp",
+
+      "../RayTracing/src/**.h",
+      "../RayTracing/src/**.cpp",
+   }
+
+   -- Like RayTracingHeadless, without the window, its panels and the GPU image
+   removefiles
+   {
+      "../RayTracing/src/WalnutApp.cpp",
+      "../RayTracing/src/CameraInput.cpp",
+      "../RayTracing/src/ViewportImage.h",
+      "../RayTracing/src/ViewportImage.cpp",
+      "../RayTracing/src/*Panel.h",
+      "../RayTracing/src/*Panel.cpp",
+   }
+
+   includedirs
+   {
+      "../Walnut/vendor/glm",
+
+      "../Walnut/Walnut/src",
+
+      "../Vendor",
+      "../RayTracing/src",
+   }
+
+   targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+   objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+   filter "system:windows"
+      systemversion "latest"
+      defines { "WL_PLATFORM_WINDOWS" }
+      links { "Psapi", "Ws2_32" }
+
+   -- libstdc++ runs the parallel algorithms on TBB
+   filter "system:linux"
+      links { "tbb", "pthread" }
+
+   filter "configurations:Debug"
+      defines { "WL_DEBUG" }
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      defines { "WL_RELEASE" }
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   filter "configurations:Dist"
+      defines { "WL_DIST" }
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
@@ -0,0 +1,282 @@
+// Microbenchmarks for the intersection kernels in RayTracingHelper.
+// Every kernel runs over prebuilt hit-heavy, miss-heavy and grazing ray sets, results are printed as a table
+// and optionally written as JSON (--json <file>) so runs can be compared between builds.
+
+#include "RayTracingHelper.h"
+
+#include <glm/glm.hpp>
+
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+   struct BenchmarkResult
+   {
+      std::string Kernel;
+      std::string Distribution;
+      uint64_t Tests = 0;
+      double Seconds = 0.0;
+      double HitRate = 0.0;
+
+      double GetNsPerTest() const { return (Seconds * 1e9) / Tests; }
+      double GetTestsPerSecond() const { return Tests / Seconds; }
+   };
+
+   struct Options
+   {
+      uint32_t RayCount = 1 << 16;
+      uint32_t Repetitions = 64;
+      std::string JsonPath = {};
+   };
+
+   class RandomSource
+   {
+   public:
+      RandomSource(uint32_t seed) : m_Engine(seed) {}
+
+      float Float(float min, float max) { return std::uniform_real_distribution<float>(min, max)(m_Engine); }
+      glm::vec3 Vec3(float min, float max) { return glm::vec3(Float(min, max), Float(min, max), Float(min, max)); }
+      glm::vec3 UnitVector()
+      {
+         glm::vec3 v;
+         do
+         {
+            v = Vec3(-1.0f, 1.0f);
+         } while (glm::dot(v, v) < 1e-4f || glm::dot(v, v) > 1.0f);
+         return glm::normalize(v);
+      }
+   private:
+      std::mt19937 m_Engine;
+   };
+
+   // Runs the kernel over all rays 'repetitions' times. The kernel returns true on a hit
+   BenchmarkResult Run(const std::string& kernel, const std::string& distribution, const std::vector<Ray>& rays, uint32_t repetitions,
+                       const std::function<bool(const Ray&)>& test)
+   {
+      // Warm up caches and branch predictors
+      uint64_t hits = 0;
+      for (const Ray& ray : rays)
+      {
+         hits += test(ray) ? 1 : 0;
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      uint64_t sink = 0;
+      for (uint32_t repetition = 0; repetition < repetitions; repetition++)
+      {
+         for (const Ray& ray : rays)
+         {
+            sink += test(ray) ? 1 : 0;
+         }
+      }
+      auto end = std::chrono::steady_clock::now();
+
+      BenchmarkResult result;
+      result.Kernel = kernel;
+      result.Distribution = distribution;
+      result.Tests = (uint64_t)rays.size() * repetitions;
+      result.Seconds = std::chrono::duration<double>(end - start).count();
+      result.HitRate = (double)sink / result.Tests;
+      return result;
+   }
+
+   // [Sphere] unit sphere at the origin, rays start outside of it
+   std::vector<Ray> MakeSphereRays(const std::string& distribution, uint32_t count, RandomSource& random)
+   {
+      std::vector<Ray> rays(count);
+      for (Ray& ray : rays)
+      {
+         ray.Origin = random.UnitVector() * random.Float(2.0f, 10.0f);
+
+         // Pick the distance at which the ray passes the center, the sphere is hit below a distance of 1
+         glm::vec3 toCenter = glm::normalize(-ray.Origin);
+         glm::vec3 tangent = glm::normalize(glm::cross(toCenter, random.UnitVector()));
+
+         float offset = 0.0f;
+         if (distribution == "hit")
+         {
+            offset = random.Float(0.0f, 0.9f);
+         }
+         else if (distribution == "miss")
+         {
+            offset = random.Float(1.1f, 4.0f);
+         }
+         else // grazing
+         {
+            offset = random.Float(0.99f, 1.01f);
+         }
+
+         float distanceToCenter = glm::length(ray.Origin);
+         ray.Direction = glm::normalize(toCenter * glm::sqrt(distanceToCenter * distanceToCenter - offset * offset) + tangent * offset);
+      }
+      return rays;
+   }
+
+   // [Triangle] same triangle as the example scene, its front face looks down +z
+   std::vector<Ray> MakeTriangleRays(const std::string& distribution, uint32_t count, RandomSource& random, const Vertex triangle[])
+   {
+      std::vector<Ray> rays(count);
+      for (Ray& ray : rays)
+      {
+         glm::vec3 target;
+         if (distribution == "miss")
+         {
+            // Points of the plane outside of the triangle
+            do
+            {
+               target = glm::vec3(random.Float(-3.0f, 3.0f), random.Float(-3.0f, 3.0f), 0.0f);
+            } while (target.x > -1.0f && target.x < 1.0f && target.y > -1.0f && target.y < target.x);
+         }
+         else
+         {
+            // Uniform barycentric point inside the triangle
+            float u = random.Float(0.0f, 1.0f);
+            float v = random.Float(0.0f, 1.0f);
+            if (u + v > 1.0f)
+            {
+               u = 1.0f - u;
+               v = 1.0f - v;
+            }
+            target = triangle[0].m_Position + u * (triangle[1].m_Position - triangle[0].m_Position) + v * (triangle[2].m_Position - triangle[0].m_Position);
+         }
+
+         glm::vec3 direction = glm::normalize(glm::vec3(random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), -1.0f));
+         if (distribution == "grazing")
+         {
+            // Nearly parallel to the plane
+            glm::vec3 inPlane = glm::normalize(glm::vec3(random.Float(-1.0f, 1.0f), random.Float(-1.0f, 1.0f), 0.0f));
+            direction = glm::normalize(inPlane + glm::vec3(0.0f, 0.0f, -random.Float(0.002f, 0.05f)));
+         }
+
+         ray.Origin = target - direction * random.Float(1.0f, 10.0f);
+         ray.Direction = direction;
+      }
+      return rays;
+   }
+
+   void PrintUsage()
+   {
+      printf("Usage: KernelBenchmark [--rays N] [--repetitions N] [--json file]\n");
+   }
+
+   // A whole positive number, nothing before or after it
+   bool ParseCount(const char* text, uint32_t& outValue)
+   {
+      const char* end = text + strlen(text);
+      uint32_t value = 0;
+      auto [last, error] = std::from_chars(text, end, value);
+      if (error != std::errc() || last != end || value == 0)
+      {
+         return false;
+      }
+      outValue = value;
+      return true;
+   }
+
+   Options ParseOptions(int argc, char** argv)
+   {
+      Options options;
+      for (int i = 1; i < argc; i++)
+      {
+         bool valid = true;
+         if (strcmp(argv[i], "--rays") == 0 && i + 1 < argc)
+         {
+            valid = ParseCount(argv[++i], options.RayCount);
+         }
+         else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+         {
+            valid = ParseCount(argv[++i], options.Repetitions);
+         }
+         else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+         {
+            options.JsonPath = argv[++i];
+         }
+         else
+         {
+            PrintUsage();
+            exit(1);
+         }
+
+         if (not valid)
+         {
+            printf("Invalid value '%s' for %s, expected a whole number above 0\n", argv[i], argv[i - 1]);
+            PrintUsage();
+            exit(1);
+         }
+      }
+      return options;
+   }
+
+   void WriteJson(const std::string& filepath, const Options& options, const std::vector<BenchmarkResult>& results)
+   {
+      std::ofstream file(filepath);
+      file << "{\n  \"rays\": " << options.RayCount << ",\n  \"repetitions\": " << options.Repetitions << ",\n  \"results\": [\n";
+      for (size_t i = 0; i < results.size(); i++)
+      {
+         const BenchmarkResult& result = results[i];
+         file << "    { \"kernel\": \"" << result.Kernel << "\", \"distribution\": \"" << result.Distribution << "\""
+              << ", \"tests\": " << result.Tests
+              << ", \"ns_per_test\": " << result.GetNsPerTest()
+              << ", \"tests_per_second\": " << result.GetTestsPerSecond()
+              << ", \"hit_rate\": " << result.HitRate << " }" << ((i + 1 < results.size()) ? ",\n" : "\n");
+      }
+      file << "  ]\n}\n";
+   }
+}
+
+int main(int argc, char** argv)
+{
+   Options options = ParseOptions(argc, argv);
+
+   Vertex triangle[3];
+   triangle[0].m_Position = glm::vec3(1.0f, 1.0f, 0.0f);    //Top Right
+   triangle[1].m_Position = glm::vec3(-1.0f, -1.0f, 0.0f);  //Bottom Left
+   triangle[2].m_Position = glm::vec3(1.0f, -1.0f, 0.0f);   //Bottom Right
+   glm::vec3 normal = glm::normalize(glm::cross(triangle[0].m_Position - triangle[1].m_Position, triangle[0].m_Position - triangle[2].m_Position));
+   triangle[0].m_Normal = triangle[1].m_Normal = triangle[2].m_Normal = normal;
+
+   std::vector<BenchmarkResult> results;
+   const char* distributions[] = { "hit", "miss", "grazing" };
+
+   for (const char* distribution : distributions)
+   {
+      RandomSource random(1234);
+
+      std::vector<Ray> sphereRays = MakeSphereRays(distribution, options.RayCount, random);
+      results.push_back(Run("RaySphereIntersection", distribution, sphereRays, options.Repetitions,
+         [](const Ray& ray) { return RayTracingHelper::RaySphereIntersection(ray, glm::vec3(0.0f), 1.0f) >= 0.0f; }));
+
+      std::vector<Ray> triangleRays = MakeTriangleRays(distribution, options.RayCount, random, triangle);
+      results.push_back(Run("RayTriangleIntersection", distribution, triangleRays, options.Repetitions,
+         [&triangle](const Ray& ray) { return RayTracingHelper::RayTriangleIntersection(ray, triangle) >= 0.0f; }));
+      results.push_back(Run("RayTriangleIntersection(pos)", distribution, triangleRays, options.Repetitions,
+         [&triangle](const Ray& ray) { return RayTracingHelper::RayTriangleIntersection(ray, triangle[0].m_Position, triangle[1].m_Position, triangle[2].m_Position) >= 0.0f; }));
+
+      // IsPerpendicular against the triangle normal: "hit" means perpendicular
+      results.push_back(Run("IsPerpendicular", distribution, triangleRays, options.Repetitions,
+         [&normal](const Ray& ray) { return RayTracingHelper::IsPerpendicular(ray.Direction, normal); }));
+   }
+
+   printf("%-28s %-10s %12s %16s %10s\n", "Kernel", "Rays", "ns/test", "Mtests/s", "Hit rate");
+   for (const BenchmarkResult& result : results)
+   {
+      printf("%-28s %-10s %12.3f %16.2f %9.1f%%\n", result.Kernel.c_str(), result.Distribution.c_str(),
+             result.GetNsPerTest(), result.GetTestsPerSecond() * 1e-6, result.HitRate * 100.0);
+   }
+
+   if (not options.JsonPath.empty())
+   {
+      WriteJson(options.JsonPath, options, results);
+      printf("Wrote %s\n", options.JsonPath.c_str());
+   }
+
+   return 0;
+}
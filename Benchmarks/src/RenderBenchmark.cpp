@@ -0,0 +1,571 @@
+// End-to-end benchmark of the renderer on the canonical scenes of SceneLibrary.
+// Every scene is rendered headlessly from a fixed camera pose (or along a fixed orbit) for N samples, reporting
+// ms/frame, Mrays/s, peak memory and the RMSE against a stored reference image (PFM, --write-references creates them).
+// A static run fails when a reference is missing, --no-references measures the speed alone.
+// Binary scene files (--scene-file) are benchmarked the same way, their setup time is the load time.
+// --bvh both renders every scene with the binary and the 4-wide BVH layout, to compare their speed and memory.
+// Mesh BVHs come from the on-disk BVH cache after the first run, --bvh-cache off measures the builds every time.
+// Results are printed as a table and optionally written as JSON (--json <file>) so runs can be compared between builds.
+
+#include "Camera.h"
+#include "ImageWriter.h"
+#include "Profiler.h"
+#include "Acceleration/BVHCache.h"
+#include "Renderer.h"
+#include "Scene/Scene.h"
+#include "Scene/SceneBinarySerializer.h"
+#include "Scene/SceneLibrary.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <cfloat>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+   #define NOMINMAX
+   #include <Windows.h>
+   #include <Psapi.h>
+#else
+   #include <sys/resource.h>
+#endif
+
+namespace
+{
+   enum class CameraPath
+   {
+      Static = 0, // Accumulates all samples from the scene's pose, the result is compared to the reference
+      Orbit,      // Moves a bit every frame (accumulation restarts), like a user flying around
+   };
+
+   enum class BVHLayout
+   {
+      Binary = 0,
+      Wide,
+   };
+
+   const char* GetLayoutName(BVHLayout layout)
+   {
+      return (layout == BVHLayout::Wide) ? "wide" : "binary";
+   }
+
+   struct SceneSource
+   {
+      std::string Name;
+      CanonicalScene Canonical = CanonicalScene::Default; // Also decides the camera pose of scene files
+      std::string Filepath = {};                          // Empty for canonical scenes
+   };
+
+   struct Options
+   {
+      std::vector<SceneSource> Scenes;
+      uint32_t Width = 640;
+      uint32_t Height = 360;
+      uint32_t Samples = 64;
+      CameraPath Path = CameraPath::Static;
+      std::string ReferenceDirectory = "references";
+      bool WriteReferences = false;
+      bool CompareReferences = true;
+      std::string JsonPath = {};
+      std::string BVHCacheDirectory = BVHCache::GetDirectory(); // Empty disables the cache
+      std::vector<BVHLayout> Layouts = { BVHLayout::Wide };
+   };
+
+   struct BenchmarkResult
+   {
+      std::string Scene;
+      BVHLayout Layout = BVHLayout::Wide;
+      uint32_t Frames = 0;
+      double SetupMs = 0.0;  // Populating the scene, including the mesh BVH builds (or cache loads)
+      double TotalMs = 0.0;
+      double FastestFrameMs = 0.0;
+      uint64_t Rays = 0;
+      uint64_t PeakMemoryBytes = 0;
+      uint64_t BVHBytes = 0; // Sphere and mesh BVHs in the layout rendered with
+      double RMSE = -1.0; // Negative when there is no reference to compare against
+      bool Loaded = true; // False when the scene file couldn't be loaded, nothing was rendered then
+
+      double GetMsPerFrame() const { return (Frames > 0) ? TotalMs / Frames : 0.0; }
+      double GetMraysPerSecond() const { return (TotalMs > 0.0) ? (Rays / (TotalMs * 1e-3)) * 1e-6 : 0.0; }
+   };
+
+   // Process wide peak (never decreases), run one --scene at a time for per-scene numbers
+   uint64_t GetPeakMemoryBytes()
+   {
+#if defined(_WIN32)
+      PROCESS_MEMORY_COUNTERS counters;
+      if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+      {
+         return (uint64_t)counters.PeakWorkingSetSize;
+      }
+      return 0;
+#else
+      rusage usage;
+      getrusage(RUSAGE_SELF, &usage);
+   #if defined(__APPLE__)
+      return (uint64_t)usage.ru_maxrss;        // Bytes
+   #else
+      return (uint64_t)usage.ru_maxrss * 1024; // Kilobytes
+   #endif
+#endif
+   }
+
+   // Resolved linear color of every pixel, rows bottom to top like the accumulation buffer (and PFM)
+   std::vector<glm::vec3> ResolveImage(const Renderer& renderer)
+   {
+      const uint32_t pixelCount = renderer.GetWidth() * renderer.GetHeight();
+      const AccumulationBuffer& accumulation = renderer.GetAccumulation();
+
+      std::vector<glm::vec3> image(pixelCount);
+      for (uint32_t i = 0; i < pixelCount; i++)
+      {
+         image[i] = accumulation.GetColor(i);
+      }
+      return image;
+   }
+
+   bool ReadPFM(const std::string& filepath, uint32_t& outWidth, uint32_t& outHeight, std::vector<glm::vec3>& outImage)
+   {
+      std::ifstream file(filepath, std::ios::binary);
+      if (not file)
+      {
+         return false;
+      }
+
+      std::string magic;
+      float scale = 0.0f;
+      file >> magic >> outWidth >> outHeight >> scale;
+      file.get(); // Single whitespace before the data
+      if (magic != "PF" || scale >= 0.0f)
+      {
+         printf("%s: only little endian RGB PFM files are supported\n", filepath.c_str());
+         return false;
+      }
+
+      outImage.resize((size_t)outWidth * outHeight);
+      file.read((char*)outImage.data(), outImage.size() * sizeof(glm::vec3));
+      return (bool)file;
+   }
+
+   double ComputeRMSE(const std::vector<glm::vec3>& image, const std::vector<glm::vec3>& reference)
+   {
+      double sum = 0.0;
+      for (size_t i = 0; i < image.size(); i++)
+      {
+         glm::vec3 difference = image[i] - reference[i];
+         sum += (double)glm::dot(difference, difference);
+      }
+      return glm::sqrt(sum / (image.size() * 3.0));
+   }
+
+   std::string GetReferencePath(const Options& options, const std::string& sceneName)
+   {
+      return options.ReferenceDirectory + "/" + sceneName + "_" +
+             std::to_string(options.Width) + "x" + std::to_string(options.Height) + ".pfm";
+   }
+
+   // The camera of frame 'frame' out of 'frameCount', fully determined by the scene and the path
+   void PlaceCamera(Camera& camera, CanonicalScene scene, CameraPath path, uint32_t frame, uint32_t frameCount)
+   {
+      SceneLibrary::CameraPose pose = SceneLibrary::GetCameraPose(scene);
+      glm::vec3 position = pose.Position;
+
+      if (path == CameraPath::Orbit)
+      {
+         // A quarter turn around the target over the whole run
+         float angle = glm::half_pi<float>() * (float)frame / (float)glm::max(frameCount, 1u);
+         glm::vec3 offset = pose.Position - pose.Target;
+         position.x = pose.Target.x + offset.x * glm::cos(angle) - offset.z * glm::sin(angle);
+         position.z = pose.Target.z + offset.x * glm::sin(angle) + offset.z * glm::cos(angle);
+      }
+
+      camera.SetView(position, pose.Target - position);
+   }
+
+   BenchmarkResult RunScene(const SceneSource& source, BVHLayout layout, const Options& options)
+   {
+      BenchmarkResult result;
+      result.Scene = source.Name;
+      result.Layout = layout;
+
+      auto setupStart = std::chrono::steady_clock::now();
+      Scene scene;
+      scene.SetWideBVH(layout == BVHLayout::Wide);
+      if (source.Filepath.empty())
+      {
+         SceneLibrary::Populate(scene, source.Canonical);
+      }
+      else if (not SceneBinarySerializer(&scene).Deserialize(source.Filepath))
+      {
+         printf("Failed to load %s\n", source.Filepath.c_str());
+         result.Loaded = false;
+         return result;
+      }
+      result.SetupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupStart).count();
+
+      Renderer renderer(true);
+      renderer.GetSettings().WideBVH = (layout == BVHLayout::Wide);
+      Camera camera(45.0f, 0.1f, 100.0f);
+      // Jittered samples generate their own rays, caching directions would only add to every frame of a moving camera
+      camera.SetRayGenerationMode(RayGenerationMode::OnTheFly);
+      renderer.Resize(options.Width, options.Height);
+      camera.Resize(options.Width, options.Height);
+
+      result.FastestFrameMs = DBL_MAX;
+      for (uint32_t frame = 0; frame < options.Samples; frame++)
+      {
+         if (frame == 0 || options.Path == CameraPath::Orbit)
+         {
+            PlaceCamera(camera, source.Canonical, options.Path, frame, options.Samples);
+            renderer.ResetFrameIndex();
+         }
+
+         auto frameStart = std::chrono::steady_clock::now();
+         renderer.Render(scene, camera);
+         double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+         Profiler::EndFrame();
+
+         result.Frames++;
+         result.TotalMs += frameMs;
+         result.FastestFrameMs = glm::min(result.FastestFrameMs, frameMs);
+#if RT_ENABLE_RAY_STATISTICS
+         result.Rays += renderer.GetRayStatistics().GetRays();
+#endif
+      }
+
+      result.PeakMemoryBytes = GetPeakMemoryBytes();
+      result.BVHBytes = renderer.GetBVHMemory();
+
+      // Only a converged static image can be compared, the orbit ends up with one sample of the last pose
+      if (options.Path != CameraPath::Static || (not options.WriteReferences && not options.CompareReferences))
+      {
+         return result;
+      }
+
+      std::vector<glm::vec3> image = ResolveImage(renderer);
+      std::string referencePath = GetReferencePath(options, source.Name);
+      if (options.WriteReferences)
+      {
+         if (not ImageWriter::WritePFM(referencePath, image.data(), options.Width, options.Height))
+         {
+            printf("Failed to write %s\n", referencePath.c_str());
+         }
+         return result;
+      }
+
+      uint32_t referenceWidth = 0, referenceHeight = 0;
+      std::vector<glm::vec3> reference;
+      if (ReadPFM(referencePath, referenceWidth, referenceHeight, reference))
+      {
+         if (referenceWidth == options.Width && referenceHeight == options.Height)
+         {
+            result.RMSE = ComputeRMSE(image, reference);
+         }
+         else
+         {
+            printf("%s is %ux%u, expected %ux%u\n", referencePath.c_str(), referenceWidth, referenceHeight, options.Width, options.Height);
+         }
+      }
+
+      return result;
+   }
+
+   void PrintUsage()
+   {
+      printf("Usage: RenderBenchmark [--scene name|all] [--width N] [--height N] [--samples N] [--path static|orbit]\n"
+             "                       [--scene-file file.rtscene] [--references dir] [--write-references | --no-references]\n"
+             "                       [--json file] [--bvh-cache dir|off] [--bvh binary|wide|both]\n"
+             "Scenes:");
+      for (uint32_t i = 0; i < (uint32_t)CanonicalScene::Count; i++)
+      {
+         printf(" %s", SceneLibrary::GetName((CanonicalScene)i));
+      }
+      printf("\n");
+   }
+
+   // A whole positive number, nothing before or after it
+   bool ParseCount(const char* text, uint32_t& outValue)
+   {
+      const char* end = text + strlen(text);
+      uint32_t value = 0;
+      auto [last, error] = std::from_chars(text, end, value);
+      if (error != std::errc() || last != end || value == 0)
+      {
+         return false;
+      }
+      outValue = value;
+      return true;
+   }
+
+   Options ParseOptions(int argc, char** argv)
+   {
+      Options options;
+      for (int i = 1; i < argc; i++)
+      {
+         bool valid = true;
+         if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+         {
+            std::string name = argv[++i];
+            CanonicalScene scene;
+            if (name == "all")
+            {
+               for (uint32_t scene = 0; scene < (uint32_t)CanonicalScene::Count; scene++)
+               {
+                  options.Scenes.push_back({ SceneLibrary::GetName((CanonicalScene)scene), (CanonicalScene)scene });
+               }
+            }
+            else if (SceneLibrary::FromName(name, scene))
+            {
+               options.Scenes.push_back({ name, scene });
+            }
+            else
+            {
+               printf("Unknown scene '%s'\n", name.c_str());
+               PrintUsage();
+               exit(1);
+            }
+         }
+         else if (strcmp(argv[i], "--scene-file") == 0 && i + 1 < argc)
+         {
+            std::string filepath = argv[++i];
+            if (not std::filesystem::is_regular_file(filepath))
+            {
+               printf("Scene file '%s' doesn't exist\n", filepath.c_str());
+               exit(1);
+            }
+            options.Scenes.push_back({ std::filesystem::path(filepath).stem().string(), CanonicalScene::Default, filepath });
+         }
+         else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+         {
+            valid = ParseCount(argv[++i], options.Width);
+         }
+         else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc)
+         {
+            valid = ParseCount(argv[++i], options.Height);
+         }
+         else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+         {
+            valid = ParseCount(argv[++i], options.Samples);
+         }
+         else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc)
+         {
+            std::string path = argv[++i];
+            if (path == "static")
+            {
+               options.Path = CameraPath::Static;
+            }
+            else if (path == "orbit")
+            {
+               options.Path = CameraPath::Orbit;
+            }
+            else
+            {
+               printf("Unknown camera path '%s'\n", path.c_str());
+               PrintUsage();
+               exit(1);
+            }
+         }
+         else if (strcmp(argv[i], "--references") == 0 && i + 1 < argc)
+         {
+            options.ReferenceDirectory = argv[++i];
+         }
+         else if (strcmp(argv[i], "--write-references") == 0)
+         {
+            options.WriteReferences = true;
+         }
+         else if (strcmp(argv[i], "--no-references") == 0)
+         {
+            options.CompareReferences = false;
+         }
+         else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+         {
+            options.JsonPath = argv[++i];
+         }
+         else if (strcmp(argv[i], "--bvh") == 0 && i + 1 < argc)
+         {
+            std::string layout = argv[++i];
+            if (layout == "binary")
+            {
+               options.Layouts = { BVHLayout::Binary };
+            }
+            else if (layout == "wide")
+            {
+               options.Layouts = { BVHLayout::Wide };
+            }
+            else if (layout == "both")
+            {
+               options.Layouts = { BVHLayout::Binary, BVHLayout::Wide };
+            }
+            else
+            {
+               PrintUsage();
+               exit(1);
+            }
+         }
+         else if (strcmp(argv[i], "--bvh-cache") == 0 && i + 1 < argc)
+         {
+            options.BVHCacheDirectory = argv[++i];
+            if (options.BVHCacheDirectory == "off")
+            {
+               options.BVHCacheDirectory.clear();
+            }
+         }
+         else
+         {
+            PrintUsage();
+            exit(1);
+         }
+
+         if (not valid)
+         {
+            printf("Invalid value '%s' for %s, expected a whole number above 0\n", argv[i], argv[i - 1]);
+            PrintUsage();
+            exit(1);
+         }
+      }
+
+      if (options.Scenes.empty())
+      {
+         for (uint32_t i = 0; i < (uint32_t)CanonicalScene::Count; i++)
+         {
+            options.Scenes.push_back({ SceneLibrary::GetName((CanonicalScene)i), (CanonicalScene)i });
+         }
+      }
+
+      return options;
+   }
+
+   void WriteJson(const std::string& filepath, const Options& options, const std::vector<BenchmarkResult>& results)
+   {
+      std::ofstream file(filepath);
+      file << "{\n  \"width\": " << options.Width << ",\n  \"height\": " << options.Height << ",\n  \"samples\": " << options.Samples
+           << ",\n  \"path\": \"" << ((options.Path == CameraPath::Orbit) ? "orbit" : "static") << "\",\n  \"results\": [\n";
+      for (size_t i = 0; i < results.size(); i++)
+      {
+         const BenchmarkResult& result = results[i];
+         file << "    { \"scene\": \"" << result.Scene << "\""
+              << ", \"loaded\": " << (result.Loaded ? "true" : "false")
+              << ", \"bvh\": \"" << GetLayoutName(result.Layout) << "\""
+              << ", \"frames\": " << result.Frames
+              << ", \"setup_ms\": " << result.SetupMs
+              << ", \"ms_per_frame\": " << result.GetMsPerFrame()
+              << ", \"fastest_frame_ms\": " << result.FastestFrameMs
+              << ", \"mrays_per_second\": " << result.GetMraysPerSecond()
+              << ", \"peak_memory_bytes\": " << result.PeakMemoryBytes
+              << ", \"bvh_bytes\": " << result.BVHBytes
+              << ", \"rmse\": ";
+         if (result.RMSE >= 0.0)
+         {
+            file << result.RMSE;
+         }
+         else
+         {
+            file << "null";
+         }
+         file << " }" << ((i + 1 < results.size()) ? ",\n" : "\n");
+      }
+      file << "  ]\n}\n";
+   }
+}
+
+int main(int argc, char** argv)
+{
+   Options options = ParseOptions(argc, argv);
+   BVHCache::SetDirectory(options.BVHCacheDirectory);
+
+   if (options.WriteReferences)
+   {
+      std::filesystem::create_directories(options.ReferenceDirectory);
+   }
+   else if (options.Path == CameraPath::Static && options.CompareReferences)
+   {
+      // The references depend on the resolution, so they are only written on request, by a build known to render correctly
+      bool missing = false;
+      for (const SceneSource& scene : options.Scenes)
+      {
+         std::string referencePath = GetReferencePath(options, scene.Name);
+         if (not std::filesystem::exists(referencePath))
+         {
+            printf("Missing reference %s\n", referencePath.c_str());
+            missing = true;
+         }
+      }
+      if (missing)
+      {
+         printf("Create the references with --write-references on a known good build, or run with --no-references\n");
+         return 1;
+      }
+   }
+
+   std::vector<BenchmarkResult> results;
+   for (const SceneSource& scene : options.Scenes)
+   {
+      for (BVHLayout layout : options.Layouts)
+      {
+         printf("Rendering %s (%ux%u, %u samples, %s BVH)...\n", scene.Name.c_str(), options.Width, options.Height, options.Samples, GetLayoutName(layout));
+         results.push_back(RunScene(scene, layout, options));
+      }
+   }
+
+   printf("\n%-16s %-7s %10s %12s %12s %10s %12s %10s %10s\n", "Scene", "BVH", "Setup ms", "ms/frame", "Fastest ms", "Mrays/s", "Peak MB", "BVH MB", "RMSE");
+   for (const BenchmarkResult& result : results)
+   {
+      if (not result.Loaded)
+      {
+         printf("%-16s %-7s failed to load\n", result.Scene.c_str(), GetLayoutName(result.Layout));
+         continue;
+      }
+
+      char rmse[32] = "-";
+      if (result.RMSE >= 0.0)
+      {
+         snprintf(rmse, sizeof(rmse), "%.5f", result.RMSE);
+      }
+
+      printf("%-16s %-7s %10.1f %12.3f %12.3f %10.2f %12.1f %10.1f %10s\n", result.Scene.c_str(), GetLayoutName(result.Layout), result.SetupMs,
+             result.GetMsPerFrame(), result.FastestFrameMs, result.GetMraysPerSecond(), result.PeakMemoryBytes / (1024.0 * 1024.0),
+             result.BVHBytes / (1024.0 * 1024.0), rmse);
+   }
+
+   if (options.WriteReferences)
+   {
+      printf("Wrote references to %s\n", options.ReferenceDirectory.c_str());
+   }
+
+   if (not options.JsonPath.empty())
+   {
+      WriteJson(options.JsonPath, options, results);
+      printf("Wrote %s\n", options.JsonPath.c_str());
+   }
+
+   // A reference that couldn't be read or has another size leaves the RMSE out, the run doesn't count as a comparison
+   int exitCode = 0;
+   for (const BenchmarkResult& result : results)
+   {
+      if (not result.Loaded)
+      {
+         printf("%s wasn't rendered, its scene file failed to load\n", result.Scene.c_str());
+         exitCode = 1;
+      }
+   }
+   if (options.Path == CameraPath::Static && options.CompareReferences && not options.WriteReferences)
+   {
+      for (const BenchmarkResult& result : results)
+      {
+         if (result.Loaded && result.RMSE < 0.0)
+         {
+            printf("No RMSE for %s, its reference is unreadable or has another size\n", result.Scene.c_str());
+            exitCode = 1;
+         }
+      }
+   }
+
+   return exitCode;
+}
@@ -0,0 +1,8 @@
+// Entry point of the console-only renderer: the headless modes of the RayTracing application (see HeadlessApp.h), without
+// the window, so render farms and Linux machines can run the coordinator and the workers
+#include "HeadlessApp.h"
+
+int main(int argc, char** argv)
+{
+   return HeadlessApp::Run(argc, argv);
+}
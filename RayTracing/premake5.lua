@@ -32,6 +32,7 @@ project "RayTracing"
    filter "system:windows"
       systemversion "latest"
       defines { "WL_PLATFORM_WINDOWS" }
+      links { "Ws2_32" }
 
    filter "configurations:Debug"
       defines { "WL_DEBUG" }
@@ -49,4 +50,68 @@ project "RayTracing"
       defines { "WL_DIST" }
       runtime "Release"
       optimize "On"
-      symbols "Off"
\ No newline at end of file
+      symbols "Off"
+project "RayTracingHeadless"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++20"
+   staticruntime "off"
+
+   -- The renderer without the window and its panels, RayTracing --headless as its own executable
+   files
+   {
+      "headless/HeadlessMain.cpp",
+
+      "src/**.h",
+      "src/**.cpp",
+   }
+
+   -- Neither the window nor the GPU: only header-only parts of Walnut (glm, Timer.h) are used and nothing is linked
+   removefiles
+   {
+      "src/WalnutApp.cpp",
+      "src/CameraInput.cpp",
+      "src/ViewportImage.h",
+      "src/ViewportImage.cpp",
+      "src/*Panel.h",
+      "src/*Panel.cpp",
+   }
+
+   includedirs
+   {
+      "../Walnut/vendor/glm",
+
+      "../Walnut/Walnut/src",
+
+      "../Vendor",
+      "../RayTracing/src",
+   }
+
+   targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+   objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+   filter "system:windows"
+      systemversion "latest"
+      defines { "WL_PLATFORM_WINDOWS" }
+      links { "Ws2_32" }
+
+   -- libstdc++ runs the parallel algorithms on TBB
+   filter "system:linux"
+      links { "tbb", "pthread" }
+
+   filter "configurations:Debug"
+      defines { "WL_DEBUG" }
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      defines { "WL_RELEASE" }
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   filter "configurations:Dist"
+      defines { "WL_DIST" }
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <cfloat>
+
+struct AABB
+{
+   glm::vec3 m_Min = glm::vec3(FLT_MAX);
+   glm::vec3 m_Max = glm::vec3(-FLT_MAX);
+
+   AABB() = default;
+   AABB(const AABB&) = default;
+   AABB(const glm::vec3& min, const glm::vec3& max)
+      : m_Min(min), m_Max(max) {}
+
+   void Grow(const glm::vec3& point)
+   {
+      m_Min = glm::min(m_Min, point);
+      m_Max = glm::max(m_Max, point);
+   }
+
+   void Grow(const AABB& other)
+   {
+      m_Min = glm::min(m_Min, other.m_Min);
+      m_Max = glm::max(m_Max, other.m_Max);
+   }
+
+   bool IsValid() const { return m_Min.x <= m_Max.x && m_Min.y <= m_Max.y && m_Min.z <= m_Max.z; }
+   glm::vec3 GetCenter() const { return (m_Min + m_Max) * 0.5f; }
+
+   float GetSurfaceArea() const
+   {
+      if (not IsValid())
+      {
+         return 0.0f;
+      }
+
+      glm::vec3 extent = m_Max - m_Min;
+      return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+   }
+};
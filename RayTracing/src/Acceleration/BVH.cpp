@@ -0,0 +1,628 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <execution>
+#include <thread>
+
+namespace
+{
+   struct Bin
+   {
+      AABB Bounds;
+      uint32_t Count = 0;
+   };
+
+   // Runs function(begin, end) over [0, count) split into chunks, on all cores
+   template<typename Function>
+   void ParallelFor(uint32_t count, uint32_t minChunkSize, Function&& function)
+   {
+      const uint32_t maxChunks = std::max(1u, std::thread::hardware_concurrency()) * 4;
+      const uint32_t chunkSize = std::max(minChunkSize, (count + maxChunks - 1) / maxChunks);
+      const uint32_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+      std::vector<uint32_t> chunks(chunkCount);
+      for (uint32_t i = 0; i < chunkCount; i++)
+      {
+         chunks[i] = i;
+      }
+
+      std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](uint32_t chunk)
+      {
+         function(chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize));
+      });
+   }
+
+   // Spreads the lowest 21 bits of value out to every third bit
+   uint64_t ExpandBits(uint64_t value)
+   {
+      value &= 0x1fffff;
+      value = (value | value << 32) & 0x1f00000000ffffull;
+      value = (value | value << 16) & 0x1f0000ff0000ffull;
+      value = (value | value << 8) & 0x100f00f00f00f00full;
+      value = (value | value << 4) & 0x10c30c30c30c30c3ull;
+      value = (value | value << 2) & 0x1249249249249249ull;
+      return value;
+   }
+
+   // Stable LSD radix sort of the (key, value) pairs, 8 bits per pass. Only the lowest keyBits bits of the keys are looked at
+   void RadixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, uint32_t keyBits)
+   {
+      const uint32_t count = (uint32_t)keys.size();
+      constexpr uint32_t s_ChunkSize = 1 << 16;
+      const uint32_t chunkCount = (count + s_ChunkSize - 1) / s_ChunkSize;
+
+      std::vector<uint64_t> keysOut(count);
+      std::vector<uint32_t> valuesOut(count);
+      std::vector<uint32_t> offsets(chunkCount * 256);
+
+      for (uint32_t shift = 0; shift < keyBits; shift += 8)
+      {
+         std::fill(offsets.begin(), offsets.end(), 0);
+         ParallelFor(count, s_ChunkSize, [&](uint32_t begin, uint32_t end)
+         {
+            uint32_t* histogram = &offsets[(begin / s_ChunkSize) * 256];
+            for (uint32_t i = begin; i < end; i++)
+            {
+               histogram[(keys[i] >> shift) & 0xff]++;
+            }
+         });
+
+         // Exclusive prefix sum over (digit, chunk), so every chunk scatters into its own range of each digit
+         uint32_t sum = 0;
+         bool singleDigit = false;
+         for (uint32_t digit = 0; digit < 256; digit++)
+         {
+            uint32_t digitStart = sum;
+            for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+            {
+               uint32_t digitCount = offsets[chunk * 256 + digit];
+               offsets[chunk * 256 + digit] = sum;
+               sum += digitCount;
+            }
+            singleDigit |= (sum - digitStart == count);
+         }
+
+         // Every key has the same digit, the pass would only copy
+         if (singleDigit)
+         {
+            continue;
+         }
+
+         ParallelFor(count, s_ChunkSize, [&](uint32_t begin, uint32_t end)
+         {
+            uint32_t* offset = &offsets[(begin / s_ChunkSize) * 256];
+            for (uint32_t i = begin; i < end; i++)
+            {
+               uint32_t destination = offset[(keys[i] >> shift) & 0xff]++;
+               keysOut[destination] = keys[i];
+               valuesOut[destination] = values[i];
+            }
+         });
+
+         keys.swap(keysOut);
+         values.swap(valuesOut);
+      }
+   }
+
+   void UpdateNodeBounds(BVHNode& node, const std::vector<AABB>& primitiveBounds, const std::vector<uint32_t>& order)
+   {
+      AABB bounds;
+      for (uint32_t i = 0; i < node.m_Count; i++)
+      {
+         bounds.Grow(primitiveBounds[order[node.m_LeftFirst + i]]);
+      }
+
+      node.m_Min = bounds.m_Min;
+      node.m_Max = bounds.m_Max;
+   }
+}
+
+std::vector<BVHNode> BVHBuilder::Build(const std::vector<AABB>& primitiveBounds, std::vector<uint32_t>& outOrder, const BVHBuildSettings& settings)
+{
+   if (settings.Quality == BVHBuildQuality::Fast)
+   {
+      return BuildLBVH(primitiveBounds, outOrder, settings);
+   }
+
+   return BuildSAH(primitiveBounds, outOrder, settings);
+}
+
+std::vector<BVHNode> BVHBuilder::BuildSAH(const std::vector<AABB>& primitiveBounds, std::vector<uint32_t>& outOrder, const BVHBuildSettings& settings)
+{
+   const uint32_t primitiveCount = (uint32_t)primitiveBounds.size();
+
+   outOrder.resize(primitiveCount);
+   for (uint32_t i = 0; i < primitiveCount; i++)
+   {
+      outOrder[i] = i;
+   }
+
+   std::vector<BVHNode> nodes;
+   if (primitiveCount == 0)
+   {
+      return nodes;
+   }
+
+   std::vector<glm::vec3> centroids(primitiveCount);
+   for (uint32_t i = 0; i < primitiveCount; i++)
+   {
+      centroids[i] = primitiveBounds[i].GetCenter();
+   }
+
+   // A binary tree with N leaves never has more than 2N - 1 nodes, so references stay valid while building
+   nodes.reserve(2 * primitiveCount);
+   nodes.push_back({ {}, 0, {}, primitiveCount });
+   UpdateNodeBounds(nodes[0], primitiveBounds, outOrder);
+
+   const uint32_t binCount = std::max(settings.BinCount, 2u);
+   std::vector<Bin> bins(binCount);
+   std::vector<float> rightAreas(binCount);
+   std::vector<uint32_t> rightCounts(binCount);
+
+   struct Task
+   {
+      uint32_t NodeIndex;
+      uint32_t Depth;
+   };
+   std::vector<Task> todo = { { 0, 1 } };
+   while (not todo.empty())
+   {
+      Task task = todo.back();
+      todo.pop_back();
+
+      BVHNode& node = nodes[task.NodeIndex];
+      if (node.m_Count <= 1 || task.Depth >= MaxDepth)
+      {
+         continue;
+      }
+
+      // Bin the centroids, the split planes are between the bins
+      AABB centroidBounds;
+      for (uint32_t i = 0; i < node.m_Count; i++)
+      {
+         centroidBounds.Grow(centroids[outOrder[node.m_LeftFirst + i]]);
+      }
+
+      float bestCost = FLT_MAX;
+      int bestAxis = -1;
+      uint32_t bestSplit = 0;
+
+      for (int axis = 0; axis < 3; axis++)
+      {
+         float axisMin = centroidBounds.m_Min[axis];
+         float axisMax = centroidBounds.m_Max[axis];
+         if (axisMax <= axisMin)
+         {
+            continue;
+         }
+
+         std::fill(bins.begin(), bins.end(), Bin());
+         float scale = binCount / (axisMax - axisMin);
+         for (uint32_t i = 0; i < node.m_Count; i++)
+         {
+            uint32_t primitive = outOrder[node.m_LeftFirst + i];
+            uint32_t binIndex = std::min(binCount - 1, (uint32_t)((centroids[primitive][axis] - axisMin) * scale));
+            bins[binIndex].Count++;
+            bins[binIndex].Bounds.Grow(primitiveBounds[primitive]);
+         }
+
+         // Sweep from the right to get the area and count right of every plane
+         AABB rightBounds;
+         uint32_t rightCount = 0;
+         for (uint32_t i = binCount - 1; i > 0; i--)
+         {
+            rightCount += bins[i].Count;
+            rightBounds.Grow(bins[i].Bounds);
+            rightCounts[i] = rightCount;
+            rightAreas[i] = rightBounds.GetSurfaceArea();
+         }
+
+         AABB leftBounds;
+         uint32_t leftCount = 0;
+         for (uint32_t i = 0; i < binCount - 1; i++)
+         {
+            leftCount += bins[i].Count;
+            leftBounds.Grow(bins[i].Bounds);
+
+            if (leftCount == 0 || rightCounts[i + 1] == 0)
+            {
+               continue;
+            }
+
+            float cost = leftCount * leftBounds.GetSurfaceArea() + rightCounts[i + 1] * rightAreas[i + 1];
+            if (cost < bestCost)
+            {
+               bestCost = cost;
+               bestAxis = axis;
+               bestSplit = i;
+            }
+         }
+      }
+
+      if (bestAxis == -1)
+      {
+         // Every centroid is in the same spot, nothing to split
+         continue;
+      }
+
+      // Compare against making this node a leaf (costs relative to the parent area)
+      float parentArea = AABB(node.m_Min, node.m_Max).GetSurfaceArea();
+      float splitCost = settings.TraversalCost + ((parentArea > 0.0f) ? bestCost / parentArea : 0.0f);
+      float leafCost = (float)node.m_Count;
+      if (splitCost >= leafCost && node.m_Count <= settings.MaxLeafSize)
+      {
+         continue;
+      }
+
+      // Partition the primitives of this node around the chosen plane
+      float axisMin = centroidBounds.m_Min[bestAxis];
+      float scale = binCount / (centroidBounds.m_Max[bestAxis] - axisMin);
+      auto first = outOrder.begin() + node.m_LeftFirst;
+      auto middle = std::partition(first, first + node.m_Count, [&](uint32_t primitive)
+      {
+         uint32_t binIndex = std::min(binCount - 1, (uint32_t)((centroids[primitive][bestAxis] - axisMin) * scale));
+         return binIndex <= bestSplit;
+      });
+
+      uint32_t leftCount = (uint32_t)(middle - first);
+      if (leftCount == 0 || leftCount == node.m_Count)
+      {
+         continue;
+      }
+
+      uint32_t leftIndex = (uint32_t)nodes.size();
+      BVHNode left = { {}, node.m_LeftFirst, {}, leftCount };
+      BVHNode right = { {}, node.m_LeftFirst + leftCount, {}, node.m_Count - leftCount };
+      UpdateNodeBounds(left, primitiveBounds, outOrder);
+      UpdateNodeBounds(right, primitiveBounds, outOrder);
+
+      node.m_LeftFirst = leftIndex;
+      node.m_Count = 0;
+
+      nodes.push_back(left);
+      nodes.push_back(right);
+      todo.push_back({ leftIndex, task.Depth + 1 });
+      todo.push_back({ leftIndex + 1, task.Depth + 1 });
+   }
+
+   nodes.shrink_to_fit();
+   return nodes;
+}
+
+std::vector<BVHNode> BVHBuilder::BuildLBVH(const std::vector<AABB>& primitiveBounds, std::vector<uint32_t>& outOrder, const BVHBuildSettings& settings)
+{
+   const uint32_t primitiveCount = (uint32_t)primitiveBounds.size();
+   const uint32_t maxLeafSize = std::max(settings.MaxLeafSize, 1u);
+
+   std::vector<BVHNode> nodes;
+   if (primitiveCount == 0)
+   {
+      outOrder.clear();
+      return nodes;
+   }
+
+   // Morton codes of the centroids, quantized in the bounds of all centroids. 30 bit codes sort in half the passes,
+   // past a million primitives too many of them would share a cell and the split quality drops, so 63 bits are used
+   constexpr uint32_t s_MinChunkSize = 1 << 14;
+   std::vector<AABB> chunkBounds((primitiveCount + s_MinChunkSize - 1) / s_MinChunkSize);
+   ParallelFor(primitiveCount, s_MinChunkSize, [&](uint32_t begin, uint32_t end)
+   {
+      AABB& bounds = chunkBounds[begin / s_MinChunkSize];
+      for (uint32_t i = begin; i < end; i++)
+      {
+         bounds.Grow(primitiveBounds[i].GetCenter());
+      }
+   });
+
+   AABB centroidBounds;
+   for (const AABB& bounds : chunkBounds)
+   {
+      centroidBounds.Grow(bounds);
+   }
+
+   const uint32_t codeBits = (primitiveCount <= (1u << 20)) ? 30 : 63;
+   const float cellCount = (float)((1u << (codeBits / 3)) - 1);
+   const glm::vec3 extent = centroidBounds.m_Max - centroidBounds.m_Min;
+   const glm::vec3 scale = glm::vec3(
+      extent.x > 0.0f ? cellCount / extent.x : 0.0f,
+      extent.y > 0.0f ? cellCount / extent.y : 0.0f,
+      extent.z > 0.0f ? cellCount / extent.z : 0.0f);
+
+   std::vector<uint64_t> codes(primitiveCount);
+   outOrder.resize(primitiveCount);
+   ParallelFor(primitiveCount, s_MinChunkSize, [&](uint32_t begin, uint32_t end)
+   {
+      for (uint32_t i = begin; i < end; i++)
+      {
+         glm::vec3 cell = glm::min((primitiveBounds[i].GetCenter() - centroidBounds.m_Min) * scale, glm::vec3(cellCount));
+         codes[i] = (ExpandBits((uint64_t)cell.x) << 2) | (ExpandBits((uint64_t)cell.y) << 1) | ExpandBits((uint64_t)cell.z);
+         outOrder[i] = i;
+      }
+   });
+
+   RadixSort(codes, outOrder, codeBits);
+
+   if (primitiveCount <= maxLeafSize)
+   {
+      AABB bounds;
+      for (uint32_t i = 0; i < primitiveCount; i++)
+      {
+         bounds.Grow(primitiveBounds[i]);
+      }
+
+      nodes.push_back({ bounds.m_Min, 0, bounds.m_Max, primitiveCount });
+      return nodes;
+   }
+
+   // Length of the common prefix of the codes at i and j, -1 when j is out of range.
+   // Equal codes fall back to the indices so every key is unique
+   const int64_t count = primitiveCount;
+   auto commonPrefix = [&](int64_t i, int64_t j) -> int
+   {
+      if (j < 0 || j >= count)
+      {
+         return -1;
+      }
+
+      uint64_t difference = codes[i] ^ codes[j];
+      if (difference == 0)
+      {
+         return 64 + std::countl_zero((uint32_t)(i ^ j));
+      }
+      return std::countl_zero(difference);
+   };
+
+   // N - 1 internal nodes. Internal node i splits its range [First, Last] into [First, Split] and [Split + 1, Last],
+   // each side is a leaf (sorted primitive) when it holds a single primitive, or else the internal node of that index
+   struct InternalNode
+   {
+      uint32_t First;
+      uint32_t Last;
+      uint32_t Split;
+      uint32_t Parent;
+   };
+
+   const uint32_t internalCount = primitiveCount - 1;
+   std::vector<InternalNode> internalNodes(internalCount);
+   std::vector<uint32_t> leafParents(primitiveCount);
+   ParallelFor(internalCount, s_MinChunkSize, [&](uint32_t begin, uint32_t end)
+   {
+      for (uint32_t index = begin; index < end; index++)
+      {
+         const int64_t i = index;
+
+         // The direction the range extends in, then its other end by exponential and binary search
+         const int64_t direction = (commonPrefix(i, i + 1) - commonPrefix(i, i - 1)) >= 0 ? 1 : -1;
+         const int minPrefix = commonPrefix(i, i - direction);
+
+         int64_t maxLength = 2;
+         while (commonPrefix(i, i + maxLength * direction) > minPrefix)
+         {
+            maxLength *= 2;
+         }
+
+         int64_t length = 0;
+         for (int64_t step = maxLength / 2; step >= 1; step /= 2)
+         {
+            if (commonPrefix(i, i + (length + step) * direction) > minPrefix)
+            {
+               length += step;
+            }
+         }
+         const int64_t j = i + length * direction;
+
+         // The split is where the common prefix of the range ends
+         const int nodePrefix = commonPrefix(i, j);
+         int64_t splitOffset = 0;
+         int64_t step = length;
+         do
+         {
+            step = (step + 1) / 2;
+            if (commonPrefix(i, i + (splitOffset + step) * direction) > nodePrefix)
+            {
+               splitOffset += step;
+            }
+         } while (step > 1);
+         const uint32_t split = (uint32_t)(i + splitOffset * direction + std::min<int64_t>(direction, 0));
+
+         InternalNode& node = internalNodes[index];
+         node.First = (uint32_t)std::min(i, j);
+         node.Last = (uint32_t)std::max(i, j);
+         node.Split = split;
+
+         // Each child has exactly one parent, so these writes never collide
+         if (node.First == split)
+         {
+            leafParents[split] = index;
+         }
+         else
+         {
+            internalNodes[split].Parent = index;
+         }
+
+         if (node.Last == split + 1)
+         {
+            leafParents[split + 1] = index;
+         }
+         else
+         {
+            internalNodes[split + 1].Parent = index;
+         }
+      }
+   });
+
+   // Bounds bottom up: every leaf walks towards the root, the second child to arrive at a node computes its bounds
+   std::vector<AABB> internalBounds(internalCount);
+   std::vector<std::atomic<uint32_t>> arrivals(internalCount);
+   ParallelFor(primitiveCount, s_MinChunkSize, [&](uint32_t begin, uint32_t end)
+   {
+      for (uint32_t leaf = begin; leaf < end; leaf++)
+      {
+         uint32_t index = leafParents[leaf];
+         while (arrivals[index].fetch_add(1, std::memory_order_acq_rel) == 1)
+         {
+            const InternalNode& node = internalNodes[index];
+            AABB bounds = (node.First == node.Split) ? primitiveBounds[outOrder[node.Split]] : internalBounds[node.Split];
+            bounds.Grow((node.Last == node.Split + 1) ? primitiveBounds[outOrder[node.Split + 1]] : internalBounds[node.Split + 1]);
+            internalBounds[index] = bounds;
+
+            if (index == 0)
+            {
+               break;
+            }
+            index = node.Parent;
+         }
+      }
+   });
+
+   // Internal node i puts its two children at 1 + 2 * Split, every split index is used by exactly one node.
+   // Ranges of up to maxLeafSize primitives become leaves, the slots of the nodes below them are never reached (and dropped below)
+   auto makeNode = [&](uint32_t index, bool isLeaf) -> BVHNode
+   {
+      if (isLeaf)
+      {
+         const AABB& bounds = primitiveBounds[outOrder[index]];
+         return { bounds.m_Min, index, bounds.m_Max, 1 };
+      }
+
+      const InternalNode& node = internalNodes[index];
+      const AABB& bounds = internalBounds[index];
+      uint32_t rangeCount = node.Last - node.First + 1;
+      if (rangeCount <= maxLeafSize)
+      {
+         return { bounds.m_Min, node.First, bounds.m_Max, rangeCount };
+      }
+      return { bounds.m_Min, 1 + 2 * node.Split, bounds.m_Max, 0 };
+   };
+
+   nodes.resize(2 * (size_t)primitiveCount - 1);
+   nodes[0] = makeNode(0, false);
+   ParallelFor(internalCount, s_MinChunkSize, [&](uint32_t begin, uint32_t end)
+   {
+      for (uint32_t index = begin; index < end; index++)
+      {
+         const InternalNode& node = internalNodes[index];
+         nodes[1 + 2 * node.Split] = makeNode(node.Split, node.First == node.Split);
+         nodes[2 + 2 * node.Split] = makeNode(node.Split + 1, node.Last == node.Split + 1);
+      }
+   });
+
+   // With leaves of several primitives most slots are unreachable. Only the reachable nodes are kept, renumbered depth first
+   // with the children of a node still next to each other. Runs of equal Morton codes split one primitive at a time,
+   // an internal node at MaxDepth becomes a leaf over its range (slot s holds internal node s / 2)
+   struct Task
+   {
+      uint32_t Index;
+      uint32_t Slot;
+      uint32_t Depth;
+   };
+   std::vector<BVHNode> compacted = { nodes[0] };
+   std::vector<Task> todo = { { 0, 0, 1 } };
+   while (not todo.empty())
+   {
+      const Task task = todo.back();
+      todo.pop_back();
+      BVHNode& node = compacted[task.Index];
+      if (node.IsLeaf())
+      {
+         continue;
+      }
+
+      if (task.Depth >= MaxDepth)
+      {
+         const InternalNode& internalNode = internalNodes[task.Slot / 2];
+         node.m_LeftFirst = internalNode.First;
+         node.m_Count = internalNode.Last - internalNode.First + 1;
+         continue;
+      }
+
+      const uint32_t left = node.m_LeftFirst;
+      const uint32_t compactedLeft = (uint32_t)compacted.size();
+      node.m_LeftFirst = compactedLeft;
+      compacted.push_back(nodes[left]);
+      compacted.push_back(nodes[left + 1]);
+      todo.push_back({ compactedLeft + 1, left + 1, task.Depth + 1 });
+      todo.push_back({ compactedLeft, left, task.Depth + 1 });
+   }
+
+   compacted.shrink_to_fit();
+   return compacted;
+}
+
+std::vector<BVHNode> BVHBuilder::BuildForTriangles(const Vertex* vertices, std::vector<uint32_t>& indices, const BVHBuildSettings& settings)
+{
+   if (settings.SpatialSplitBudget > 0.0f)
+   {
+      return BuildSpatial(vertices, indices, settings);
+   }
+
+   const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+
+   std::vector<AABB> triangleBounds(triangleCount);
+   for (uint32_t i = 0; i < triangleCount; i++)
+   {
+      triangleBounds[i].Grow(vertices[indices[i * 3 + 0]].m_Position);
+      triangleBounds[i].Grow(vertices[indices[i * 3 + 1]].m_Position);
+      triangleBounds[i].Grow(vertices[indices[i * 3 + 2]].m_Position);
+   }
+
+   std::vector<uint32_t> order;
+   std::vector<BVHNode> nodes = Build(triangleBounds, order, settings);
+
+   std::vector<uint32_t> reordered(indices.size());
+   for (uint32_t i = 0; i < triangleCount; i++)
+   {
+      reordered[i * 3 + 0] = indices[order[i] * 3 + 0];
+      reordered[i * 3 + 1] = indices[order[i] * 3 + 1];
+      reordered[i * 3 + 2] = indices[order[i] * 3 + 2];
+   }
+   indices = std::move(reordered);
+
+   return nodes;
+}
+
+bool BVHBuilder::IsValid(const BVHNode* nodes, uint32_t nodeCount, uint32_t primitiveCount)
+{
+   if (nodeCount == 0)
+   {
+      return true;
+   }
+
+   struct Entry
+   {
+      uint32_t NodeIndex;
+      uint32_t Depth;
+   };
+
+   std::vector<bool> reached(nodeCount, false);
+   std::vector<Entry> todo = { { 0, 1 } };
+   reached[0] = true;
+   while (not todo.empty())
+   {
+      const Entry entry = todo.back();
+      todo.pop_back();
+
+      const BVHNode& node = nodes[entry.NodeIndex];
+      if (node.IsLeaf())
+      {
+         if ((uint64_t)node.m_LeftFirst + node.m_Count > primitiveCount)
+         {
+            return false;
+         }
+         continue;
+      }
+
+      // Both children, and every leaf below them, need another level
+      const uint32_t left = node.m_LeftFirst;
+      if (entry.Depth >= MaxDepth || left >= nodeCount - 1 || reached[left] || reached[left + 1])
+      {
+         return false;
+      }
+      reached[left] = reached[left + 1] = true;
+      todo.push_back({ left, entry.Depth + 1 });
+      todo.push_back({ left + 1, entry.Depth + 1 });
+   }
+   return true;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "Acceleration/AABB.h"
+#include "Acceleration/BVHNode.h"
+#include "Ray.h"
+#include "Scene/Components.h"
+
+#include <cfloat>
+#include <vector>
+
+enum class BVHBuildQuality
+{
+   HighQuality = 0, // Binned SAH, slower to build but faster to trace
+   Fast            // Parallel LBVH over Morton codes, for geometry that is rebuilt every frame
+};
+
+struct BVHBuildSettings
+{
+   BVHBuildQuality Quality = BVHBuildQuality::HighQuality;
+   uint32_t MaxLeafSize = 4;
+   uint32_t BinCount = 12;
+   float TraversalCost = 1.0f;    // Relative to one primitive test
+
+   // Triangles only: above 0 BuildForTriangles builds an SBVH, which may also split the triangles straddling a plane,
+   // at most SpatialSplitBudget * triangle count extra references. Pays off for large overlapping triangles (floors, walls).
+   // Quality is ignored then
+   float SpatialSplitBudget = 0.0f;
+   // Spatial splits are only tried where the children of the best object split overlap by more than this part of the root area
+   float SpatialSplitAlpha = 1e-5f;
+};
+
+class BVHBuilder
+{
+public:
+   // Bump whenever the builder produces a different tree for the same input, it invalidates the BVH cache
+   static constexpr uint32_t Version = 3;
+   // Deepest tree the traversal stack of TraverseBVH holds. Every builder makes the nodes on this level (the root is
+   // level 1) leaves, however many primitives they have left
+   static constexpr uint32_t MaxDepth = 64;
+
+   // Builds over the primitive bounds with the builder settings.Quality picks. outOrder receives the primitive order
+   // the leaves refer to: a leaf covers outOrder[m_LeftFirst, m_LeftFirst + m_Count)
+   static std::vector<BVHNode> Build(const std::vector<AABB>& primitiveBounds, std::vector<uint32_t>& outOrder, const BVHBuildSettings& settings = {});
+
+   // Builds over an indexed triangle list (3 indices per triangle) and reorders the triangles to the leaf order,
+   // so a leaf directly covers the triangles [m_LeftFirst, m_LeftFirst + m_Count). With spatial splits a triangle
+   // can be in several leaves, it is then repeated in indices
+   static std::vector<BVHNode> BuildForTriangles(const Vertex* vertices, std::vector<uint32_t>& indices, const BVHBuildSettings& settings = {});
+   // The triangles of an index list with the repetitions of split triangles removed, for writing a mesh without its BVH
+   static std::vector<uint32_t> GetUniqueTriangles(const uint32_t* indices, uint32_t triangleCount);
+
+   // For trees that come from elsewhere (a file from another machine): every child index and leaf range is in bounds, every
+   // node is reached once from the root and no leaf is deeper than MaxDepth, so traversal can't read out of bounds or loop
+   static bool IsValid(const BVHNode* nodes, uint32_t nodeCount, uint32_t primitiveCount);
+
+private:
+   static std::vector<BVHNode> BuildSAH(const std::vector<AABB>& primitiveBounds, std::vector<uint32_t>& outOrder, const BVHBuildSettings& settings);
+   // Karras 2012: the primitives are sorted along a Morton curve and every internal node is emitted independently of the others.
+   // Leaves hold up to MaxLeafSize primitives, BinCount and TraversalCost are unused
+   static std::vector<BVHNode> BuildLBVH(const std::vector<AABB>& primitiveBounds, std::vector<uint32_t>& outOrder, const BVHBuildSettings& settings);
+   // SBVH, in SBVH.cpp
+   static std::vector<BVHNode> BuildSpatial(const Vertex* vertices, std::vector<uint32_t>& indices, const BVHBuildSettings& settings);
+};
+
+// Slab test. Returns the entry distance, or FLT_MAX on a miss or when the box starts behind closestT
+inline float IntersectAABB(const Ray& ray, const glm::vec3& invDirection, const glm::vec3& min, const glm::vec3& max, float closestT)
+{
+   glm::vec3 t0 = (min - ray.Origin) * invDirection;
+   glm::vec3 t1 = (max - ray.Origin) * invDirection;
+   glm::vec3 tMin = glm::min(t0, t1);
+   glm::vec3 tMax = glm::max(t0, t1);
+
+   float tNear = glm::max(glm::max(tMin.x, tMin.y), tMin.z);
+   float tFar = glm::min(glm::min(tMax.x, tMax.y), tMax.z);
+
+   if (tFar >= tNear && tFar > 0.0f && tNear < closestT)
+   {
+      return tNear;
+   }
+
+   return FLT_MAX;
+}
+
+// Closest-hit traversal, near child first. intersectPrimitive(primitiveIndex) tests one primitive and lowers closestT on a hit.
+// Returns the number of nodes whose bounds were tested
+template<typename IntersectPrimitive>
+uint32_t TraverseBVH(const BVHNode* nodes, uint32_t nodeCount, const Ray& ray, const glm::vec3& invDirection, float& closestT, IntersectPrimitive&& intersectPrimitive)
+{
+   if (nodeCount == 0)
+   {
+      return 0;
+   }
+
+   uint32_t nodeTests = 1;
+   if (IntersectAABB(ray, invDirection, nodes[0].m_Min, nodes[0].m_Max, closestT) == FLT_MAX)
+   {
+      return nodeTests;
+   }
+
+   struct StackEntry
+   {
+      uint32_t NodeIndex;
+      float Distance;
+   };
+   StackEntry stack[BVHBuilder::MaxDepth];
+   uint32_t stackSize = 0;
+
+   const BVHNode* node = &nodes[0];
+   while (true)
+   {
+      if (node->IsLeaf())
+      {
+         for (uint32_t i = 0; i < node->m_Count; i++)
+         {
+            intersectPrimitive(node->m_LeftFirst + i);
+         }
+      }
+      else
+      {
+         uint32_t nearIndex = node->m_LeftFirst;
+         uint32_t farIndex = node->m_LeftFirst + 1;
+         float nearDistance = IntersectAABB(ray, invDirection, nodes[nearIndex].m_Min, nodes[nearIndex].m_Max, closestT);
+         float farDistance = IntersectAABB(ray, invDirection, nodes[farIndex].m_Min, nodes[farIndex].m_Max, closestT);
+         nodeTests += 2;
+
+         if (farDistance < nearDistance)
+         {
+            std::swap(nearIndex, farIndex);
+            std::swap(nearDistance, farDistance);
+         }
+
+         if (nearDistance != FLT_MAX)
+         {
+            if (farDistance != FLT_MAX)
+            {
+               stack[stackSize++] = { farIndex, farDistance };
+            }
+
+            node = &nodes[nearIndex];
+            continue;
+         }
+      }
+
+      // Pop the next node that can still hold a closer hit
+      node = nullptr;
+      while (stackSize > 0)
+      {
+         const StackEntry& entry = stack[--stackSize];
+         if (entry.Distance < closestT)
+         {
+            node = &nodes[entry.NodeIndex];
+            break;
+         }
+      }
+
+      if (node == nullptr)
+      {
+         break;
+      }
+   }
+
+   return nodeTests;
+}
@@ -0,0 +1,167 @@
+#include "BVHCache.h"
+
+#include "Hasher.h"
+#include "MappedFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+   constexpr char s_Magic[4] = { 'R', 'T', 'B', 'V' };
+   constexpr uint32_t s_FileVersion = 2;
+
+   struct CacheHeader
+   {
+      char Magic[4];
+      uint32_t FileVersion;
+      uint64_t MeshHash;
+      uint64_t PayloadHash; // Of everything after the header, catches truncated or damaged files
+      uint64_t FileSize;
+      uint32_t VertexCount;
+      uint32_t TriangleCount;  // Of the mesh the BVH was built for
+      uint32_t NodeCount;
+      uint32_t ReferenceCount; // Triangles in the stored index list, more than TriangleCount after spatial splits
+      uint64_t IndicesOffset;
+      uint64_t NodesOffset;
+   };
+   static_assert(sizeof(CacheHeader) == 64);
+
+   uint64_t AlignUp(uint64_t offset)
+   {
+      return (offset + 63) & ~63ull;
+   }
+}
+
+uint64_t BVHCache::HashMesh(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t triangleCount, const BVHBuildSettings& settings)
+{
+   Hasher hasher;
+   hasher.Add(BVHBuilder::Version);
+   hasher.Add(settings.Quality);
+   hasher.Add(settings.MaxLeafSize);
+   hasher.Add(settings.BinCount);
+   hasher.Add(settings.TraversalCost);
+   hasher.Add(settings.SpatialSplitBudget);
+   hasher.Add(settings.SpatialSplitAlpha);
+   hasher.Add(vertexCount);
+   hasher.Add(triangleCount);
+
+   // Only the positions shape the tree
+   for (uint32_t i = 0; i < vertexCount; i++)
+   {
+      hasher.Add(vertices[i].m_Position);
+   }
+   hasher.Add(indices, (uint64_t)triangleCount * 3 * sizeof(uint32_t));
+
+   return hasher.Get();
+}
+
+bool BVHCache::Load(uint64_t hash, uint32_t vertexCount, uint32_t triangleCount, Entry& outEntry)
+{
+   if (not IsEnabled())
+   {
+      return false;
+   }
+
+   std::shared_ptr<MappedFile> file = MappedFile::Open(GetFilepath(hash));
+   if (file == nullptr)
+   {
+      return false;
+   }
+
+   uint8_t* data = file->GetData();
+   const uint64_t fileSize = file->GetSize();
+   if (fileSize < sizeof(CacheHeader))
+   {
+      return false;
+   }
+
+   const CacheHeader& header = *(const CacheHeader*)data;
+   const uint64_t indicesSize = (uint64_t)header.ReferenceCount * 3 * sizeof(uint32_t);
+   const uint64_t nodesSize = (uint64_t)header.NodeCount * sizeof(BVHNode);
+   if (memcmp(header.Magic, s_Magic, sizeof(s_Magic)) != 0 || header.FileVersion != s_FileVersion ||
+       header.MeshHash != hash || header.VertexCount != vertexCount || header.TriangleCount != triangleCount ||
+       header.FileSize != fileSize || header.NodeCount == 0 || header.ReferenceCount < header.TriangleCount ||
+       header.IndicesOffset < sizeof(CacheHeader) || header.IndicesOffset > fileSize || indicesSize > fileSize - header.IndicesOffset ||
+       header.NodesOffset < sizeof(CacheHeader) || header.NodesOffset > fileSize || nodesSize > fileSize - header.NodesOffset)
+   {
+      return false;
+   }
+
+   Hasher payloadHasher;
+   payloadHasher.Add(data + sizeof(CacheHeader), fileSize - sizeof(CacheHeader));
+   if (payloadHasher.Get() != header.PayloadHash)
+   {
+      printf("BVH cache file '%s' is damaged, rebuilding\n", file->GetFilepath().c_str());
+      return false;
+   }
+
+   outEntry.Indices = (uint32_t*)(data + header.IndicesOffset);
+   outEntry.Nodes = (const BVHNode*)(data + header.NodesOffset);
+   outEntry.NodeCount = header.NodeCount;
+   outEntry.TriangleCount = header.ReferenceCount;
+   outEntry.File = std::move(file);
+   return true;
+}
+
+bool BVHCache::Store(uint64_t hash, uint32_t vertexCount, uint32_t triangleCount, const std::vector<uint32_t>& indices, const std::vector<BVHNode>& nodes)
+{
+   if (not IsEnabled())
+   {
+      return false;
+   }
+
+   std::error_code error;
+   std::filesystem::create_directories(s_Directory, error);
+
+   CacheHeader header = {};
+   memcpy(header.Magic, s_Magic, sizeof(s_Magic));
+   header.FileVersion = s_FileVersion;
+   header.MeshHash = hash;
+   header.VertexCount = vertexCount;
+   header.TriangleCount = triangleCount;
+   header.ReferenceCount = (uint32_t)(indices.size() / 3);
+   header.NodeCount = (uint32_t)nodes.size();
+   header.NodesOffset = sizeof(CacheHeader);
+   header.IndicesOffset = AlignUp(header.NodesOffset + nodes.size() * sizeof(BVHNode));
+   header.FileSize = header.IndicesOffset + indices.size() * sizeof(uint32_t);
+
+   std::vector<uint8_t> payload(header.FileSize - sizeof(CacheHeader), 0);
+   memcpy(payload.data(), nodes.data(), nodes.size() * sizeof(BVHNode));
+   memcpy(payload.data() + (header.IndicesOffset - sizeof(CacheHeader)), indices.data(), indices.size() * sizeof(uint32_t));
+
+   Hasher payloadHasher;
+   payloadHasher.Add(payload.data(), payload.size());
+   header.PayloadHash = payloadHasher.Get();
+
+   // Written under a temporary name and renamed, so a crash never leaves a half written file behind
+   const std::string filepath = GetFilepath(hash);
+   const std::string temporaryFilepath = filepath + ".tmp";
+   {
+      std::ofstream file(temporaryFilepath, std::ios::binary);
+      file.write((const char*)&header, sizeof(header));
+      file.write((const char*)payload.data(), payload.size());
+      if (not file.good())
+      {
+         return false;
+      }
+   }
+
+   std::filesystem::rename(temporaryFilepath, filepath, error);
+   if (error)
+   {
+      std::filesystem::remove(temporaryFilepath, error);
+      return false;
+   }
+
+   return true;
+}
+
+std::string BVHCache::GetFilepath(uint64_t hash)
+{
+   char name[32];
+   snprintf(name, sizeof(name), "%016llx.bvh", (unsigned long long)hash);
+   return (std::filesystem::path(s_Directory) / name).string();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Acceleration/BVH.h"
+
+#include <memory>
+#include <string>
+
+class MappedFile;
+
+// Built mesh BVHs stored on disk, one file per mesh named after the hash of its vertices, indices and the
+// build settings. A file that is missing, from another builder version or damaged is a miss, the caller
+// builds the BVH and stores it
+class BVHCache
+{
+public:
+   struct Entry
+   {
+      std::shared_ptr<MappedFile> File; // Keeps the pointers below valid
+      uint32_t* Indices = nullptr; // Triangles in leaf order, the mapping is copy-on-write
+      const BVHNode* Nodes = nullptr;
+      uint32_t NodeCount = 0;
+      uint32_t TriangleCount = 0; // Of Indices, more than the mesh has after spatial splits
+   };
+
+   // An empty directory disables the cache
+   static void SetDirectory(const std::string& directory) { s_Directory = directory; }
+   static const std::string& GetDirectory() { return s_Directory; }
+   static bool IsEnabled() { return not s_Directory.empty(); }
+
+   static uint64_t HashMesh(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t triangleCount, const BVHBuildSettings& settings);
+
+   // Maps the cached BVH of the mesh with this hash. Returns false on a miss
+   static bool Load(uint64_t hash, uint32_t vertexCount, uint32_t triangleCount, Entry& outEntry);
+   // indices are the reordered triangles that belong to the nodes, triangleCount is the one of the mesh
+   static bool Store(uint64_t hash, uint32_t vertexCount, uint32_t triangleCount, const std::vector<uint32_t>& indices, const std::vector<BVHNode>& nodes);
+
+private:
+   static std::string GetFilepath(uint64_t hash);
+
+   inline static std::string s_Directory = "BVHCache";
+};
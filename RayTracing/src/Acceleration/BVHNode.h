@@ -0,0 +1,14 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+// 32 bytes, two nodes per cache line. Children are always stored next to each other
+struct BVHNode
+{
+   glm::vec3 m_Min;
+   uint32_t m_LeftFirst; // Inner node: index of the left child (the right one follows it). Leaf: first primitive
+   glm::vec3 m_Max;
+   uint32_t m_Count;     // Primitives in a leaf, 0 for inner nodes
+
+   bool IsLeaf() const { return m_Count > 0; }
+};
@@ -0,0 +1,428 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <array>
+
+// Spatial split BVH (Stich et al. 2009). Besides partitioning the triangles, a node may be split by a plane that
+// cuts the triangles straddling it: each side then references the part of the triangle it holds. Only worth trying
+// where the children of the best object split overlap a lot, and limited by the reference budget
+namespace
+{
+   struct Reference
+   {
+      AABB Bounds; // Of the part of the triangle this reference covers
+      uint32_t Triangle;
+   };
+
+   struct ObjectSplit
+   {
+      float Cost = FLT_MAX;
+      int Axis = -1;
+      uint32_t Bin = 0; // Last bin of the left side
+      float AxisMin = 0.0f;
+      float Scale = 0.0f;
+      AABB LeftBounds;
+      AABB RightBounds;
+
+      uint32_t GetBin(const Reference& reference, uint32_t binCount) const
+      {
+         return std::min(binCount - 1, (uint32_t)((reference.Bounds.GetCenter()[Axis] - AxisMin) * Scale));
+      }
+   };
+
+   struct SpatialSplit
+   {
+      float Cost = FLT_MAX;
+      int Axis = -1;
+      float Position = 0.0f;
+   };
+
+   struct SpatialBin
+   {
+      AABB Bounds;
+      uint32_t Entries = 0; // References starting in this bin
+      uint32_t Exits = 0;   // References ending in this bin
+   };
+
+   AABB Intersect(const AABB& a, const AABB& b)
+   {
+      return AABB(glm::max(a.m_Min, b.m_Min), glm::min(a.m_Max, b.m_Max));
+   }
+
+   // Bounds of the part of the triangle between min and max along the axis, invalid when there is none
+   AABB ClipTriangle(const glm::vec3* points, int axis, float min, float max)
+   {
+      AABB bounds;
+      for (int i = 0; i < 3; i++)
+      {
+         const glm::vec3& a = points[i];
+         const glm::vec3& b = points[(i + 1) % 3];
+         if (a[axis] >= min && a[axis] <= max)
+         {
+            bounds.Grow(a);
+         }
+
+         // Where the edge crosses the planes of the slab
+         for (float plane : { min, max })
+         {
+            if ((a[axis] < plane && b[axis] > plane) || (a[axis] > plane && b[axis] < plane))
+            {
+               glm::vec3 point = a + (b - a) * ((plane - a[axis]) / (b[axis] - a[axis]));
+               point[axis] = plane;
+               bounds.Grow(point);
+            }
+         }
+      }
+      return bounds;
+   }
+
+   ObjectSplit FindObjectSplit(const std::vector<Reference>& references, uint32_t binCount)
+   {
+      AABB centroidBounds;
+      for (const Reference& reference : references)
+      {
+         centroidBounds.Grow(reference.Bounds.GetCenter());
+      }
+
+      struct Bin
+      {
+         AABB Bounds;
+         uint32_t Count = 0;
+      };
+      std::vector<Bin> bins(binCount);
+      std::vector<AABB> rightBounds(binCount);
+      std::vector<uint32_t> rightCounts(binCount);
+
+      ObjectSplit best;
+      for (int axis = 0; axis < 3; axis++)
+      {
+         ObjectSplit candidate;
+         candidate.Axis = axis;
+         candidate.AxisMin = centroidBounds.m_Min[axis];
+         float extent = centroidBounds.m_Max[axis] - candidate.AxisMin;
+         if (extent <= 0.0f)
+         {
+            continue;
+         }
+         candidate.Scale = binCount / extent;
+
+         std::fill(bins.begin(), bins.end(), Bin());
+         for (const Reference& reference : references)
+         {
+            Bin& bin = bins[candidate.GetBin(reference, binCount)];
+            bin.Count++;
+            bin.Bounds.Grow(reference.Bounds);
+         }
+
+         AABB right;
+         uint32_t rightCount = 0;
+         for (uint32_t i = binCount - 1; i > 0; i--)
+         {
+            right.Grow(bins[i].Bounds);
+            rightCount += bins[i].Count;
+            rightBounds[i] = right;
+            rightCounts[i] = rightCount;
+         }
+
+         AABB left;
+         uint32_t leftCount = 0;
+         for (uint32_t i = 0; i < binCount - 1; i++)
+         {
+            left.Grow(bins[i].Bounds);
+            leftCount += bins[i].Count;
+            if (leftCount == 0 || rightCounts[i + 1] == 0)
+            {
+               continue;
+            }
+
+            float cost = leftCount * left.GetSurfaceArea() + rightCounts[i + 1] * rightBounds[i + 1].GetSurfaceArea();
+            if (cost < best.Cost)
+            {
+               best = candidate;
+               best.Cost = cost;
+               best.Bin = i;
+               best.LeftBounds = left;
+               best.RightBounds = rightBounds[i + 1];
+            }
+         }
+      }
+      return best;
+   }
+
+   SpatialSplit FindSpatialSplit(const std::vector<Reference>& references, const AABB& nodeBounds, const Vertex* vertices,
+                                 const std::vector<uint32_t>& indices, uint32_t binCount)
+   {
+      std::vector<SpatialBin> bins(binCount);
+      std::vector<AABB> rightBounds(binCount);
+      std::vector<uint32_t> rightExits(binCount);
+
+      SpatialSplit best;
+      for (int axis = 0; axis < 3; axis++)
+      {
+         const float axisMin = nodeBounds.m_Min[axis];
+         const float binWidth = (nodeBounds.m_Max[axis] - axisMin) / binCount;
+         if (binWidth <= 0.0f)
+         {
+            continue;
+         }
+
+         // Every reference adds its clipped part to each bin it spans
+         std::fill(bins.begin(), bins.end(), SpatialBin());
+         for (const Reference& reference : references)
+         {
+            uint32_t firstBin = std::min(binCount - 1, (uint32_t)std::max(0.0f, (reference.Bounds.m_Min[axis] - axisMin) / binWidth));
+            uint32_t lastBin = std::min(binCount - 1, (uint32_t)std::max(0.0f, (reference.Bounds.m_Max[axis] - axisMin) / binWidth));
+            bins[firstBin].Entries++;
+            bins[lastBin].Exits++;
+
+            // Most references lie in a single bin, nothing to clip
+            if (firstBin == lastBin)
+            {
+               bins[firstBin].Bounds.Grow(reference.Bounds);
+               continue;
+            }
+
+            const uint32_t* triangle = &indices[reference.Triangle * 3];
+            const glm::vec3 points[3] = { vertices[triangle[0]].m_Position, vertices[triangle[1]].m_Position, vertices[triangle[2]].m_Position };
+            for (uint32_t bin = firstBin; bin <= lastBin; bin++)
+            {
+               float binMin = axisMin + bin * binWidth;
+               float binMax = (bin == binCount - 1) ? nodeBounds.m_Max[axis] : binMin + binWidth;
+               AABB clipped = Intersect(ClipTriangle(points, axis, binMin, binMax), reference.Bounds);
+               if (clipped.IsValid())
+               {
+                  bins[bin].Bounds.Grow(clipped);
+               }
+            }
+         }
+
+         AABB right;
+         uint32_t exits = 0;
+         for (uint32_t i = binCount - 1; i > 0; i--)
+         {
+            right.Grow(bins[i].Bounds);
+            exits += bins[i].Exits;
+            rightBounds[i] = right;
+            rightExits[i] = exits;
+         }
+
+         AABB left;
+         uint32_t entries = 0;
+         for (uint32_t i = 0; i < binCount - 1; i++)
+         {
+            left.Grow(bins[i].Bounds);
+            entries += bins[i].Entries;
+            if (entries == 0 || rightExits[i + 1] == 0)
+            {
+               continue;
+            }
+
+            float cost = entries * left.GetSurfaceArea() + rightExits[i + 1] * rightBounds[i + 1].GetSurfaceArea();
+            if (cost < best.Cost)
+            {
+               best.Cost = cost;
+               best.Axis = axis;
+               best.Position = axisMin + (i + 1) * binWidth;
+            }
+         }
+      }
+      return best;
+   }
+}
+
+std::vector<BVHNode> BVHBuilder::BuildSpatial(const Vertex* vertices, std::vector<uint32_t>& indices, const BVHBuildSettings& settings)
+{
+   const uint32_t triangleCount = (uint32_t)(indices.size() / 3);
+   const uint32_t binCount = std::max(settings.BinCount, 2u);
+
+   std::vector<BVHNode> nodes;
+   if (triangleCount == 0)
+   {
+      return nodes;
+   }
+
+   std::vector<Reference> references(triangleCount);
+   AABB rootBounds;
+   for (uint32_t i = 0; i < triangleCount; i++)
+   {
+      references[i].Triangle = i;
+      references[i].Bounds.Grow(vertices[indices[i * 3 + 0]].m_Position);
+      references[i].Bounds.Grow(vertices[indices[i * 3 + 1]].m_Position);
+      references[i].Bounds.Grow(vertices[indices[i * 3 + 2]].m_Position);
+      rootBounds.Grow(references[i].Bounds);
+   }
+
+   const uint64_t maxReferences = triangleCount + (uint64_t)(triangleCount * std::max(settings.SpatialSplitBudget, 0.0f));
+   const float minOverlapArea = settings.SpatialSplitAlpha * rootBounds.GetSurfaceArea();
+   uint64_t referenceCount = triangleCount;
+
+   struct Task
+   {
+      uint32_t NodeIndex;
+      uint32_t Depth;
+      std::vector<Reference> References;
+   };
+   std::vector<Task> todo;
+   todo.push_back({ 0, 1, std::move(references) });
+   nodes.push_back({ rootBounds.m_Min, 0, rootBounds.m_Max, 0 });
+
+   // Triangle of every leaf slot, leaves cover [m_LeftFirst, m_LeftFirst + m_Count)
+   std::vector<uint32_t> leafTriangles;
+   leafTriangles.reserve(triangleCount);
+
+   while (not todo.empty())
+   {
+      Task task = std::move(todo.back());
+      todo.pop_back();
+
+      std::vector<Reference>& nodeReferences = task.References;
+      const uint32_t count = (uint32_t)nodeReferences.size();
+      const AABB nodeBounds(nodes[task.NodeIndex].m_Min, nodes[task.NodeIndex].m_Max);
+
+      const bool canSplit = (count > 1) && (task.Depth < MaxDepth);
+      ObjectSplit objectSplit = canSplit ? FindObjectSplit(nodeReferences, binCount) : ObjectSplit();
+
+      SpatialSplit spatialSplit;
+      if (canSplit && referenceCount < maxReferences)
+      {
+         AABB overlap = Intersect(objectSplit.LeftBounds, objectSplit.RightBounds);
+         if (objectSplit.Axis == -1 || (overlap.IsValid() && overlap.GetSurfaceArea() > minOverlapArea))
+         {
+            spatialSplit = FindSpatialSplit(nodeReferences, nodeBounds, vertices, indices, binCount);
+         }
+      }
+
+      // Same leaf test as the object split builder
+      float bestCost = std::min(objectSplit.Cost, spatialSplit.Cost);
+      float parentArea = nodeBounds.GetSurfaceArea();
+      float splitCost = settings.TraversalCost + ((parentArea > 0.0f) ? bestCost / parentArea : 0.0f);
+      bool makeLeaf = (bestCost == FLT_MAX) || (splitCost >= (float)count && count <= settings.MaxLeafSize);
+
+      std::vector<Reference> left, right;
+      if (not makeLeaf && spatialSplit.Cost < objectSplit.Cost)
+      {
+         const int axis = spatialSplit.Axis;
+         const float position = spatialSplit.Position;
+
+         uint32_t straddling = 0;
+         for (const Reference& reference : nodeReferences)
+         {
+            straddling += (reference.Bounds.m_Min[axis] < position && reference.Bounds.m_Max[axis] > position) ? 1 : 0;
+         }
+
+         // Over budget, the object split has to do
+         if (referenceCount + straddling <= maxReferences)
+         {
+            for (const Reference& reference : nodeReferences)
+            {
+               if (reference.Bounds.m_Max[axis] <= position)
+               {
+                  left.push_back(reference);
+               }
+               else if (reference.Bounds.m_Min[axis] >= position)
+               {
+                  right.push_back(reference);
+               }
+               else
+               {
+                  const uint32_t* triangle = &indices[reference.Triangle * 3];
+                  const glm::vec3 points[3] = { vertices[triangle[0]].m_Position, vertices[triangle[1]].m_Position, vertices[triangle[2]].m_Position };
+
+                  Reference leftPart = { Intersect(ClipTriangle(points, axis, -FLT_MAX, position), reference.Bounds), reference.Triangle };
+                  Reference rightPart = { Intersect(ClipTriangle(points, axis, position, FLT_MAX), reference.Bounds), reference.Triangle };
+                  if (leftPart.Bounds.IsValid())
+                  {
+                     left.push_back(leftPart);
+                  }
+                  if (rightPart.Bounds.IsValid())
+                  {
+                     right.push_back(rightPart);
+                  }
+               }
+            }
+         }
+      }
+
+      if (not makeLeaf && left.empty() && right.empty())
+      {
+         if (objectSplit.Axis == -1)
+         {
+            makeLeaf = true;
+         }
+         else
+         {
+            for (const Reference& reference : nodeReferences)
+            {
+               (objectSplit.GetBin(reference, binCount) <= objectSplit.Bin ? left : right).push_back(reference);
+            }
+         }
+      }
+
+      if (makeLeaf || left.empty() || right.empty())
+      {
+         BVHNode& node = nodes[task.NodeIndex];
+         node.m_LeftFirst = (uint32_t)leafTriangles.size();
+         node.m_Count = count;
+         for (const Reference& reference : nodeReferences)
+         {
+            leafTriangles.push_back(reference.Triangle);
+         }
+         continue;
+      }
+
+      referenceCount += left.size() + right.size() - count;
+
+      AABB leftBounds, rightBounds;
+      for (const Reference& reference : left)
+      {
+         leftBounds.Grow(reference.Bounds);
+      }
+      for (const Reference& reference : right)
+      {
+         rightBounds.Grow(reference.Bounds);
+      }
+
+      uint32_t leftIndex = (uint32_t)nodes.size();
+      nodes[task.NodeIndex].m_LeftFirst = leftIndex;
+      nodes[task.NodeIndex].m_Count = 0;
+      nodes.push_back({ leftBounds.m_Min, 0, leftBounds.m_Max, 0 });
+      nodes.push_back({ rightBounds.m_Min, 0, rightBounds.m_Max, 0 });
+
+      todo.push_back({ leftIndex + 1, task.Depth + 1, std::move(right) });
+      todo.push_back({ leftIndex, task.Depth + 1, std::move(left) });
+   }
+
+   // Triangles referenced from several leaves are repeated in the index list
+   std::vector<uint32_t> reordered(leafTriangles.size() * 3);
+   for (size_t i = 0; i < leafTriangles.size(); i++)
+   {
+      reordered[i * 3 + 0] = indices[leafTriangles[i] * 3 + 0];
+      reordered[i * 3 + 1] = indices[leafTriangles[i] * 3 + 1];
+      reordered[i * 3 + 2] = indices[leafTriangles[i] * 3 + 2];
+   }
+   indices = std::move(reordered);
+
+   nodes.shrink_to_fit();
+   return nodes;
+}
+
+std::vector<uint32_t> BVHBuilder::GetUniqueTriangles(const uint32_t* indices, uint32_t triangleCount)
+{
+   std::vector<std::array<uint32_t, 3>> triangles(triangleCount);
+   for (uint32_t i = 0; i < triangleCount; i++)
+   {
+      triangles[i] = { indices[i * 3 + 0], indices[i * 3 + 1], indices[i * 3 + 2] };
+   }
+
+   // The copies of a split triangle are identical, the order doesn't matter as the BVH build reorders them anyway
+   std::sort(triangles.begin(), triangles.end());
+   triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+   std::vector<uint32_t> unique;
+   unique.reserve(triangles.size() * 3);
+   for (const std::array<uint32_t, 3>& triangle : triangles)
+   {
+      unique.insert(unique.end(), triangle.begin(), triangle.end());
+   }
+   return unique;
+}
@@ -0,0 +1,290 @@
+#include "WideBVH.h"
+
+#include <algorithm>
+
+namespace
+{
+   struct WideChild
+   {
+      AABB Bounds;
+      uint32_t Index; // Wide node or first primitive
+      uint32_t Count; // 0 for inner children
+   };
+
+   void WriteNode(WideBVHNode& node, const WideChild* children, uint32_t childCount)
+   {
+      memset(&node, 0, sizeof(node));
+
+#if RT_QUANTIZED_WIDE_BVH
+      AABB nodeBounds;
+      for (uint32_t i = 0; i < childCount; i++)
+      {
+         nodeBounds.Grow(children[i].Bounds);
+      }
+
+      // The smallest power of two step that covers the node in 255 steps
+      glm::vec3 scale;
+      for (int axis = 0; axis < 3; axis++)
+      {
+         int exponent = 0;
+         std::frexp((nodeBounds.m_Max[axis] - nodeBounds.m_Min[axis]) / 255.0f, &exponent);
+         exponent = std::clamp(exponent, -126, 127);
+
+         node.m_Exponent[axis] = (int8_t)exponent;
+         scale[axis] = std::ldexp(1.0f, exponent);
+      }
+      node.m_Origin = nodeBounds.m_Min;
+#endif
+
+      for (uint32_t i = 0; i < childCount; i++)
+      {
+         const WideChild& child = children[i];
+         node.m_ChildMask |= (uint8_t)(1u << i);
+         node.m_Children[i] = child.Index;
+         node.m_Counts[i] = (uint16_t)child.Count;
+
+         for (int axis = 0; axis < 3; axis++)
+         {
+#if RT_QUANTIZED_WIDE_BVH
+            // Rounded outwards, checked with the same float math the traversal decodes with
+            const float origin = node.m_Origin[axis];
+            int min = std::clamp((int)std::floor((child.Bounds.m_Min[axis] - origin) / scale[axis]), 0, 255);
+            while (min > 0 && origin + (float)min * scale[axis] > child.Bounds.m_Min[axis])
+            {
+               min--;
+            }
+
+            int max = std::clamp((int)std::ceil((child.Bounds.m_Max[axis] - origin) / scale[axis]), 0, 255);
+            while (max < 255 && origin + (float)max * scale[axis] < child.Bounds.m_Max[axis])
+            {
+               max++;
+            }
+
+            node.m_QuantizedMin[axis][i] = (uint8_t)min;
+            node.m_QuantizedMax[axis][i] = (uint8_t)max;
+#else
+            node.m_Min[axis][i] = child.Bounds.m_Min[axis];
+            node.m_Max[axis][i] = child.Bounds.m_Max[axis];
+#endif
+         }
+      }
+   }
+}
+
+std::vector<WideBVHNode> WideBVHBuilder::Collapse(const BVHNode* nodes, uint32_t nodeCount)
+{
+   std::vector<WideBVHNode> wideNodes;
+   if (nodeCount == 0)
+   {
+      return wideNodes;
+   }
+
+   // A wide node still to be filled from the binary node. A binary leaf only ends up here as the root, or when it
+   // holds more primitives than a wide leaf can, then [First, First + Count) is spread over the children
+   struct Pending
+   {
+      uint32_t BinaryIndex;
+      uint32_t WideIndex;
+      uint32_t First;
+      uint32_t Count;
+   };
+
+   wideNodes.reserve(nodeCount / 2 + 1);
+   wideNodes.emplace_back();
+   std::vector<Pending> todo = { { 0, 0, nodes[0].m_LeftFirst, nodes[0].m_Count } };
+
+   while (not todo.empty())
+   {
+      Pending pending = todo.back();
+      todo.pop_back();
+
+      const BVHNode& binaryNode = nodes[pending.BinaryIndex];
+      const AABB binaryBounds(binaryNode.m_Min, binaryNode.m_Max);
+
+      WideChild children[WideBVHNode::Width];
+      uint32_t childCount = 0;
+
+      if (binaryNode.IsLeaf())
+      {
+         const uint32_t partSize = std::max((pending.Count + WideBVHNode::Width - 1) / WideBVHNode::Width, 1u);
+         for (uint32_t first = pending.First; first < pending.First + pending.Count; first += partSize)
+         {
+            uint32_t count = std::min(partSize, pending.First + pending.Count - first);
+            if (count <= WideBVHNode::MaxLeafCount)
+            {
+               children[childCount++] = { binaryBounds, first, count };
+            }
+            else
+            {
+               uint32_t wideIndex = (uint32_t)wideNodes.size();
+               wideNodes.emplace_back();
+               todo.push_back({ pending.BinaryIndex, wideIndex, first, count });
+               children[childCount++] = { binaryBounds, wideIndex, 0 };
+            }
+         }
+
+         WriteNode(wideNodes[pending.WideIndex], children, childCount);
+         continue;
+      }
+
+      uint32_t binaryChildren[WideBVHNode::Width] = { binaryNode.m_LeftFirst, binaryNode.m_LeftFirst + 1 };
+      uint32_t binaryChildCount = 2;
+      while (binaryChildCount < WideBVHNode::Width)
+      {
+         int largest = -1;
+         float largestArea = -1.0f;
+         for (uint32_t i = 0; i < binaryChildCount; i++)
+         {
+            const BVHNode& child = nodes[binaryChildren[i]];
+            float area = AABB(child.m_Min, child.m_Max).GetSurfaceArea();
+            if (not child.IsLeaf() && area > largestArea)
+            {
+               largest = (int)i;
+               largestArea = area;
+            }
+         }
+
+         if (largest == -1)
+         {
+            break;
+         }
+
+         uint32_t opened = binaryChildren[largest];
+         binaryChildren[largest] = nodes[opened].m_LeftFirst;
+         binaryChildren[binaryChildCount++] = nodes[opened].m_LeftFirst + 1;
+      }
+
+      for (uint32_t i = 0; i < binaryChildCount; i++)
+      {
+         const BVHNode& child = nodes[binaryChildren[i]];
+         const AABB childBounds(child.m_Min, child.m_Max);
+         if (child.IsLeaf() && child.m_Count <= WideBVHNode::MaxLeafCount)
+         {
+            children[childCount++] = { childBounds, child.m_LeftFirst, child.m_Count };
+            continue;
+         }
+
+         uint32_t wideIndex = (uint32_t)wideNodes.size();
+         wideNodes.emplace_back();
+         todo.push_back({ binaryChildren[i], wideIndex, child.m_LeftFirst, child.m_Count });
+         children[childCount++] = { childBounds, wideIndex, 0 };
+      }
+
+      WriteNode(wideNodes[pending.WideIndex], children, childCount);
+   }
+
+   wideNodes.shrink_to_fit();
+   return wideNodes;
+}
+
+std::vector<BVHNode> WideBVHBuilder::Expand(const WideBVHNode* nodes, uint32_t nodeCount)
+{
+   std::vector<BVHNode> binaryNodes;
+   if (nodeCount == 0)
+   {
+      return binaryNodes;
+   }
+
+   // A binary node still to be filled from up to Width children of one wide node
+   struct Pending
+   {
+      uint32_t BinaryIndex;
+      WideChild Children[WideBVHNode::Width];
+      uint32_t ChildCount;
+   };
+
+   auto getChildren = [&](uint32_t wideIndex, Pending& pending)
+   {
+      const WideBVHNode& node = nodes[wideIndex];
+      pending.ChildCount = 0;
+      for (uint32_t i = 0; i < WideBVHNode::Width; i++)
+      {
+         if (node.m_ChildMask & (1u << i))
+         {
+            pending.Children[pending.ChildCount++] = { GetChildBounds(node, i), node.m_Children[i], node.m_Counts[i] };
+         }
+      }
+   };
+
+   binaryNodes.reserve(2 * (size_t)nodeCount);
+   binaryNodes.emplace_back();
+   std::vector<Pending> todo(1);
+   todo[0].BinaryIndex = 0;
+   getChildren(0, todo[0]);
+
+   while (not todo.empty())
+   {
+      Pending pending = todo.back();
+      todo.pop_back();
+
+      // A single inner child takes the place of this node, a single leaf child becomes it
+      while (pending.ChildCount == 1 && pending.Children[0].Count == 0)
+      {
+         getChildren(pending.Children[0].Index, pending);
+      }
+
+      AABB bounds;
+      for (uint32_t i = 0; i < pending.ChildCount; i++)
+      {
+         bounds.Grow(pending.Children[i].Bounds);
+      }
+
+      BVHNode& node = binaryNodes[pending.BinaryIndex];
+      node.m_Min = bounds.m_Min;
+      node.m_Max = bounds.m_Max;
+      if (pending.ChildCount == 1)
+      {
+         node.m_LeftFirst = pending.Children[0].Index;
+         node.m_Count = pending.Children[0].Count;
+         continue;
+      }
+
+      // The first half of the children goes left, the rest right
+      const uint32_t leftIndex = (uint32_t)binaryNodes.size();
+      node.m_LeftFirst = leftIndex;
+      node.m_Count = 0;
+      binaryNodes.emplace_back();
+      binaryNodes.emplace_back();
+
+      const uint32_t leftCount = pending.ChildCount / 2;
+      Pending left = { leftIndex, {}, leftCount };
+      Pending right = { leftIndex + 1, {}, pending.ChildCount - leftCount };
+      std::copy(pending.Children, pending.Children + leftCount, left.Children);
+      std::copy(pending.Children + leftCount, pending.Children + pending.ChildCount, right.Children);
+      todo.push_back(right);
+      todo.push_back(left);
+   }
+
+   binaryNodes.shrink_to_fit();
+   return binaryNodes;
+}
+
+AABB WideBVHBuilder::GetChildBounds(const WideBVHNode& node, uint32_t child)
+{
+   AABB bounds;
+   for (int axis = 0; axis < 3; axis++)
+   {
+#if RT_QUANTIZED_WIDE_BVH
+      const float scale = std::ldexp(1.0f, node.m_Exponent[axis]);
+      bounds.m_Min[axis] = node.m_Origin[axis] + (float)node.m_QuantizedMin[axis][child] * scale;
+      bounds.m_Max[axis] = node.m_Origin[axis] + (float)node.m_QuantizedMax[axis][child] * scale;
+#else
+      bounds.m_Min[axis] = node.m_Min[axis][child];
+      bounds.m_Max[axis] = node.m_Max[axis][child];
+#endif
+   }
+   return bounds;
+}
+
+AABB WideBVHBuilder::GetBounds(const WideBVHNode& node)
+{
+   AABB bounds;
+   for (uint32_t i = 0; i < WideBVHNode::Width; i++)
+   {
+      if (node.m_ChildMask & (1u << i))
+      {
+         bounds.Grow(GetChildBounds(node, i));
+      }
+   }
+   return bounds;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "Acceleration/BVH.h"
+#include "Acceleration/WideBVHNode.h"
+
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+   #include <emmintrin.h>
+   #define RT_WIDE_BVH_SSE 1
+#else
+   #define RT_WIDE_BVH_SSE 0
+#endif
+
+class WideBVHBuilder
+{
+public:
+   // Collapses a binary BVH into a 4-wide one over the same primitive order, by opening the inner child
+   // with the largest surface area until a node has four children
+   static std::vector<WideBVHNode> Collapse(const BVHNode* nodes, uint32_t nodeCount);
+   // A binary BVH over the same primitive order, every wide node becomes a balanced subtree of its children. For writing
+   // meshes that only keep the wide layout to formats that store the binary one
+   static std::vector<BVHNode> Expand(const WideBVHNode* nodes, uint32_t nodeCount);
+
+   // Decoded, quantized bounds come out as stored (rounded outwards)
+   static AABB GetChildBounds(const WideBVHNode& node, uint32_t child);
+   // Of all children of the node
+   static AABB GetBounds(const WideBVHNode& node);
+};
+
+// The ray in the form the node test wants it, set up once per traversal
+struct WideBVHRay
+{
+#if RT_WIDE_BVH_SSE
+   __m128 Origin[3];
+   __m128 InvDirection[3];
+#else
+   glm::vec3 Origin;
+   glm::vec3 InvDirection;
+#endif
+
+   WideBVHRay(const Ray& ray, const glm::vec3& invDirection)
+   {
+#if RT_WIDE_BVH_SSE
+      for (int axis = 0; axis < 3; axis++)
+      {
+         Origin[axis] = _mm_set1_ps(ray.Origin[axis]);
+         InvDirection[axis] = _mm_set1_ps(invDirection[axis]);
+      }
+#else
+      Origin = ray.Origin;
+      InvDirection = invDirection;
+#endif
+   }
+};
+
+#if RT_WIDE_BVH_SSE && RT_QUANTIZED_WIDE_BVH
+inline __m128 UnpackQuantized(const uint8_t quantized[WideBVHNode::Width])
+{
+   int32_t packed;
+   memcpy(&packed, quantized, sizeof(packed));
+
+   const __m128i zero = _mm_setzero_si128();
+   __m128i bytes = _mm_cvtsi32_si128(packed);
+   return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+}
+#endif
+
+// Slab test against all children of the node at once, with the same rules as IntersectAABB.
+// Returns the mask of the children hit before closestT, outDistances receives their entry distances
+inline uint32_t IntersectWideNode(const WideBVHNode& node, const WideBVHRay& ray, float closestT, float outDistances[WideBVHNode::Width])
+{
+#if RT_WIDE_BVH_SSE
+   __m128 tNear = _mm_set1_ps(-FLT_MAX);
+   __m128 tFar = _mm_set1_ps(FLT_MAX);
+   for (int axis = 0; axis < 3; axis++)
+   {
+   #if RT_QUANTIZED_WIDE_BVH
+      const __m128 origin = _mm_set1_ps(node.m_Origin[axis]);
+      const __m128 scale = _mm_castsi128_ps(_mm_set1_epi32((node.m_Exponent[axis] + 127) << 23));
+      const __m128 min = _mm_add_ps(origin, _mm_mul_ps(UnpackQuantized(node.m_QuantizedMin[axis]), scale));
+      const __m128 max = _mm_add_ps(origin, _mm_mul_ps(UnpackQuantized(node.m_QuantizedMax[axis]), scale));
+   #else
+      const __m128 min = _mm_load_ps(node.m_Min[axis]);
+      const __m128 max = _mm_load_ps(node.m_Max[axis]);
+   #endif
+      __m128 t0 = _mm_mul_ps(_mm_sub_ps(min, ray.Origin[axis]), ray.InvDirection[axis]);
+      __m128 t1 = _mm_mul_ps(_mm_sub_ps(max, ray.Origin[axis]), ray.InvDirection[axis]);
+      tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+      tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+   }
+
+   __m128 hit = _mm_and_ps(_mm_cmpge_ps(tFar, tNear), _mm_cmpgt_ps(tFar, _mm_setzero_ps()));
+   hit = _mm_and_ps(hit, _mm_cmplt_ps(tNear, _mm_set1_ps(closestT)));
+   _mm_storeu_ps(outDistances, tNear);
+   return (uint32_t)_mm_movemask_ps(hit) & node.m_ChildMask;
+#else
+   uint32_t hitMask = 0;
+   for (uint32_t child = 0; child < WideBVHNode::Width; child++)
+   {
+      glm::vec3 min, max;
+      for (int axis = 0; axis < 3; axis++)
+      {
+   #if RT_QUANTIZED_WIDE_BVH
+         const float scale = std::ldexp(1.0f, node.m_Exponent[axis]);
+         min[axis] = node.m_Origin[axis] + (float)node.m_QuantizedMin[axis][child] * scale;
+         max[axis] = node.m_Origin[axis] + (float)node.m_QuantizedMax[axis][child] * scale;
+   #else
+         min[axis] = node.m_Min[axis][child];
+         max[axis] = node.m_Max[axis][child];
+   #endif
+      }
+
+      glm::vec3 t0 = (min - ray.Origin) * ray.InvDirection;
+      glm::vec3 t1 = (max - ray.Origin) * ray.InvDirection;
+      glm::vec3 tMin = glm::min(t0, t1);
+      glm::vec3 tMax = glm::max(t0, t1);
+      float tNear = glm::max(glm::max(tMin.x, tMin.y), tMin.z);
+      float tFar = glm::min(glm::min(tMax.x, tMax.y), tMax.z);
+
+      outDistances[child] = tNear;
+      if (tFar >= tNear && tFar > 0.0f && tNear < closestT)
+      {
+         hitMask |= 1u << child;
+      }
+   }
+   return hitMask & node.m_ChildMask;
+#endif
+}
+
+// Closest-hit traversal of a wide BVH, nearest child first. Same contract as TraverseBVH, but the returned
+// count is of wide nodes, each of which tests all of its children at once
+template<typename IntersectPrimitive>
+uint32_t TraverseWideBVH(const WideBVHNode* nodes, uint32_t nodeCount, const Ray& ray, const glm::vec3& invDirection, float& closestT, IntersectPrimitive&& intersectPrimitive)
+{
+   if (nodeCount == 0)
+   {
+      return 0;
+   }
+
+   struct StackEntry
+   {
+      uint32_t NodeIndex;
+      float Distance;
+   };
+   // Every level pushes at most three more entries than it pops
+   StackEntry stack[192];
+   uint32_t stackSize = 0;
+
+   const WideBVHRay wideRay(ray, invDirection);
+   uint32_t nodeTests = 0;
+   uint32_t nodeIndex = 0;
+   while (true)
+   {
+      const WideBVHNode& node = nodes[nodeIndex];
+      float distances[WideBVHNode::Width];
+      uint32_t hitMask = IntersectWideNode(node, wideRay, closestT, distances);
+      nodeTests++;
+
+      // Leaves are intersected right away, inner children go on the stack farthest first
+      StackEntry inner[WideBVHNode::Width];
+      uint32_t innerCount = 0;
+      while (hitMask != 0)
+      {
+         uint32_t child = (uint32_t)std::countr_zero(hitMask);
+         hitMask &= hitMask - 1;
+
+         if (node.m_Counts[child] > 0)
+         {
+            for (uint32_t i = 0; i < node.m_Counts[child]; i++)
+            {
+               intersectPrimitive(node.m_Children[child] + i);
+            }
+            continue;
+         }
+
+         // Insertion sort, nearest last
+         uint32_t position = innerCount++;
+         while (position > 0 && inner[position - 1].Distance < distances[child])
+         {
+            inner[position] = inner[position - 1];
+            position--;
+         }
+         inner[position] = { node.m_Children[child], distances[child] };
+      }
+
+      for (uint32_t i = 0; i < innerCount; i++)
+      {
+         stack[stackSize++] = inner[i];
+      }
+
+      // Pop the next node that can still hold a closer hit
+      bool found = false;
+      while (stackSize > 0)
+      {
+         const StackEntry& entry = stack[--stackSize];
+         if (entry.Distance < closestT)
+         {
+            nodeIndex = entry.NodeIndex;
+            found = true;
+            break;
+         }
+      }
+
+      if (not found)
+      {
+         break;
+      }
+   }
+
+   return nodeTests;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+
+// Stores the children of wide nodes as 8 bit coordinates relative to the node (one cache line per node)
+// instead of floats (two cache lines). Trades a few instructions per node for half the memory traffic
+#ifndef RT_QUANTIZED_WIDE_BVH
+   #define RT_QUANTIZED_WIDE_BVH 0
+#endif
+
+// A node of the 4-wide BVH collapsed from the binary one. The bounds of all children are stored per axis ([axis][child])
+// so they are tested at once. Child slot i is used when bit i of m_ChildMask is set
+struct alignas(64) WideBVHNode
+{
+   static constexpr uint32_t Width = 4;
+   static constexpr uint32_t MaxLeafCount = UINT16_MAX;
+
+#if RT_QUANTIZED_WIDE_BVH
+   // Child bounds are m_Origin + q * 2^m_Exponent, rounded outwards
+   glm::vec3 m_Origin;
+   int8_t m_Exponent[3];
+   uint8_t m_ChildMask;
+   uint8_t m_QuantizedMin[3][Width];
+   uint8_t m_QuantizedMax[3][Width];
+#else
+   float m_Min[3][Width];
+   float m_Max[3][Width];
+#endif
+
+   uint32_t m_Children[Width]; // Inner child: index of its wide node. Leaf: first primitive
+   uint16_t m_Counts[Width];   // Primitives of a leaf child, 0 for inner children
+
+#if !RT_QUANTIZED_WIDE_BVH
+   uint8_t m_ChildMask;
+#endif
+};
+
+#if RT_QUANTIZED_WIDE_BVH
+static_assert(sizeof(WideBVHNode) == 64);
+#else
+static_assert(sizeof(WideBVHNode) == 128);
+#endif
@@ -0,0 +1,112 @@
+#include "AccumulationBuffer.h"
+
+#include <cstring>
+#include <utility>
+
+uint32_t AccumulationBuffer::GetBytesPerPixel(AccumulationFormat format)
+{
+   switch (format)
+   {
+   case AccumulationFormat::RGB16F:  return 3 * sizeof(uint16_t) + sizeof(float);
+   case AccumulationFormat::RGB9E5:  return sizeof(uint32_t) + sizeof(float);
+   case AccumulationFormat::RGBA32F:
+   default:                          return sizeof(glm::vec4);
+   }
+}
+
+void AccumulationBuffer::Resize(uint32_t pixelCount, AccumulationFormat format)
+{
+   // Switching formats gives the memory of the previous one back
+   if (format != m_Format)
+   {
+      m_Sums.Free();
+      m_HalfMeans.Free();
+      m_SharedExponentMeans.Free();
+      m_Weights.Free();
+   }
+
+   m_Format = format;
+   m_PixelCount = pixelCount;
+
+   switch (format)
+   {
+   case AccumulationFormat::RGB16F:
+      m_HalfMeans.Resize(pixelCount * 3);
+      m_Weights.Resize(pixelCount);
+      break;
+   case AccumulationFormat::RGB9E5:
+      m_SharedExponentMeans.Resize(pixelCount);
+      m_Weights.Resize(pixelCount);
+      break;
+   case AccumulationFormat::RGBA32F:
+   default:
+      m_Sums.Resize(pixelCount);
+      break;
+   }
+}
+
+void AccumulationBuffer::Clear()
+{
+   // All formats encode black as zero bits
+   switch (m_Format)
+   {
+   case AccumulationFormat::RGB16F:
+      memset(m_HalfMeans.data(), 0, m_HalfMeans.size() * sizeof(uint16_t));
+      memset(m_Weights.data(), 0, m_Weights.size() * sizeof(float));
+      break;
+   case AccumulationFormat::RGB9E5:
+      memset(m_SharedExponentMeans.data(), 0, m_SharedExponentMeans.size() * sizeof(uint32_t));
+      memset(m_Weights.data(), 0, m_Weights.size() * sizeof(float));
+      break;
+   case AccumulationFormat::RGBA32F:
+   default:
+      memset(m_Sums.data(), 0, m_Sums.size() * sizeof(glm::vec4));
+      break;
+   }
+}
+
+void AccumulationBuffer::Clear(uint32_t index)
+{
+   switch (m_Format)
+   {
+   case AccumulationFormat::RGB16F:
+      m_HalfMeans[index * 3 + 0] = m_HalfMeans[index * 3 + 1] = m_HalfMeans[index * 3 + 2] = 0;
+      m_Weights[index] = 0.0f;
+      break;
+   case AccumulationFormat::RGB9E5:
+      m_SharedExponentMeans[index] = 0;
+      m_Weights[index] = 0.0f;
+      break;
+   case AccumulationFormat::RGBA32F:
+   default:
+      m_Sums[index] = glm::vec4(0.0f);
+      break;
+   }
+}
+
+std::vector<std::span<const uint8_t>> AccumulationBuffer::GetRawData() const
+{
+   const uint64_t pixelCount = m_PixelCount;
+   switch (m_Format)
+   {
+   case AccumulationFormat::RGB16F:
+      return { { (const uint8_t*)m_HalfMeans.data(), pixelCount * 3 * sizeof(uint16_t) },
+               { (const uint8_t*)m_Weights.data(), pixelCount * sizeof(float) } };
+   case AccumulationFormat::RGB9E5:
+      return { { (const uint8_t*)m_SharedExponentMeans.data(), pixelCount * sizeof(uint32_t) },
+               { (const uint8_t*)m_Weights.data(), pixelCount * sizeof(float) } };
+   case AccumulationFormat::RGBA32F:
+   default:
+      return { { (const uint8_t*)m_Sums.data(), pixelCount * sizeof(glm::vec4) } };
+   }
+}
+
+std::vector<std::span<uint8_t>> AccumulationBuffer::GetRawData()
+{
+   std::vector<std::span<uint8_t>> buffers;
+   for (std::span<const uint8_t> buffer : std::as_const(*this).GetRawData())
+   {
+      buffers.emplace_back(const_cast<uint8_t*>(buffer.data()), buffer.size());
+   }
+   return buffers;
+}
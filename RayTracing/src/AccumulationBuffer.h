@@ -0,0 +1,189 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include "AppRandom.h"
+#include "Memory/AlignedBuffer.h"
+
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+enum class AccumulationFormat
+{
+   RGBA32F = 0, // Filter weighted color sum and weight sum, 16 bytes per pixel
+   RGB16F,      // Running mean in half floats and a float weight sum, 10 bytes per pixel
+   RGB9E5,      // Running mean with a shared exponent and a float weight sum, 8 bytes per pixel
+};
+
+// The samples of every pixel of the image, averaged with their filter weights.
+// The compact formats can't keep sums (they would run out of precision within a few hundred frames), they store the mean
+// so far and fold each sample into it. The mean is rounded stochastically, so the small steps of late samples still move it
+// on average instead of being rounded away
+class AccumulationBuffer
+{
+public:
+   static uint32_t GetBytesPerPixel(AccumulationFormat format);
+
+   // The contents are undefined until Clear()
+   void Resize(uint32_t pixelCount, AccumulationFormat format);
+   void Clear();
+   void Clear(uint32_t index);
+
+   // seed feeds the stochastic rounding of the compact formats
+   void Add(uint32_t index, const glm::vec3& color, float weight, uint32_t& seed)
+   {
+      switch (m_Format)
+      {
+      case AccumulationFormat::RGB16F:
+      {
+         float weightSum = m_Weights[index] + weight;
+         if (weightSum > 0.0f)
+         {
+            uint16_t* mean = &m_HalfMeans[index * 3];
+            const glm::vec3 random = GetRoundingOffsets(seed);
+            for (int i = 0; i < 3; i++)
+            {
+               float value = UnpackHalf(mean[i]);
+               value += (color[i] - value) * (weight / weightSum);
+               mean[i] = PackHalf(value, random[i]);
+            }
+         }
+         m_Weights[index] = weightSum;
+         break;
+      }
+      case AccumulationFormat::RGB9E5:
+      {
+         float weightSum = m_Weights[index] + weight;
+         if (weightSum > 0.0f)
+         {
+            glm::vec3 mean = UnpackRGB9E5(m_SharedExponentMeans[index]);
+            mean += (color - mean) * (weight / weightSum);
+            m_SharedExponentMeans[index] = PackRGB9E5(mean, GetRoundingOffsets(seed));
+         }
+         m_Weights[index] = weightSum;
+         break;
+      }
+      case AccumulationFormat::RGBA32F:
+      default:
+         m_Sums[index] += glm::vec4(color * weight, weight);
+         break;
+      }
+   }
+
+   // Merges samples accumulated elsewhere, given by the sum of their filter weighted colors (rgb) and weights (a)
+   void AddSum(uint32_t index, const glm::vec4& sum, uint32_t& seed)
+   {
+      if (m_Format == AccumulationFormat::RGBA32F)
+      {
+         m_Sums[index] += sum;
+      }
+      else if (sum.a > 0.0f)
+      {
+         Add(index, glm::vec3(sum) / sum.a, sum.a, seed);
+      }
+   }
+
+   // The weighted mean of the samples, black before the first one
+   glm::vec3 GetColor(uint32_t index) const
+   {
+      switch (m_Format)
+      {
+      case AccumulationFormat::RGB16F:
+      {
+         const uint16_t* mean = &m_HalfMeans[index * 3];
+         return glm::vec3(UnpackHalf(mean[0]), UnpackHalf(mean[1]), UnpackHalf(mean[2]));
+      }
+      case AccumulationFormat::RGB9E5:
+         return UnpackRGB9E5(m_SharedExponentMeans[index]);
+      case AccumulationFormat::RGBA32F:
+      default:
+      {
+         const glm::vec4& sum = m_Sums[index];
+         return (sum.a > 0.0f) ? glm::vec3(sum) / sum.a : glm::vec3(0.0f);
+      }
+      }
+   }
+
+   float GetWeight(uint32_t index) const { return (m_Format == AccumulationFormat::RGBA32F) ? m_Sums[index].a : m_Weights[index]; }
+
+   AccumulationFormat GetFormat() const { return m_Format; }
+   uint32_t GetPixelCount() const { return m_PixelCount; }
+   // The raw sums, nullptr unless the format is RGBA32F
+   const glm::vec4* GetSums() const { return (m_Format == AccumulationFormat::RGBA32F) ? m_Sums.data() : nullptr; }
+   // The buffers of the format as they are in memory, the means (or sums) before the weights. Checkpoints save and restore
+   // them byte for byte into a buffer of the same format and size
+   std::vector<std::span<const uint8_t>> GetRawData() const;
+   std::vector<std::span<uint8_t>> GetRawData();
+private:
+   static float Exp2(int exponent) { return std::bit_cast<float>((uint32_t)(exponent + 127) << 23); }
+   // floor(log2(value)) of a positive normal float
+   static int Log2(float value) { return (int)((std::bit_cast<uint32_t>(value) >> 23) & 0xff) - 127; }
+
+   // Three uniform offsets in (0, 1) from a single hash, 10 bits each is plenty for rounding
+   static glm::vec3 GetRoundingOffsets(uint32_t& seed)
+   {
+      seed = AppRandom::PCGHash(seed);
+      return (glm::vec3((float)(seed & 0x3ff), (float)((seed >> 10) & 0x3ff), (float)((seed >> 20) & 0x3ff)) + 0.5f) * (1.0f / 1024.0f);
+   }
+
+   // Rounds up when the dropped fraction of the mantissa is above random, down otherwise
+   static uint16_t PackHalf(float value, float random)
+   {
+      value = glm::clamp(value, 0.0f, 65504.0f);
+
+      // Halves below 2^-14 are denormals with the exponent of 2^-14
+      int exponent = (value < 6.103515625e-05f) ? -14 : Log2(value);
+      uint32_t mantissa = (uint32_t)(value * Exp2(10 - exponent) + random);
+
+      // A mantissa rounded up to 2048 carries into the exponent on its own
+      uint32_t bits = ((uint32_t)(exponent + 15) << 10) + mantissa - 1024;
+      return (uint16_t)glm::min(bits, 0x7bffu);
+   }
+
+   static float UnpackHalf(uint16_t bits)
+   {
+      int exponent = bits >> 10;
+      uint32_t mantissa = bits & 0x3ff;
+      return (exponent == 0) ? (float)mantissa * Exp2(-24) : (float)(mantissa | 0x400) * Exp2(exponent - 25);
+   }
+
+   // 9 bit mantissas scaled by a shared 5 bit exponent (bias 15) in the top bits, the layout of the GL_RGB9_E5 texture format
+   static uint32_t PackRGB9E5(glm::vec3 color, const glm::vec3& random)
+   {
+      color = glm::clamp(color, glm::vec3(0.0f), glm::vec3(65408.0f));
+      float maxChannel = glm::max(color.r, glm::max(color.g, color.b));
+      if (maxChannel < Exp2(-24))
+      {
+         return 0;
+      }
+
+      int exponent = glm::max(Log2(maxChannel), -16) + 1;
+      if ((uint32_t)(maxChannel * Exp2(9 - exponent) + 0.5f) == 512)
+      {
+         exponent++;
+      }
+
+      const float scale = Exp2(9 - exponent);
+      uint32_t r = glm::min((uint32_t)(color.r * scale + random.r), 511u);
+      uint32_t g = glm::min((uint32_t)(color.g * scale + random.g), 511u);
+      uint32_t b = glm::min((uint32_t)(color.b * scale + random.b), 511u);
+      return ((uint32_t)(exponent + 15) << 27) | (b << 18) | (g << 9) | r;
+   }
+
+   static glm::vec3 UnpackRGB9E5(uint32_t bits)
+   {
+      const float scale = Exp2((int)(bits >> 27) - 15 - 9);
+      return glm::vec3((float)(bits & 0x1ff), (float)((bits >> 9) & 0x1ff), (float)((bits >> 18) & 0x1ff)) * scale;
+   }
+
+   AccumulationFormat m_Format = AccumulationFormat::RGBA32F;
+   uint32_t m_PixelCount = 0;
+
+   // Only the buffers of the format are allocated
+   AlignedBuffer<glm::vec4> m_Sums;
+   AlignedBuffer<uint16_t> m_HalfMeans; // 3 per pixel
+   AlignedBuffer<uint32_t> m_SharedExponentMeans;
+   AlignedBuffer<float> m_Weights;
+};
@@ -42,6 +42,49 @@ public:
 	{
 		return glm::normalize(Vec3(-1.0f, 1.0f));
 	}
+
+	// Stateless sampler used by the renderer. The seed is derived from the pixel and frame index,
+	// which makes every sample reproducible no matter which thread renders it
+	static uint32_t PCGHash(uint32_t input)
+	{
+		uint32_t state = input * 747796405u + 2891336453u;
+		uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+		return (word >> 22u) ^ word;
+	}
+
+	// Seed of a pixel, from its index in the whole image. The upper half of the index is folded in so images
+	// past 2^32 pixels don't repeat seeds, below that it is the same as PCGHash(index ^ frameSeed)
+	static uint32_t PixelSeed(uint64_t pixelIndex, uint32_t frameSeed)
+	{
+		const uint32_t high = (uint32_t)(pixelIndex >> 32);
+		return PCGHash((uint32_t)pixelIndex ^ (high * 2654435769u) ^ frameSeed);
+	}
+
+	static float Float(uint32_t& seed)
+	{
+		seed = PCGHash(seed);
+		return (float)seed / (float)std::numeric_limits<uint32_t>::max();
+	}
+
+	static glm::vec2 Vec2(uint32_t& seed)
+	{
+		float u = Float(seed);
+		float v = Float(seed);
+		return glm::vec2(u, v);
+	}
+
+	static glm::vec3 Vec3(uint32_t& seed, float min, float max)
+	{
+		float x = Float(seed);
+		float y = Float(seed);
+		float z = Float(seed);
+		return glm::vec3(x, y, z) * (max - min) + min;
+	}
+
+	static glm::vec3 InUnitSphere(uint32_t& seed)
+	{
+		return glm::normalize(Vec3(seed, -1.0f, 1.0f));
+	}
 private:
 	inline static thread_local std::mt19937 s_RandomEngine;
 	inline static std::uniform_int_distribution<std::mt19937::result_type> s_Distribution;
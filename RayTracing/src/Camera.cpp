@@ -1,10 +1,13 @@
 #include "Camera.h"
+#include "Core.h"
 
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/quaternion.hpp>
-#include <glm/gtx/quaternion.hpp>
+#include <execution>
+
+#if defined(RT_SIMD_SSE)
+#include <immintrin.h>
+#endif
 
-#include "Walnut/Input/Input.h"
+#include <glm/gtc/matrix_transform.hpp>
 
 Camera::Camera(float verticalFOV, float nearClip, float farClip)
    : m_VerticalFOV(verticalFOV), m_NearClip(nearClip), m_FarClip(farClip)
@@ -13,100 +16,53 @@ Camera::Camera(float verticalFOV, float nearClip, float farClip)
    m_Position = glm::vec3(0, 0, 3);
 }
 
-bool Camera::Update(float ts)
+void Camera::Resize(uint32_t width, uint32_t height)
 {
-   static const float sensitivity = 0.002f;
-   glm::vec2 mousePos = Walnut::Input::GetMousePosition();
-   glm::vec2 mouseDelta = (mousePos - m_LastMousePosition) * sensitivity;
-   m_LastMousePosition = mousePos;
-
-   if (not Walnut::Input::IsMouseButtonDown(Walnut::MouseButton::Right))
-   {
-      // If we're not moving the camera, we just stop here
-      Walnut::Input::SetCursorMode(Walnut::CursorMode::Normal);
-      return false;
-   }
-
-   Walnut::Input::SetCursorMode(Walnut::CursorMode::Locked);
-
-   constexpr glm::vec3 upDirection(0.0f, 1.0f, 0.0f);
-   glm::vec3 rightDirection = glm::cross(m_ForwardDirection, upDirection);
-
-   float speed = 5.0f;
-   bool moved = false;
-
-   // Movement
-   if (Walnut::Input::IsKeyDown(Walnut::KeyCode::W))
-   {
-      m_Position += m_ForwardDirection * speed * ts;
-      moved = true;
-   }
-   else if (Walnut::Input::IsKeyDown(Walnut::KeyCode::S))
-   {
-      m_Position -= m_ForwardDirection * speed * ts;
-      moved = true;
-   }
-
-   if (Walnut::Input::IsKeyDown(Walnut::KeyCode::A))
-   {
-      m_Position -= rightDirection * speed * ts;
-      moved = true;
-   }
-   else if (Walnut::Input::IsKeyDown(Walnut::KeyCode::D))
+   if (width == m_ViewportWidth && height == m_ViewportHeight)
    {
-      m_Position += rightDirection * speed * ts;
-      moved = true;
+      return;
    }
 
-   if (Walnut::Input::IsKeyDown(Walnut::KeyCode::Q))
-   {
-      m_Position -= upDirection * speed * ts;
-      moved = true;
-   }
-   else if (Walnut::Input::IsKeyDown(Walnut::KeyCode::E))
-   {
-      m_Position += upDirection * speed * ts;
-      moved = true;
-   }
+   m_ViewportWidth = width;
+   m_ViewportHeight = height;
 
-   // Rotation
-   if (mouseDelta.x != 0.0f || mouseDelta.y != 0.0f)
-   {
-      float pitchDelta = mouseDelta.y * GetRotationSpeed();
-      float yawDelta = mouseDelta.x * GetRotationSpeed();
+   RecalculateProjection();
+   RecalculateRayBasis();
+   RecalculateRayDirections();
+}
 
-      // Build quaternion for the forward direction using the right/up directions with corresponding pitch/yaws
-      glm::quat q = glm::normalize(glm::cross(
-                        glm::angleAxis(-pitchDelta, rightDirection),
-                        glm::angleAxis(-yawDelta, upDirection)
-      ));
+void Camera::SetView(const glm::vec3& position, const glm::vec3& forwardDirection)
+{
+   m_Position = position;
+   m_ForwardDirection = glm::normalize(forwardDirection);
 
-      m_ForwardDirection = glm::rotate(q, m_ForwardDirection);
+   RecalculateView();
+   RecalculateRayBasis();
+   RecalculateRayDirections();
+}
 
-      moved = true;
-   }
+void Camera::SetCropWindow(uint32_t offsetX, uint32_t offsetY, uint32_t imageWidth, uint32_t imageHeight)
+{
+   m_CropOffset = { offsetX, offsetY };
+   m_CropImageSize = { imageWidth, imageHeight };
 
-   if (moved)
-   {
-      RecalculateView();
-      RecalculateRayDirections();
-   }
+   RecalculateProjection();
+   RecalculateRayBasis();
+   RecalculateRayDirections();
+}
 
-   return moved;
+void Camera::ClearCropWindow()
+{
+   SetCropWindow(0, 0, 0, 0);
 }
 
-void Camera::Resize(uint32_t width, uint32_t height)
+glm::uvec2 Camera::GetImageSize() const
 {
-   if (width == m_ViewportWidth && height == m_ViewportHeight)
+   if (m_CropImageSize.x != 0 && m_CropImageSize.y != 0)
    {
-      return;
+      return m_CropImageSize;
    }
-
-   m_ViewportWidth = width;
-   m_ViewportHeight = height;
-
-   RecalculateProjection();
-   RecalculateRayDirections();
+   return { (uint32_t)m_ViewportWidth, (uint32_t)m_ViewportHeight };
 }
 
 float Camera::GetRotationSpeed()
@@ -116,7 +72,13 @@ float Camera::GetRotationSpeed()
 
 void Camera::RecalculateProjection()
 {
-   m_Projection = glm::perspectiveFov(glm::radians(m_VerticalFOV), (float)m_ViewportWidth, (float)m_ViewportHeight, m_NearClip, m_FarClip);
+   const glm::uvec2 imageSize = GetImageSize();
+   if (imageSize.x == 0 || imageSize.y == 0)
+   {
+      return;
+   }
+
+   m_Projection = glm::perspectiveFov(glm::radians(m_VerticalFOV), (float)imageSize.x, (float)imageSize.y, m_NearClip, m_FarClip);
    m_InverseProjection = glm::inverse(m_Projection);
 }
 
@@ -126,31 +88,155 @@ void Camera::RecalculateView()
    m_InverseView = glm::inverse(m_View);
 }
 
+void Camera::RecalculateRayBasis()
+{
+   if (m_ViewportWidth == 0 || m_ViewportHeight == 0)
+   {
+      return;
+   }
+
+   // [NDC -> Clipspace -> Viewspace] is affine in the NDC coordinates for a perspective projection (w is constant),
+   // so the whole image plane can be described by one corner and a step per pixel in each direction
+   auto unproject = [this](float ndcX, float ndcY)
+   {
+      glm::vec4 clipCoord = m_InverseProjection * glm::vec4(ndcX, ndcY, 1, 1);
+      return glm::vec3(clipCoord) / clipCoord.w; // Perspective division
+   };
+
+   glm::vec3 bottomLeft = unproject(-1.0f, -1.0f);
+   glm::vec3 right = unproject(1.0f, -1.0f) - bottomLeft;
+   glm::vec3 up = unproject(-1.0f, 1.0f) - bottomLeft;
+
+   // Viewspace -> Worldspace. Normalizing after the rotation gives the same direction as normalizing before it
+   // The basis spans the whole image, a crop window only moves the pixels the rays are generated for
+   const glm::uvec2 imageSize = GetImageSize();
+   m_RayBasis.BottomLeft = glm::vec3(m_InverseView * glm::vec4(bottomLeft, 0.0f));
+   m_RayBasis.PixelRight = glm::vec3(m_InverseView * glm::vec4(right / (float)imageSize.x, 0.0f));
+   m_RayBasis.PixelUp    = glm::vec3(m_InverseView * glm::vec4(up / (float)imageSize.y, 0.0f));
+
+   m_RayBasis.Right   = glm::normalize(glm::vec3(m_InverseView[0]));
+   m_RayBasis.Up      = glm::normalize(glm::vec3(m_InverseView[1]));
+   m_RayBasis.Forward = -glm::normalize(glm::vec3(m_InverseView[2]));
+}
+
 void Camera::RecalculateRayDirections()
 {
-   m_RayDirections.resize(m_ViewportWidth * m_ViewportHeight);
+   if (m_RayGenerationMode != RayGenerationMode::Cached)
+   {
+      return;
+   }
+
+   const uint32_t width = (uint32_t)m_ViewportWidth;
+   const uint32_t height = (uint32_t)m_ViewportHeight;
+
+   m_RayDirections.resize(width * height);
+
+   if (m_ImageVerticalIter.size() != height)
+   {
+      m_ImageVerticalIter.resize(height);
+      for (uint32_t i = 0; i < height; i++)
+      {
+         m_ImageVerticalIter[i] = i;
+      }
+   }
+
+   std::for_each(std::execution::par, m_ImageVerticalIter.begin(), m_ImageVerticalIter.end(),
+      [this, width](uint32_t y)
+      {
+         GenerateRayDirections(y, m_RayDirections.data() + (y * width));
+      });
+}
+
+glm::vec3 Camera::GetRayDirection(float x, float y) const
+{
+   x += (float)m_CropOffset.x;
+   y += (float)m_CropOffset.y;
+   return glm::normalize(m_RayBasis.BottomLeft + x * m_RayBasis.PixelRight + y * m_RayBasis.PixelUp);
+}
 
-   for (uint32_t y = 0; y < m_ViewportHeight; y++)
+void Camera::GenerateRayDirections(uint32_t y, glm::vec3* outDirections, const glm::vec2* pixelOffsets) const
+{
+   const uint32_t width = (uint32_t)m_ViewportWidth;
+
+   uint32_t x = 0;
+#if defined(RT_SIMD_SSE)
+   const __m128 cornerX = _mm_set1_ps(m_RayBasis.BottomLeft.x);
+   const __m128 cornerY = _mm_set1_ps(m_RayBasis.BottomLeft.y);
+   const __m128 cornerZ = _mm_set1_ps(m_RayBasis.BottomLeft.z);
+   const __m128 rightX = _mm_set1_ps(m_RayBasis.PixelRight.x);
+   const __m128 rightY = _mm_set1_ps(m_RayBasis.PixelRight.y);
+   const __m128 rightZ = _mm_set1_ps(m_RayBasis.PixelRight.z);
+   const __m128 upX = _mm_set1_ps(m_RayBasis.PixelUp.x);
+   const __m128 upY = _mm_set1_ps(m_RayBasis.PixelUp.y);
+   const __m128 upZ = _mm_set1_ps(m_RayBasis.PixelUp.z);
+   const __m128 one = _mm_set1_ps(1.0f);
+   const __m128 four = _mm_set1_ps(4.0f);
+   const __m128 row = _mm_set1_ps((float)(y + m_CropOffset.y));
+
+   const float cropX = (float)m_CropOffset.x;
+   __m128 pixelX = _mm_setr_ps(cropX, cropX + 1.0f, cropX + 2.0f, cropX + 3.0f);
+   alignas(16) float dirX[4], dirY[4], dirZ[4];
+   for (; x + 4 <= width; x += 4)
    {
-      for (uint32_t x = 0; x < m_ViewportWidth; x++)
+      __m128 u = pixelX;
+      __m128 v = row;
+      if (pixelOffsets != nullptr)
       {
-         // From UV to world space [UV -> NDC -> Clipspace -> Viewspace -> Worldspace]
-         glm::vec2 uv = { (float)x / (float)m_ViewportWidth, (float)y / (float)m_ViewportHeight }; // UV [0, 1]
+         const glm::vec2* offsets = pixelOffsets + x;
+         u = _mm_add_ps(u, _mm_setr_ps(offsets[0].x, offsets[1].x, offsets[2].x, offsets[3].x));
+         v = _mm_add_ps(v, _mm_setr_ps(offsets[0].y, offsets[1].y, offsets[2].y, offsets[3].y));
+      }
 
-         // UV -> NDC
-         glm::vec2 ndc = uv * 2.0f - 1.0f; // NDC [-1, 1]
+      __m128 dx = _mm_add_ps(cornerX, _mm_add_ps(_mm_mul_ps(u, rightX), _mm_mul_ps(v, upX)));
+      __m128 dy = _mm_add_ps(cornerY, _mm_add_ps(_mm_mul_ps(u, rightY), _mm_mul_ps(v, upY)));
+      __m128 dz = _mm_add_ps(cornerZ, _mm_add_ps(_mm_mul_ps(u, rightZ), _mm_mul_ps(v, upZ)));
 
-         // NDC -> Clipspace
-         glm::vec4 clipCoord = m_InverseProjection * glm::vec4(ndc.x, ndc.y, 1, 1);
+      __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+      __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
 
-         // Clipspace -> Viewspace
-         glm::vec4 viewDirection = glm::vec4(glm::vec3(clipCoord) / clipCoord.w, 0.0f); // Perspective division
-         viewDirection = glm::normalize(viewDirection);
+      _mm_store_ps(dirX, _mm_mul_ps(dx, invLength));
+      _mm_store_ps(dirY, _mm_mul_ps(dy, invLength));
+      _mm_store_ps(dirZ, _mm_mul_ps(dz, invLength));
 
-         // Viewspace -> Worldspace
-         glm::vec3 rayDirection = glm::vec3(m_InverseView * viewDirection);
+      for (uint32_t i = 0; i < 4; i++)
+      {
+         outDirections[x + i] = glm::vec3(dirX[i], dirY[i], dirZ[i]);
+      }
 
-         m_RayDirections[x + y * m_ViewportWidth] = rayDirection;
+      pixelX = _mm_add_ps(pixelX, four);
+   }
+#endif
+
+   // Remainder of the row (or the whole row without SSE)
+   for (; x < width; x++)
+   {
+      glm::vec2 pixel = { (float)(x + m_CropOffset.x), (float)(y + m_CropOffset.y) };
+      if (pixelOffsets != nullptr)
+      {
+         pixel += pixelOffsets[x];
       }
+
+      outDirections[x] = glm::normalize(m_RayBasis.BottomLeft + pixel.x * m_RayBasis.PixelRight + pixel.y * m_RayBasis.PixelUp);
+   }
+}
+
+void Camera::SetRayGenerationMode(RayGenerationMode mode)
+{
+   if (m_RayGenerationMode == mode)
+   {
+      return;
+   }
+
+   m_RayGenerationMode = mode;
+
+   if (m_RayGenerationMode == RayGenerationMode::Cached)
+   {
+      RecalculateRayDirections();
+   }
+   else
+   {
+      // Give the memory back, the directions are generated while rendering
+      m_RayDirections.clear();
+      m_RayDirections.shrink_to_fit();
    }
 }
@@ -3,13 +3,45 @@
 #include <glm/glm.hpp>
 #include <vector>
 
+enum class RayGenerationMode
+{
+   Cached = 0, // Directions for every pixel are stored when the camera moves (12 bytes per pixel)
+   OnTheFly,   // Directions are derived from the ray basis inside the render kernel, one row at a time
+};
+
 class Camera
 {
 public:
+   // World space basis of the image plane. The (unnormalized) direction through pixel (x, y) is
+   // BottomLeft + x * PixelRight + y * PixelUp
+   struct RayBasis
+   {
+      glm::vec3 BottomLeft = {};
+      glm::vec3 PixelRight = {};
+      glm::vec3 PixelUp = {};
+
+      // Unit camera axes in world space, used to place samples on the lens
+      glm::vec3 Right = { 1.0f, 0.0f, 0.0f };
+      glm::vec3 Up = { 0.0f, 1.0f, 0.0f };
+      glm::vec3 Forward = { 0.0f, 0.0f, -1.0f };
+   };
+
+   struct Lens
+   {
+      float Aperture = 0.0f; // Lens diameter, 0 is a pinhole camera
+      float FocusDistance = 5.0f;
+      float ShutterTime = 0.0f; // Seconds the shutter stays open, moving spheres are blurred over this interval
+
+      bool IsThinLens() const { return Aperture > 0.0f; }
+   };
+
    Camera(float verticalFOV, float nearClip, float farClip);
 
+   // Mouse and keyboard control of the viewport, in CameraInput.cpp
    bool Update(float ts);
    void Resize(uint32_t width, uint32_t height);
+   // Places the camera directly, for scripted/benchmark camera paths
+   void SetView(const glm::vec3& position, const glm::vec3& forwardDirection);
 
    const glm::mat4 GetProjection() const { return m_Projection; }
    const glm::mat4 GetInverseProjection() const { return m_InverseProjection; }
@@ -18,14 +50,40 @@ public:
 
    const glm::vec3 GetPosition() const { return m_Position; }
    const glm::vec3 GetDirection() const { return m_ForwardDirection; }
+   float GetVerticalFOV() const { return m_VerticalFOV; }
+   float GetNearClip() const { return m_NearClip; }
+   float GetFarClip() const { return m_FarClip; }
 
    // Cache directions when camera is moving. When standing still the cache is used
+   // Empty when the camera generates its rays on the fly
    const std::vector<glm::vec3>& GetRayDirections() const { return m_RayDirections; }
 
+   const RayBasis& GetRayBasis() const { return m_RayBasis; }
+   // (x, y) in viewport pixels, moved by the crop offset like every other ray
+   glm::vec3 GetRayDirection(float x, float y) const;
+   // Writes the normalized ray directions of one image row (ViewportWidth entries), 4 pixels at a time
+   // pixelOffsets optionally moves each ray inside its pixel (sub-pixel jitter), measured from the pixel corner
+   void GenerateRayDirections(uint32_t y, glm::vec3* outDirections, const glm::vec2* pixelOffsets = nullptr) const;
+
+   // Makes the viewport a window into a larger image: viewport pixel (x, y) becomes pixel (x + offsetX, y + offsetY) of an
+   // imageWidth x imageHeight image, seen through that image's projection. Renders the image tile by tile
+   void SetCropWindow(uint32_t offsetX, uint32_t offsetY, uint32_t imageWidth, uint32_t imageHeight);
+   void ClearCropWindow();
+   glm::uvec2 GetCropOffset() const { return m_CropOffset; }
+   // Size of the whole image, the viewport size without a crop window
+   glm::uvec2 GetImageSize() const;
+
+   void SetRayGenerationMode(RayGenerationMode mode);
+   RayGenerationMode GetRayGenerationMode() const { return m_RayGenerationMode; }
+
+   Lens& GetLens() { return m_Lens; }
+   const Lens& GetLens() const { return m_Lens; }
+
    float GetRotationSpeed();
 private:
    void RecalculateProjection();
    void RecalculateView();
+   void RecalculateRayBasis();
    void RecalculateRayDirections();
 
    glm::mat4 m_Projection { 1.0f };
@@ -37,14 +95,24 @@ private:
    float m_NearClip = 0.1f;
    float m_FarClip = 1000.0f;
 
+   Lens m_Lens = {};
+
    glm::vec3 m_Position = {};
    glm::vec3 m_ForwardDirection = {};
 
+   RayBasis m_RayBasis = {};
+   RayGenerationMode m_RayGenerationMode = RayGenerationMode::Cached;
+
    // Cached ray directions
    std::vector<glm::vec3> m_RayDirections = {};
+   std::vector<uint32_t> m_ImageVerticalIter = {};
 
    glm::vec2 m_LastMousePosition = { 0.0f, 0.0f };
 
    float m_ViewportWidth = 0, m_ViewportHeight = 0;
+
+   // Zero without a crop window
+   glm::uvec2 m_CropOffset = { 0, 0 };
+   glm::uvec2 m_CropImageSize = { 0, 0 };
 };
 
@@ -0,0 +1,91 @@
+#include "Camera.h"
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#include "Walnut/Input/Input.h"
+
+// Apart from the rest of the camera so the headless build doesn't need Walnut's window input
+
+bool Camera::Update(float ts)
+{
+   static const float sensitivity = 0.002f;
+   glm::vec2 mousePos = Walnut::Input::GetMousePosition();
+   glm::vec2 mouseDelta = (mousePos - m_LastMousePosition) * sensitivity;
+   m_LastMousePosition = mousePos;
+
+   if (not Walnut::Input::IsMouseButtonDown(Walnut::MouseButton::Right))
+   {
+      // If we're not moving the camera, we just stop here
+      Walnut::Input::SetCursorMode(Walnut::CursorMode::Normal);
+      return false;
+   }
+
+   Walnut::Input::SetCursorMode(Walnut::CursorMode::Locked);
+
+   constexpr glm::vec3 upDirection(0.0f, 1.0f, 0.0f);
+   glm::vec3 rightDirection = glm::cross(m_ForwardDirection, upDirection);
+
+   float speed = 5.0f;
+   bool moved = false;
+
+   // Movement
+   if (Walnut::Input::IsKeyDown(Walnut::KeyCode::W))
+   {
+      m_Position += m_ForwardDirection * speed * ts;
+      moved = true;
+   }
+   else if (Walnut::Input::IsKeyDown(Walnut::KeyCode::S))
+   {
+      m_Position -= m_ForwardDirection * speed * ts;
+      moved = true;
+   }
+
+   if (Walnut::Input::IsKeyDown(Walnut::KeyCode::A))
+   {
+      m_Position -= rightDirection * speed * ts;
+      moved = true;
+   }
+   else if (Walnut::Input::IsKeyDown(Walnut::KeyCode::D))
+   {
+      m_Position += rightDirection * speed * ts;
+      moved = true;
+   }
+
+   if (Walnut::Input::IsKeyDown(Walnut::KeyCode::Q))
+   {
+      m_Position -= upDirection * speed * ts;
+      moved = true;
+   }
+   else if (Walnut::Input::IsKeyDown(Walnut::KeyCode::E))
+   {
+      m_Position += upDirection * speed * ts;
+      moved = true;
+   }
+
+   // Rotation
+   if (mouseDelta.x != 0.0f || mouseDelta.y != 0.0f)
+   {
+      float pitchDelta = mouseDelta.y * GetRotationSpeed();
+      float yawDelta = mouseDelta.x * GetRotationSpeed();
+
+      // Build quaternion for the forward direction using the right/up directions with corresponding pitch/yaws
+      glm::quat q = glm::normalize(glm::cross(
+                        glm::angleAxis(-pitchDelta, rightDirection),
+                        glm::angleAxis(-yawDelta, upDirection)
+      ));
+
+      m_ForwardDirection = glm::rotate(q, m_ForwardDirection);
+
+      moved = true;
+   }
+
+   if (moved)
+   {
+      RecalculateView();
+      RecalculateRayBasis();
+      RecalculateRayDirections();
+   }
+
+   return moved;
+}
@@ -3,6 +3,11 @@
 
 #define BIT(x) (1 << x)
 
+// Every x64 target has SSE2, other targets use the scalar paths
+#if defined(_M_X64) || defined(__SSE2__)
+   #define RT_SIMD_SSE
+#endif
+
 template<typename T>
 using Scope = std::unique_ptr<T>;
 
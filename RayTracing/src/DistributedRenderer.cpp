@@ -0,0 +1,459 @@
+#include "DistributedRenderer.h"
+
+#include "Scene/SceneBinarySerializer.h"
+#include "Socket.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+   constexpr char s_Magic[4] = { 'R', 'T', 'D', 'R' };
+   constexpr uint32_t s_ProtocolVersion = 1;
+
+   // Each worker has the next job queued while it renders one, so it never waits for the coordinator
+   constexpr size_t s_JobsInFlight = 2;
+
+   // A worker's jobs are handed to the others once it returned nothing for this many times the median job time
+   constexpr float s_JobTimeoutFactor = 8.0f;
+   constexpr float s_MinimumJobTimeoutSeconds = 10.0f;
+   // Until the first job is done, which includes loading the scene
+   constexpr float s_FirstJobTimeoutSeconds = 120.0f;
+   // A message that stops halfway fails the connection after this long
+   constexpr uint32_t s_ReceiveTimeoutMilliseconds = 30000;
+
+   enum class MessageType : uint32_t
+   {
+      Setup = 0, // Coordinator to worker, once: RenderSetup followed by the scene file
+      Job,       // Coordinator to worker: JobDescription
+      Result,    // Worker to coordinator: JobDescription followed by the sums of the tile's pixels
+   };
+
+   struct MessageHeader
+   {
+      char Magic[4];
+      MessageType Type;
+      uint64_t Size; // Of the payload that follows
+   };
+
+   struct RenderSetup
+   {
+      uint32_t ProtocolVersion;
+      uint32_t Width, Height;
+
+      uint32_t Jitter;
+      ReconstructionFilter Filter;
+      float FilterRadius;
+      uint32_t WideBVH;
+
+      glm::vec3 Position;
+      glm::vec3 Direction;
+      float VerticalFOV, NearClip, FarClip;
+      Camera::Lens Lens;
+   };
+
+   // A tile (in the renderer's pixels, rows bottom to top) and the samples of it to take
+   struct JobDescription
+   {
+      uint32_t ID;
+      uint32_t X, Y, Width, Height;
+      uint32_t FirstSample, SampleCount;
+   };
+
+   bool WriteMessage(Socket& socket, MessageType type, const void* data, uint64_t size, const void* extraData = nullptr, uint64_t extraSize = 0)
+   {
+      MessageHeader header;
+      memcpy(header.Magic, s_Magic, sizeof(s_Magic));
+      header.Type = type;
+      header.Size = size + extraSize;
+      return socket.Send(&header, sizeof(header)) && socket.Send(data, size) && (extraSize == 0 || socket.Send(extraData, extraSize));
+   }
+
+   bool ReadMessageHeader(Socket& socket, MessageType type, MessageHeader& outHeader)
+   {
+      return socket.Receive(&outHeader, sizeof(outHeader)) && memcmp(outHeader.Magic, s_Magic, sizeof(s_Magic)) == 0 &&
+             outHeader.Type == type;
+   }
+
+   // Random, so workers and coordinators started side by side don't share the file
+   std::string GetTemporaryScenePath(const char* prefix)
+   {
+      std::random_device device;
+      const uint64_t number = ((uint64_t)device() << 32) | device();
+      const std::string name = prefix + std::to_string(number) + ".rtscene";
+      return (std::filesystem::temp_directory_path() / name).string();
+   }
+
+   // The scene travels as a .rtscene with its BVHs, so workers don't build them again
+   bool ReadSceneFile(Scene& scene, std::vector<uint8_t>& outBytes)
+   {
+      const std::string filepath = GetTemporaryScenePath("RayTracingCoordinator_");
+      bool serialized = SceneBinarySerializer(&scene).Serialize(filepath);
+      if (serialized)
+      {
+         std::ifstream file(filepath, std::ios::binary);
+         outBytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+         serialized = not outBytes.empty();
+      }
+
+      std::error_code error;
+      std::filesystem::remove(filepath, error);
+      return serialized;
+   }
+}
+
+bool RenderCoordinator::Render(Scene& scene, const Camera& camera, const Options& options, Renderer& renderer,
+                               const ProgressCallback& progress)
+{
+   if (options.Width == 0 || options.Height == 0 || options.TileSize == 0 || options.SamplesPerJob == 0)
+   {
+      return false;
+   }
+
+   Socket listener = Socket::Listen(options.Port);
+   if (not listener.IsValid())
+   {
+      printf("Can't listen on port %u\n", options.Port);
+      return false;
+   }
+
+   std::vector<uint8_t> sceneFile;
+   if (not ReadSceneFile(scene, sceneFile))
+   {
+      printf("Can't serialize the scene\n");
+      return false;
+   }
+
+   const Renderer::Settings& settings = renderer.GetSettings();
+   RenderSetup setup = {};
+   setup.ProtocolVersion = s_ProtocolVersion;
+   setup.Width = options.Width;
+   setup.Height = options.Height;
+   setup.Jitter = settings.Jitter;
+   setup.Filter = settings.Filter;
+   setup.FilterRadius = settings.FilterRadius;
+   setup.WideBVH = settings.WideBVH;
+   setup.Position = camera.GetPosition();
+   setup.Direction = camera.GetDirection();
+   setup.VerticalFOV = camera.GetVerticalFOV();
+   setup.NearClip = camera.GetNearClip();
+   setup.FarClip = camera.GetFarClip();
+   setup.Lens = camera.GetLens();
+
+   renderer.Resize(options.Width, options.Height);
+   renderer.StartAtFrame(1);
+
+   std::vector<JobDescription> jobs;
+   uint32_t jobsDone = 0;
+   for (uint32_t y = 0; y < options.Height; y += options.TileSize)
+   {
+      for (uint32_t x = 0; x < options.Width; x += options.TileSize)
+      {
+         for (uint32_t firstSample = 0; firstSample < options.Samples; firstSample += options.SamplesPerJob)
+         {
+            JobDescription job;
+            job.ID = (uint32_t)jobs.size();
+            job.X = x;
+            job.Y = y;
+            job.Width = glm::min(options.TileSize, options.Width - x);
+            job.Height = glm::min(options.TileSize, options.Height - y);
+            job.FirstSample = firstSample;
+            job.SampleCount = glm::min(options.SamplesPerJob, options.Samples - firstSample);
+            jobs.push_back(job);
+         }
+      }
+   }
+
+   std::deque<uint32_t> pendingJobs;
+   for (const JobDescription& job : jobs)
+   {
+      pendingJobs.push_back(job.ID);
+   }
+   // A job handed out again can come back twice, only the first result counts
+   std::vector<bool> jobDone(jobs.size(), false);
+
+   using Clock = std::chrono::steady_clock;
+   struct Worker
+   {
+      Socket Connection;
+      std::vector<uint32_t> Jobs; // Sent and not returned yet, in the order the worker renders them
+      Clock::time_point LastProgress; // When it was sent the scene or returned its last result
+      bool Late = false; // Its jobs were handed out again, it gets no new ones until it catches up
+   };
+   std::vector<Worker> workers;
+
+   // Its unfinished jobs go to the front of the queue, the next worker with room takes them
+   auto requeueJobs = [&](Worker& worker)
+   {
+      uint32_t requeued = 0;
+      for (auto it = worker.Jobs.rbegin(); it != worker.Jobs.rend(); it++)
+      {
+         if (not jobDone[*it])
+         {
+            pendingJobs.push_front(*it);
+            requeued++;
+         }
+      }
+      return requeued;
+   };
+
+   auto dropWorker = [&](size_t index)
+   {
+      const uint32_t requeued = workers[index].Late ? 0 : requeueJobs(workers[index]);
+      printf("\nLost a worker, %u of its jobs are handed out again\n", requeued);
+      workers.erase(workers.begin() + index);
+   };
+
+   // Of the jobs finished so far, each from when the worker could start on it
+   std::vector<float> jobSeconds;
+   auto getJobTimeout = [&]()
+   {
+      if (jobSeconds.empty())
+      {
+         return s_FirstJobTimeoutSeconds;
+      }
+      std::vector<float> sorted = jobSeconds;
+      std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+      return glm::max(s_MinimumJobTimeoutSeconds, s_JobTimeoutFactor * sorted[sorted.size() / 2]);
+   };
+
+   auto receiveResult = [&](Worker& worker, std::vector<glm::vec4>& sums)
+   {
+      MessageHeader header;
+      JobDescription result;
+      if (not ReadMessageHeader(worker.Connection, MessageType::Result, header) || header.Size < sizeof(JobDescription) ||
+          not worker.Connection.Receive(&result, sizeof(result)))
+      {
+         return false;
+      }
+
+      auto it = std::find(worker.Jobs.begin(), worker.Jobs.end(), result.ID);
+      if (it == worker.Jobs.end())
+      {
+         return false;
+      }
+
+      const JobDescription& job = jobs[result.ID];
+      const uint64_t pixelCount = (uint64_t)job.Width * job.Height;
+      if (header.Size != sizeof(JobDescription) + pixelCount * sizeof(glm::vec4))
+      {
+         return false;
+      }
+
+      sums.resize(pixelCount);
+      if (not worker.Connection.Receive(sums.data(), pixelCount * sizeof(glm::vec4)))
+      {
+         return false;
+      }
+
+      const Clock::time_point now = Clock::now();
+      jobSeconds.push_back(std::chrono::duration<float>(now - worker.LastProgress).count());
+      worker.LastProgress = now;
+      worker.Jobs.erase(it);
+      worker.Late = worker.Late && not worker.Jobs.empty();
+
+      if (not jobDone[result.ID])
+      {
+         renderer.AddSamples(job.X, job.Y, job.Width, job.Height, sums.data());
+         jobDone[result.ID] = true;
+         jobsDone++;
+         if (progress)
+         {
+            progress(jobsDone, (uint32_t)jobs.size());
+         }
+      }
+      return true;
+   };
+
+   printf("Waiting for workers on port %u\n", listener.GetPort());
+
+   std::vector<glm::vec4> sums;
+   std::vector<const Socket*> sockets;
+   std::vector<bool> readable;
+   while (jobsDone < (uint32_t)jobs.size())
+   {
+      for (size_t i = 0; i < workers.size();)
+      {
+         bool sent = true;
+         while (sent && not workers[i].Late && workers[i].Jobs.size() < s_JobsInFlight && not pendingJobs.empty())
+         {
+            const uint32_t jobID = pendingJobs.front();
+            if (jobDone[jobID])
+            {
+               pendingJobs.pop_front();
+               continue;
+            }
+
+            sent = WriteMessage(workers[i].Connection, MessageType::Job, &jobs[jobID], sizeof(JobDescription));
+            if (sent)
+            {
+               workers[i].Jobs.push_back(jobID);
+               pendingJobs.pop_front();
+            }
+         }
+
+         if (sent)
+         {
+            i++;
+         }
+         else
+         {
+            dropWorker(i);
+         }
+      }
+
+      sockets = { &listener };
+      for (const Worker& worker : workers)
+      {
+         sockets.push_back(&worker.Connection);
+      }
+      if (Socket::Poll(sockets, 1000, readable))
+      {
+         // Backwards, dropping a worker only moves the ones already handled
+         for (size_t i = workers.size(); i-- > 0;)
+         {
+            if (readable[i + 1] && not receiveResult(workers[i], sums))
+            {
+               dropWorker(i);
+            }
+         }
+
+         if (readable[0])
+         {
+            Worker worker;
+            worker.Connection = listener.Accept();
+            if (worker.Connection.IsValid())
+            {
+               worker.Connection.SetTimeout(s_ReceiveTimeoutMilliseconds);
+            }
+            if (worker.Connection.IsValid() && WriteMessage(worker.Connection, MessageType::Setup, &setup, sizeof(setup), sceneFile.data(), sceneFile.size()))
+            {
+               worker.LastProgress = Clock::now();
+               workers.push_back(std::move(worker));
+               printf("\nWorker connected, %zu working\n", workers.size());
+            }
+         }
+      }
+
+      // A worker that hangs, or whose machine went away without closing the connection, has its jobs handed to the others.
+      // It stays connected, a result it still returns is taken if nobody else finished that job first
+      const float timeout = getJobTimeout();
+      const Clock::time_point now = Clock::now();
+      for (Worker& worker : workers)
+      {
+         if (not worker.Late && not worker.Jobs.empty() && std::chrono::duration<float>(now - worker.LastProgress).count() > timeout)
+         {
+            worker.Late = true;
+            printf("\nA worker took over %.0f s for a job, %u of its jobs are handed out again\n", timeout, requeueJobs(worker));
+         }
+      }
+   }
+
+   // Closing the connections tells the workers to stop
+   return true;
+}
+
+bool RenderWorker::Run(const std::string& host, uint16_t port)
+{
+   Socket connection;
+   for (int attempt = 0; attempt < 50 && not connection.IsValid(); attempt++)
+   {
+      connection = Socket::Connect(host, port);
+      if (not connection.IsValid())
+      {
+         std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      }
+   }
+   if (not connection.IsValid())
+   {
+      printf("Can't connect to %s:%u\n", host.c_str(), port);
+      return false;
+   }
+
+   MessageHeader header;
+   RenderSetup setup;
+   if (not ReadMessageHeader(connection, MessageType::Setup, header) || header.Size <= sizeof(RenderSetup) ||
+       not connection.Receive(&setup, sizeof(setup)) || setup.ProtocolVersion != s_ProtocolVersion)
+   {
+      printf("The coordinator at %s:%u speaks another protocol\n", host.c_str(), port);
+      return false;
+   }
+
+   std::vector<uint8_t> sceneFile(header.Size - sizeof(RenderSetup));
+   if (not connection.Receive(sceneFile.data(), sceneFile.size()))
+   {
+      return false;
+   }
+
+   // The scene keeps its file mapped, the file goes once the scene is gone
+   const std::string sceneFilepath = GetTemporaryScenePath("RayTracingWorker_");
+   {
+      std::ofstream file(sceneFilepath, std::ios::binary);
+      file.write((const char*)sceneFile.data(), sceneFile.size());
+   }
+   sceneFile.clear();
+   sceneFile.shrink_to_fit();
+
+   uint32_t jobsDone = 0;
+   bool loaded = false;
+   {
+      Scene scene;
+      scene.SetWideBVH(setup.WideBVH != 0);
+      loaded = SceneBinarySerializer(&scene).Deserialize(sceneFilepath);
+      if (loaded)
+      {
+         Camera camera(setup.VerticalFOV, setup.NearClip, setup.FarClip);
+         camera.SetRayGenerationMode(RayGenerationMode::OnTheFly);
+         camera.SetView(setup.Position, setup.Direction);
+         camera.GetLens() = setup.Lens;
+
+         Renderer renderer(true);
+         Renderer::Settings& settings = renderer.GetSettings();
+         settings.Jitter = setup.Jitter != 0;
+         settings.Filter = setup.Filter;
+         settings.FilterRadius = setup.FilterRadius;
+         settings.WideBVH = setup.WideBVH != 0;
+
+         // Until the coordinator closes the connection
+         JobDescription job;
+         while (ReadMessageHeader(connection, MessageType::Job, header) && header.Size == sizeof(JobDescription) &&
+                connection.Receive(&job, sizeof(job)))
+         {
+            camera.SetCropWindow(job.X, job.Y, setup.Width, setup.Height);
+            camera.Resize(job.Width, job.Height);
+            renderer.Resize(job.Width, job.Height);
+            renderer.StartAtFrame(job.FirstSample + 1);
+            for (uint32_t sample = 0; sample < job.SampleCount; sample++)
+            {
+               renderer.Render(scene, camera);
+            }
+
+            const uint64_t pixelCount = (uint64_t)job.Width * job.Height;
+            if (not WriteMessage(connection, MessageType::Result, &job, sizeof(job), renderer.GetAccumulationData(), pixelCount * sizeof(glm::vec4)))
+            {
+               break;
+            }
+            jobsDone++;
+         }
+      }
+   }
+
+   std::error_code error;
+   std::filesystem::remove(sceneFilepath, error);
+
+   if (not loaded)
+   {
+      printf("Can't load the scene sent by the coordinator\n");
+      return false;
+   }
+   printf("Rendered %u jobs\n", jobsDone);
+   return true;
+}
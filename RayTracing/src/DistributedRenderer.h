@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Camera.h"
+#include "Renderer.h"
+#include "Scene/Scene.h"
+
+#include <functional>
+#include <string>
+
+// Renders one image on worker processes, on this machine or others, over TCP. The coordinator sends every worker the scene
+// (as a .rtscene), the camera and the settings once, then hands out jobs of a tile and a range of its samples. Workers
+// return the accumulated sums of the tile, which are added to the coordinator's renderer.
+// A worker that drops out, or returns nothing for several times the median job time, gets its unfinished jobs handed to the
+// others. Workers can join at any time
+class RenderCoordinator
+{
+public:
+   struct Options
+   {
+      uint16_t Port = 7878;
+      uint32_t Width = 0, Height = 0;
+      uint32_t TileSize = 64;
+      uint32_t Samples = 64;
+      uint32_t SamplesPerJob = 16;
+   };
+
+   // Called after each merged job
+   using ProgressCallback = std::function<void(uint32_t jobsDone, uint32_t jobCount)>;
+
+   // Resizes renderer to the image and renders with its settings, the samples match those of the same render done by
+   // renderer itself. Waits for workers as long as jobs are left. False if the port can't be listened on
+   static bool Render(Scene& scene, const Camera& camera, const Options& options, Renderer& renderer,
+                      const ProgressCallback& progress = {});
+};
+
+class RenderWorker
+{
+public:
+   // Connects to the coordinator (retrying for a few seconds, so workers can be started first) and renders the jobs it is
+   // given until the coordinator closes the connection. False if it never connects or the scene can't be loaded
+   static bool Run(const std::string& host, uint16_t port);
+};
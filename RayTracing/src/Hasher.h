@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// 64 bit FNV-1a, fed 8 bytes at a time so hashing large buffers stays cheap
+class Hasher
+{
+public:
+   void Add(const void* data, uint64_t size)
+   {
+      const uint8_t* bytes = (const uint8_t*)data;
+      while (size >= sizeof(uint64_t))
+      {
+         uint64_t word;
+         memcpy(&word, bytes, sizeof(word));
+         m_Hash = (m_Hash ^ word) * 0x100000001b3ull;
+         bytes += sizeof(word);
+         size -= sizeof(word);
+      }
+
+      while (size > 0)
+      {
+         m_Hash = (m_Hash ^ *bytes++) * 0x100000001b3ull;
+         size--;
+      }
+   }
+
+   template<typename T>
+   void Add(const T& value) { Add(&value, sizeof(T)); }
+
+   uint64_t Get() const { return m_Hash; }
+private:
+   uint64_t m_Hash = 0xcbf29ce484222325ull;
+};
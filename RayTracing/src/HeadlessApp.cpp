@@ -0,0 +1,378 @@
+#include "HeadlessApp.h"
+
+#include "Camera.h"
+#include "DistributedRenderer.h"
+#include "ImageExporter.h"
+#include "Renderer.h"
+#include "TiledRenderer.h"
+#include "Scene/Scene.h"
+#include "Scene/SceneBinarySerializer.h"
+#include "Scene/SceneLibrary.h"
+#include "Scene/SceneSerializer.h"
+
+#include "Walnut/Timer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+using namespace Walnut;
+
+namespace
+{
+   // Writes the render and waits for it, the exit code of the headless run
+   int ExportHeadless(const Renderer& renderer, const std::string& outputFilepath, bool halfFloat)
+   {
+      ImageExporter exporter;
+      if (not exporter.Export(renderer, outputFilepath, halfFloat))
+      {
+         printf("Can't export to '%s', use .png, .pfm or .exr\n", outputFilepath.c_str());
+         return 1;
+      }
+      if (not exporter.Wait())
+      {
+         printf("%s\n", exporter.GetStatus().c_str());
+         return 1;
+      }
+      printf("%s\n", exporter.GetStatus().c_str());
+      return 0;
+   }
+
+   const char* s_ValueOptions[] = { "--output", "--samples", "--width", "--height", "--tile-size", "--samples-per-job", "--coordinator",
+                                    "--worker", "--checkpoint", "--checkpoint-interval", "--scene" };
+
+   void PrintUsage()
+   {
+      printf("Usage: RayTracing --headless [--output render.png] [--samples 64] [--width 1280] [--height 720] [--half]\n"
+             "                             [--tile-size N] [--checkpoint file] [--checkpoint-interval seconds]\n"
+             "                             [--coordinator port [--samples-per-job 16] | --worker host:port]\n"
+             "                             [--scene name | scene file]\n"
+             "Scenes:");
+      for (uint32_t i = 0; i < (uint32_t)CanonicalScene::Count; i++)
+      {
+         printf(" %s", SceneLibrary::GetName((CanonicalScene)i));
+      }
+      printf("\n");
+   }
+
+   // The whole text has to be the number, false for a missing value
+   bool ParseCount(const char* text, uint32_t& outValue)
+   {
+      if (text == nullptr)
+      {
+         return false;
+      }
+      const char* end = text + strlen(text);
+      uint32_t value = 0;
+      auto [last, error] = std::from_chars(text, end, value);
+      if (error != std::errc() || last != end || value == 0)
+      {
+         return false;
+      }
+      outValue = value;
+      return true;
+   }
+
+   // 0 listens on a free port
+   bool ParsePort(const char* text, uint16_t& outPort)
+   {
+      if (text == nullptr)
+      {
+         return false;
+      }
+      const char* end = text + strlen(text);
+      uint32_t value = 0;
+      auto [last, error] = std::from_chars(text, end, value);
+      if (error != std::errc() || last != end || value > UINT16_MAX)
+      {
+         return false;
+      }
+      outPort = (uint16_t)value;
+      return true;
+   }
+
+   bool ParseSeconds(const char* text, float& outSeconds)
+   {
+      if (text == nullptr)
+      {
+         return false;
+      }
+      char* end = nullptr;
+      const float value = strtof(text, &end);
+      if (end == text || *end != '\0' || not (value >= 0.0f) || std::isinf(value))
+      {
+         return false;
+      }
+      outSeconds = value;
+      return true;
+   }
+}
+
+int HeadlessApp::Run(int argc, char** argv)
+{
+   std::string outputFilepath = "render.png";
+   std::string sceneFilepath;
+   std::string sceneName;
+   std::string checkpointFilepath;
+   float checkpointInterval = 300.0f;
+   uint32_t samples = 64, width = 1280, height = 720;
+   uint32_t tileSize = 0; // The default of the mode
+   uint32_t samplesPerJob = 16;
+   int coordinatorPort = -1;
+   std::string workerAddress;
+   bool halfFloat = false;
+   for (int i = 1; i < argc; i++)
+   {
+      const char* option = argv[i];
+      if (strcmp(option, "--headless") == 0)
+      {
+         continue;
+      }
+      if (strcmp(option, "--half") == 0)
+      {
+         halfFloat = true;
+         continue;
+      }
+      if (strncmp(option, "--", 2) != 0)
+      {
+         if (not sceneFilepath.empty())
+         {
+            printf("More than one scene file: '%s' and '%s'\n", sceneFilepath.c_str(), option);
+            PrintUsage();
+            return 1;
+         }
+         sceneFilepath = option;
+         continue;
+      }
+
+      // Every other option takes a value
+      if (std::find_if(std::begin(s_ValueOptions), std::end(s_ValueOptions), [option](const char* name) { return strcmp(option, name) == 0; }) ==
+          std::end(s_ValueOptions))
+      {
+         printf("Unknown option '%s'\n", option);
+         PrintUsage();
+         return 1;
+      }
+      if (i + 1 == argc)
+      {
+         printf("Missing value for %s\n", option);
+         PrintUsage();
+         return 1;
+      }
+
+      const char* value = argv[++i];
+      bool valid = true;
+      if (strcmp(option, "--output") == 0)
+      {
+         outputFilepath = value;
+      }
+      else if (strcmp(option, "--samples") == 0)
+      {
+         valid = ParseCount(value, samples);
+      }
+      else if (strcmp(option, "--width") == 0)
+      {
+         valid = ParseCount(value, width);
+      }
+      else if (strcmp(option, "--height") == 0)
+      {
+         valid = ParseCount(value, height);
+      }
+      else if (strcmp(option, "--tile-size") == 0)
+      {
+         valid = ParseCount(value, tileSize);
+      }
+      else if (strcmp(option, "--samples-per-job") == 0)
+      {
+         valid = ParseCount(value, samplesPerJob);
+      }
+      else if (strcmp(option, "--coordinator") == 0)
+      {
+         uint16_t port = 0;
+         valid = ParsePort(value, port);
+         coordinatorPort = port;
+      }
+      else if (strcmp(option, "--worker") == 0)
+      {
+         workerAddress = value;
+      }
+      else if (strcmp(option, "--checkpoint") == 0)
+      {
+         checkpointFilepath = value;
+      }
+      else if (strcmp(option, "--checkpoint-interval") == 0)
+      {
+         valid = ParseSeconds(value, checkpointInterval);
+      }
+      else if (strcmp(option, "--scene") == 0)
+      {
+         sceneName = value;
+      }
+
+      if (not valid)
+      {
+         printf("Invalid value '%s' for %s\n", value, option);
+         PrintUsage();
+         return 1;
+      }
+   }
+
+   // Options the chosen mode would silently ignore
+   const std::filesystem::path extension = std::filesystem::path(outputFilepath).extension();
+   const bool tiled = (extension == ".tif" || extension == ".tiff");
+   const char* conflict = nullptr;
+   if (not sceneName.empty() && not sceneFilepath.empty())
+   {
+      conflict = "--scene and a scene file can't be combined, pick one";
+   }
+   else if (not checkpointFilepath.empty() && tiled)
+   {
+      conflict = "--checkpoint doesn't work with .tif output, tiled renders write finished tiles straight to the file";
+   }
+   else if (not checkpointFilepath.empty() && coordinatorPort >= 0)
+   {
+      conflict = "--checkpoint doesn't work with --coordinator, distributed renders aren't checkpointed";
+   }
+   else if (halfFloat && extension != ".exr")
+   {
+      conflict = "--half only applies to .exr output";
+   }
+   if (conflict != nullptr)
+   {
+      printf("%s\n", conflict);
+      PrintUsage();
+      return 1;
+   }
+
+   if (not workerAddress.empty())
+   {
+      const size_t colon = workerAddress.rfind(':');
+      uint16_t port = 0;
+      if (colon == std::string::npos || not ParsePort(workerAddress.c_str() + colon + 1, port) || port == 0)
+      {
+         printf("Expected --worker <host>:<port>\n");
+         return 1;
+      }
+      return RenderWorker::Run(workerAddress.substr(0, colon), port) ? 0 : 1;
+   }
+
+   Scene scene;
+   Camera camera(45.0f, 0.1f, 100.0f);
+   // Jitter is on, every sample generates its own rays and cached directions would never be read
+   camera.SetRayGenerationMode(RayGenerationMode::OnTheFly);
+   if (not sceneName.empty())
+   {
+      CanonicalScene canonicalScene;
+      if (not SceneLibrary::FromName(sceneName, canonicalScene))
+      {
+         printf("Unknown scene '%s'\n", sceneName.c_str());
+         return 1;
+      }
+      SceneLibrary::Populate(scene, canonicalScene);
+
+      SceneLibrary::CameraPose pose = SceneLibrary::GetCameraPose(canonicalScene);
+      camera.SetView(pose.Position, pose.Target - pose.Position);
+   }
+   else if (sceneFilepath.empty())
+   {
+      SceneLibrary::Populate(scene, CanonicalScene::Default);
+   }
+   else
+   {
+      const bool binary = std::filesystem::path(sceneFilepath).extension() == ".rtscene";
+      bool loaded = binary ? SceneBinarySerializer(&scene).Deserialize(sceneFilepath) : SceneSerializer(&scene).Deserialize(sceneFilepath);
+      if (not loaded)
+      {
+         printf("Failed to load '%s'\n", sceneFilepath.c_str());
+         return 1;
+      }
+   }
+
+   if (tiled)
+   {
+      TiledRenderer::Options options;
+      options.Width = width;
+      options.Height = height;
+      options.TileSize = (tileSize != 0) ? tileSize : options.TileSize;
+      options.Samples = samples;
+
+      Timer timer;
+      bool rendered = TiledRenderer::Render(scene, camera, options, outputFilepath, [](uint32_t tilesDone, uint32_t tileCount)
+         {
+            printf("\rTile %u/%u", tilesDone, tileCount);
+            fflush(stdout);
+         });
+      printf("\n");
+      if (not rendered)
+      {
+         printf("Could not write %s (the tile size has to be a multiple of 16)\n", outputFilepath.c_str());
+         return 1;
+      }
+      printf("Rendered %u samples at %ux%u in %.1f s\nSaved %s\n", samples, width, height, timer.Elapsed(), outputFilepath.c_str());
+      return 0;
+   }
+
+   Renderer renderer(true);
+   if (coordinatorPort >= 0)
+   {
+      RenderCoordinator::Options options;
+      options.Port = (uint16_t)coordinatorPort;
+      options.Width = width;
+      options.Height = height;
+      options.TileSize = (tileSize != 0) ? tileSize : options.TileSize;
+      options.Samples = samples;
+      options.SamplesPerJob = samplesPerJob;
+
+      Timer timer;
+      bool rendered = RenderCoordinator::Render(scene, camera, options, renderer, [](uint32_t jobsDone, uint32_t jobCount)
+         {
+            printf("\rJob %u/%u", jobsDone, jobCount);
+            fflush(stdout);
+         });
+      if (not rendered)
+      {
+         return 1;
+      }
+      printf("\nRendered %u samples at %ux%u in %.1f s\n", samples, width, height, timer.Elapsed());
+      return ExportHeadless(renderer, outputFilepath, halfFloat);
+   }
+
+   renderer.Resize(width, height);
+   camera.Resize(width, height);
+
+   // A checkpoint that doesn't match is left alone rather than overwritten
+   if (not checkpointFilepath.empty() && std::filesystem::exists(checkpointFilepath))
+   {
+      if (not renderer.LoadCheckpoint(checkpointFilepath, scene, camera))
+      {
+         printf("Can't resume from '%s'\n", checkpointFilepath.c_str());
+         return 1;
+      }
+      printf("Resuming at sample %u\n", renderer.GetFrameIndex() - 1);
+   }
+
+   Timer timer;
+   Timer checkpointTimer;
+   const uint32_t firstSample = renderer.GetFrameIndex() - 1;
+   while (renderer.GetFrameIndex() <= samples)
+   {
+      renderer.Render(scene, camera);
+
+      if (not checkpointFilepath.empty() && (checkpointTimer.Elapsed() >= checkpointInterval || renderer.GetFrameIndex() > samples))
+      {
+         if (not renderer.SaveCheckpoint(checkpointFilepath))
+         {
+            printf("Could not write checkpoint '%s'\n", checkpointFilepath.c_str());
+         }
+         checkpointTimer.Reset();
+      }
+   }
+   printf("Rendered %u samples at %ux%u in %.1f s\n", renderer.GetFrameIndex() - 1 - firstSample, width, height, timer.Elapsed());
+
+   return ExportHeadless(renderer, outputFilepath, halfFloat);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// The command line renderer, without a window or a GPU. Shared by the GUI application (--headless) and the console-only
+// RayTracingHeadless target, which also builds on Linux
+class HeadlessApp
+{
+public:
+   // RayTracing --headless [--output render.png] [--samples 64] [--width 1280] [--height 720] [--half] [--tile-size N]
+   //                       [--checkpoint render.rtcheckpoint] [--checkpoint-interval 300] [--scene <name> | scene file]
+   // Renders without a window and exports the result, the format follows the extension of the output. A .tif output is
+   // rendered tile by tile (256 pixels by default) and streamed to disk, for images that don't fit in memory.
+   // With --checkpoint the accumulation is saved every interval (seconds) and once done. A run started again with the same
+   // checkpoint resumes from it, and only renders the samples still missing.
+   // RayTracing --headless --coordinator <port> [--samples-per-job 16] ... renders tiles (64 pixels by default) on the
+   // workers that connect to the port,
+   // RayTracing --headless --worker <host>:<port> is one of them (it gets the scene and settings from the coordinator)
+   // Returns the exit code
+   static int Run(int argc, char** argv);
+};
@@ -0,0 +1,108 @@
+#include "ImageExporter.h"
+
+#include "Renderer.h"
+
+ImageExporter::ImageExporter()
+   : m_Thread(&ImageExporter::Run, this)
+{
+}
+
+ImageExporter::~ImageExporter()
+{
+   {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Stop = true;
+   }
+   m_JobQueued.notify_one();
+   m_Thread.join();
+}
+
+bool ImageExporter::Export(const Renderer& renderer, const std::string& filepath, bool halfFloat)
+{
+   Job job;
+   job.Filepath = filepath;
+   job.HalfFloat = halfFloat;
+   job.Width = renderer.GetWidth();
+   job.Height = renderer.GetHeight();
+   if (not ImageWriter::GetFormat(filepath, job.Format) || job.Width == 0 || job.Height == 0)
+   {
+      return false;
+   }
+
+   // Copied here, on the thread that renders, so the renderer can carry on with the next frame
+   const uint32_t pixelCount = job.Width * job.Height;
+   if (job.Format == ImageFileFormat::PNG)
+   {
+      job.Pixels.assign(renderer.GetImageData(), renderer.GetImageData() + pixelCount);
+   }
+   else
+   {
+      const AccumulationBuffer& accumulation = renderer.GetAccumulation();
+      job.Colors.resize(pixelCount);
+      for (uint32_t i = 0; i < pixelCount; i++)
+      {
+         job.Colors[i] = accumulation.GetColor(i);
+      }
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_Jobs.push_back(std::move(job));
+   }
+   m_JobQueued.notify_one();
+   return true;
+}
+
+bool ImageExporter::Wait()
+{
+   std::unique_lock<std::mutex> lock(m_Mutex);
+   m_JobsDone.wait(lock, [this] { return m_Jobs.empty() && not m_Writing; });
+
+   bool succeeded = not m_Failed;
+   m_Failed = false;
+   return succeeded;
+}
+
+bool ImageExporter::IsBusy() const
+{
+   std::lock_guard<std::mutex> lock(m_Mutex);
+   return not m_Jobs.empty() || m_Writing;
+}
+
+std::string ImageExporter::GetStatus() const
+{
+   std::lock_guard<std::mutex> lock(m_Mutex);
+   return m_Status;
+}
+
+void ImageExporter::Run()
+{
+   std::unique_lock<std::mutex> lock(m_Mutex);
+   while (true)
+   {
+      m_JobQueued.wait(lock, [this] { return m_Stop || not m_Jobs.empty(); });
+      if (m_Jobs.empty())
+      {
+         return;
+      }
+
+      Job job = std::move(m_Jobs.front());
+      m_Jobs.pop_front();
+      m_Writing = true;
+      lock.unlock();
+
+      bool succeeded = false;
+      switch (job.Format)
+      {
+      case ImageFileFormat::PNG: succeeded = ImageWriter::WritePNG(job.Filepath, job.Pixels.data(), job.Width, job.Height); break;
+      case ImageFileFormat::PFM: succeeded = ImageWriter::WritePFM(job.Filepath, job.Colors.data(), job.Width, job.Height); break;
+      case ImageFileFormat::EXR: succeeded = ImageWriter::WriteEXR(job.Filepath, job.Colors.data(), job.Width, job.Height, job.HalfFloat); break;
+      }
+
+      lock.lock();
+      m_Writing = false;
+      m_Failed |= not succeeded;
+      m_Status = (succeeded ? "Saved " : "Could not write ") + job.Filepath;
+      m_JobsDone.notify_all();
+   }
+}
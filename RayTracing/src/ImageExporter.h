@@ -0,0 +1,59 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include "ImageWriter.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Renderer;
+
+// Writes renders to disk on a thread of its own. Export copies what the file needs out of the renderer and returns,
+// the next frame can be rendered while the file is encoded and written
+class ImageExporter
+{
+public:
+   ImageExporter();
+   ImageExporter(const ImageExporter&) = delete;
+   ImageExporter& operator=(const ImageExporter&) = delete;
+   // Finishes the queued exports first
+   ~ImageExporter();
+
+   // The format follows the extension: .png is the displayed RGBA8 image, .pfm and .exr the linear accumulated color
+   // (halfFloat only applies to .exr). False for other extensions or before the first frame
+   bool Export(const Renderer& renderer, const std::string& filepath, bool halfFloat = false);
+   // Blocks until every queued export is written. Returns false if any of them failed since the last call
+   bool Wait();
+
+   bool IsBusy() const;
+   // Outcome of the last finished export, empty before the first one
+   std::string GetStatus() const;
+private:
+   struct Job
+   {
+      std::string Filepath;
+      ImageFileFormat Format;
+      bool HalfFloat;
+      uint32_t Width, Height;
+      std::vector<uint32_t> Pixels;  // PNG
+      std::vector<glm::vec3> Colors; // PFM and EXR
+   };
+
+   void Run();
+
+   mutable std::mutex m_Mutex;
+   std::condition_variable m_JobQueued;
+   std::condition_variable m_JobsDone;
+   std::deque<Job> m_Jobs;
+   bool m_Writing = false;
+   bool m_Stop = false;
+   bool m_Failed = false;
+   std::string m_Status;
+
+   std::thread m_Thread; // Last, starts once the rest is initialized
+};
@@ -0,0 +1,388 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+   uint32_t UpdateCRC32(uint32_t crc, const uint8_t* data, size_t size)
+   {
+      static const std::vector<uint32_t> s_Table = []
+      {
+         std::vector<uint32_t> table(256);
+         for (uint32_t i = 0; i < 256; i++)
+         {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++)
+            {
+               value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+            }
+            table[i] = value;
+         }
+         return table;
+      }();
+
+      crc = ~crc;
+      for (size_t i = 0; i < size; i++)
+      {
+         crc = s_Table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+      }
+      return ~crc;
+   }
+
+   void WriteBigEndian(std::ofstream& file, uint32_t value)
+   {
+      uint8_t bytes[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+      file.write((const char*)bytes, sizeof(bytes));
+   }
+
+   void WritePNGChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data)
+   {
+      WriteBigEndian(file, (uint32_t)data.size());
+      file.write(type, 4);
+      file.write((const char*)data.data(), data.size());
+
+      uint32_t crc = UpdateCRC32(0, (const uint8_t*)type, 4);
+      crc = UpdateCRC32(crc, data.data(), data.size());
+      WriteBigEndian(file, crc);
+   }
+
+   // Round to nearest, values beyond the half range are clamped to its maximum
+   uint16_t FloatToHalf(float value)
+   {
+      const uint16_t sign = std::signbit(value) ? 0x8000 : 0;
+      value = glm::min(glm::abs(value), 65504.0f);
+
+      // Halves below 2^-14 are denormals with the exponent of 2^-14
+      int exponent = (value < 6.103515625e-05f) ? -14 : (int)((std::bit_cast<uint32_t>(value) >> 23) & 0xff) - 127;
+      uint32_t mantissa = (uint32_t)(std::ldexp(value, 10 - exponent) + 0.5f);
+
+      // A mantissa rounded up to 2048 carries into the exponent on its own
+      uint32_t bits = ((uint32_t)(exponent + 15) << 10) + mantissa - 1024;
+      return sign | (uint16_t)glm::min(bits, 0x7bffu);
+   }
+
+   template<typename T>
+   void WriteLittleEndian(std::ofstream& file, T value)
+   {
+      static_assert(std::endian::native == std::endian::little);
+      file.write((const char*)&value, sizeof(T));
+   }
+
+   void WriteEXRAttribute(std::ofstream& file, const char* name, const char* type, const void* data, uint32_t size)
+   {
+      file.write(name, strlen(name) + 1);
+      file.write(type, strlen(type) + 1);
+      WriteLittleEndian(file, size);
+      file.write((const char*)data, size);
+   }
+}
+
+bool ImageWriter::GetFormat(const std::string& filepath, ImageFileFormat& outFormat)
+{
+   const std::filesystem::path extension = std::filesystem::path(filepath).extension();
+   if (extension == ".png")
+   {
+      outFormat = ImageFileFormat::PNG;
+   }
+   else if (extension == ".pfm")
+   {
+      outFormat = ImageFileFormat::PFM;
+   }
+   else if (extension == ".exr")
+   {
+      outFormat = ImageFileFormat::EXR;
+   }
+   else
+   {
+      return false;
+   }
+   return true;
+}
+
+bool ImageWriter::WritePNG(const std::string& filepath, const uint32_t* pixels, uint32_t width, uint32_t height)
+{
+   std::ofstream file(filepath, std::ios::binary);
+   if (not file)
+   {
+      return false;
+   }
+
+   static const uint8_t s_Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+   file.write((const char*)s_Signature, sizeof(s_Signature));
+
+   // 8 bits per channel, RGBA, no interlacing
+   std::vector<uint8_t> header = { (uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+                                   (uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8), (uint8_t)height,
+                                   8, 6, 0, 0, 0 };
+   WritePNGChunk(file, "IHDR", header);
+
+   // Every row starts with its filter type, none
+   const size_t rowSize = (size_t)width * 4 + 1;
+   std::vector<uint8_t> rows(rowSize * height);
+   for (uint32_t y = 0; y < height; y++)
+   {
+      uint8_t* row = &rows[y * rowSize];
+      row[0] = 0;
+      memcpy(row + 1, pixels + (size_t)(height - 1 - y) * width, (size_t)width * 4);
+   }
+
+   // A zlib stream of stored deflate blocks, at most 65535 bytes each
+   std::vector<uint8_t> stream = { 0x78, 0x01 };
+   stream.reserve(rows.size() + (rows.size() / 65535 + 1) * 5 + 6);
+   size_t offset = 0;
+   do
+   {
+      const uint16_t blockSize = (uint16_t)std::min<size_t>(rows.size() - offset, 65535);
+      const bool last = (offset + blockSize == rows.size());
+      stream.push_back(last ? 1 : 0);
+      stream.push_back((uint8_t)blockSize);
+      stream.push_back((uint8_t)(blockSize >> 8));
+      stream.push_back((uint8_t)~blockSize);
+      stream.push_back((uint8_t)(~blockSize >> 8));
+      stream.insert(stream.end(), rows.begin() + offset, rows.begin() + offset + blockSize);
+      offset += blockSize;
+   } while (offset < rows.size());
+
+   uint32_t adlerA = 1, adlerB = 0;
+   for (uint8_t byte : rows)
+   {
+      adlerA = (adlerA + byte) % 65521;
+      adlerB = (adlerB + adlerA) % 65521;
+   }
+   const uint32_t adler = (adlerB << 16) | adlerA;
+   stream.insert(stream.end(), { (uint8_t)(adler >> 24), (uint8_t)(adler >> 16), (uint8_t)(adler >> 8), (uint8_t)adler });
+
+   WritePNGChunk(file, "IDAT", stream);
+   WritePNGChunk(file, "IEND", {});
+   return (bool)file;
+}
+
+bool ImageWriter::WritePFM(const std::string& filepath, const glm::vec3* pixels, uint32_t width, uint32_t height)
+{
+   std::ofstream file(filepath, std::ios::binary);
+   if (not file)
+   {
+      return false;
+   }
+
+   // Negative scale marks little endian data. PFM stores the bottom row first, like the renderer
+   file << "PF\n" << width << " " << height << "\n-1.0\n";
+   file.write((const char*)pixels, (size_t)width * height * sizeof(glm::vec3));
+   return (bool)file;
+}
+
+bool ImageWriter::WriteEXR(const std::string& filepath, const glm::vec3* pixels, uint32_t width, uint32_t height, bool halfFloat)
+{
+   std::ofstream file(filepath, std::ios::binary);
+   if (not file)
+   {
+      return false;
+   }
+
+   // Magic number and version 2, a single part of scanlines
+   WriteLittleEndian(file, 20000630);
+   WriteLittleEndian(file, 2);
+
+   // The channels have to be sorted by name
+   const int32_t pixelType = halfFloat ? 1 : 2;
+   std::vector<uint8_t> channels;
+   for (const char* name : { "B", "G", "R" })
+   {
+      channels.push_back((uint8_t)name[0]);
+      channels.push_back(0);
+      const int32_t values[4] = { pixelType, 0, 1, 1 }; // Type, linear flag and reserved bytes, x and y sampling
+      channels.insert(channels.end(), (const uint8_t*)values, (const uint8_t*)values + sizeof(values));
+   }
+   channels.push_back(0);
+   WriteEXRAttribute(file, "channels", "chlist", channels.data(), (uint32_t)channels.size());
+
+   const uint8_t noCompression = 0;
+   WriteEXRAttribute(file, "compression", "compression", &noCompression, 1);
+   const int32_t window[4] = { 0, 0, (int32_t)width - 1, (int32_t)height - 1 };
+   WriteEXRAttribute(file, "dataWindow", "box2i", window, sizeof(window));
+   WriteEXRAttribute(file, "displayWindow", "box2i", window, sizeof(window));
+   const uint8_t increasingY = 0;
+   WriteEXRAttribute(file, "lineOrder", "lineOrder", &increasingY, 1);
+   const float aspectRatio = 1.0f;
+   WriteEXRAttribute(file, "pixelAspectRatio", "float", &aspectRatio, sizeof(aspectRatio));
+   const float windowCenter[2] = { 0.0f, 0.0f };
+   WriteEXRAttribute(file, "screenWindowCenter", "v2f", windowCenter, sizeof(windowCenter));
+   const float windowWidth = 1.0f;
+   WriteEXRAttribute(file, "screenWindowWidth", "float", &windowWidth, sizeof(windowWidth));
+   file.put(0);
+
+   // Uncompressed chunks hold a single scanline: its y, the size of the data and the values of one channel after another
+   const uint32_t sampleSize = halfFloat ? sizeof(uint16_t) : sizeof(float);
+   const uint32_t lineDataSize = width * 3 * sampleSize;
+   uint64_t chunkOffset = (uint64_t)file.tellp() + (uint64_t)height * sizeof(uint64_t);
+   for (uint32_t y = 0; y < height; y++)
+   {
+      WriteLittleEndian(file, chunkOffset);
+      chunkOffset += 2 * sizeof(int32_t) + lineDataSize;
+   }
+
+   std::vector<uint8_t> line(lineDataSize);
+   for (uint32_t y = 0; y < height; y++)
+   {
+      const glm::vec3* row = pixels + (size_t)(height - 1 - y) * width;
+      for (int channel = 0; channel < 3; channel++)
+      {
+         const int component = 2 - channel; // B, G, R
+         uint8_t* values = &line[channel * width * sampleSize];
+         for (uint32_t x = 0; x < width; x++)
+         {
+            if (halfFloat)
+            {
+               ((uint16_t*)values)[x] = FloatToHalf(row[x][component]);
+            }
+            else
+            {
+               ((float*)values)[x] = row[x][component];
+            }
+         }
+      }
+
+      WriteLittleEndian(file, (int32_t)y);
+      WriteLittleEndian(file, (int32_t)lineDataSize);
+      file.write((const char*)line.data(), line.size());
+   }
+   return (bool)file;
+}
+
+TiledImageWriter::~TiledImageWriter()
+{
+   if (m_File.is_open())
+   {
+      Close();
+   }
+}
+
+bool TiledImageWriter::Open(const std::string& filepath, uint32_t width, uint32_t height, uint32_t tileSize)
+{
+   if (width == 0 || height == 0 || tileSize == 0 || tileSize % 16 != 0)
+   {
+      return false;
+   }
+
+   m_File.open(filepath, std::ios::binary);
+   if (not m_File)
+   {
+      return false;
+   }
+
+   m_Width = width;
+   m_Height = height;
+   m_TileSize = tileSize;
+   m_TileOffsets.assign((size_t)GetTilesAcross() * GetTilesDown(), 0);
+   m_TileData.resize((size_t)tileSize * tileSize * 3);
+
+   // Little endian BigTIFF header, the offset of the directory is filled in by Close
+   m_File.write("II", 2);
+   WriteLittleEndian(m_File, (uint16_t)43);
+   WriteLittleEndian(m_File, (uint16_t)8);
+   WriteLittleEndian(m_File, (uint16_t)0);
+   WriteLittleEndian(m_File, (uint64_t)0);
+   return (bool)m_File;
+}
+
+bool TiledImageWriter::WriteTile(uint32_t tileX, uint32_t tileY, const uint32_t* pixels, uint32_t width, uint32_t height)
+{
+   if (not m_File.is_open() || tileX >= GetTilesAcross() || tileY >= GetTilesDown() || width > m_TileSize || height > m_TileSize)
+   {
+      return false;
+   }
+
+   // Tiles always hold tileSize x tileSize pixels, the part beyond the edge of the image is black
+   std::fill(m_TileData.begin(), m_TileData.end(), (uint8_t)0);
+   for (uint32_t y = 0; y < height; y++)
+   {
+      const uint32_t* row = pixels + (size_t)(height - 1 - y) * width;
+      uint8_t* tileRow = &m_TileData[(size_t)y * m_TileSize * 3];
+      for (uint32_t x = 0; x < width; x++)
+      {
+         tileRow[x * 3 + 0] = (uint8_t)row[x];
+         tileRow[x * 3 + 1] = (uint8_t)(row[x] >> 8);
+         tileRow[x * 3 + 2] = (uint8_t)(row[x] >> 16);
+      }
+   }
+
+   m_TileOffsets[(size_t)tileY * GetTilesAcross() + tileX] = (uint64_t)m_File.tellp();
+   m_File.write((const char*)m_TileData.data(), m_TileData.size());
+   return (bool)m_File;
+}
+
+bool TiledImageWriter::Close()
+{
+   if (not m_File.is_open())
+   {
+      return false;
+   }
+
+   bool complete = std::find(m_TileOffsets.begin(), m_TileOffsets.end(), 0) == m_TileOffsets.end();
+
+   // Entries are a tag, a type, a count and the value itself when it fits in 8 bytes, the offset of the values otherwise
+   struct Entry
+   {
+      uint16_t Tag, Type;
+      uint64_t Count, Value;
+   };
+   const uint16_t typeShort = 3, typeLong = 4, typeLong8 = 16;
+
+   const uint64_t tileCount = m_TileOffsets.size();
+   const uint64_t tileByteCount = m_TileData.size();
+
+   // The arrays of the tile offsets and byte counts go before the directory, unless a single tile fits inline
+   uint64_t tileOffsetsValue = m_TileOffsets[0], tileByteCountsValue = tileByteCount;
+   if (tileCount > 1)
+   {
+      tileOffsetsValue = (uint64_t)m_File.tellp();
+      m_File.write((const char*)m_TileOffsets.data(), tileCount * sizeof(uint64_t));
+      tileByteCountsValue = (uint64_t)m_File.tellp();
+      for (uint64_t i = 0; i < tileCount; i++)
+      {
+         WriteLittleEndian(m_File, tileByteCount);
+      }
+   }
+
+   // Sorted by tag
+   const Entry entries[] = {
+      { 256, typeLong, 1, m_Width },                            // ImageWidth
+      { 257, typeLong, 1, m_Height },                           // ImageLength
+      { 258, typeShort, 3, 8 | (8ull << 16) | (8ull << 32) },   // BitsPerSample, three shorts inline
+      { 259, typeShort, 1, 1 },                                 // Compression: none
+      { 262, typeShort, 1, 2 },                                 // PhotometricInterpretation: RGB
+      { 277, typeShort, 1, 3 },                                 // SamplesPerPixel
+      { 284, typeShort, 1, 1 },                                 // PlanarConfiguration: interleaved
+      { 322, typeLong, 1, m_TileSize },                         // TileWidth
+      { 323, typeLong, 1, m_TileSize },                         // TileLength
+      { 324, typeLong8, tileCount, tileOffsetsValue },          // TileOffsets
+      { 325, typeLong8, tileCount, tileByteCountsValue },       // TileByteCounts
+   };
+
+   const uint64_t directoryOffset = (uint64_t)m_File.tellp();
+   WriteLittleEndian(m_File, (uint64_t)std::size(entries));
+   for (const Entry& entry : entries)
+   {
+      WriteLittleEndian(m_File, entry.Tag);
+      WriteLittleEndian(m_File, entry.Type);
+      WriteLittleEndian(m_File, entry.Count);
+      WriteLittleEndian(m_File, entry.Value);
+   }
+   WriteLittleEndian(m_File, (uint64_t)0); // No further directories
+
+   m_File.seekp(8);
+   WriteLittleEndian(m_File, directoryOffset);
+
+   bool succeeded = complete && (bool)m_File;
+   m_File.close();
+   m_TileOffsets.clear();
+   m_TileData.clear();
+   m_TileData.shrink_to_fit();
+   return succeeded;
+}
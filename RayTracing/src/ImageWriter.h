@@ -0,0 +1,58 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum class ImageFileFormat
+{
+   PNG = 0, // RGBA8
+   PFM,     // Float RGB
+   EXR,     // Half or float RGB, uncompressed scanlines
+};
+
+// Encoders for the image files the renderer exports. The pixels are given in the renderer's layout, rows bottom to top,
+// and get flipped for the formats that store the top row first. All return false when the file can't be written
+class ImageWriter
+{
+public:
+   // From the extension (.png, .pfm, .exr), false for anything else
+   static bool GetFormat(const std::string& filepath, ImageFileFormat& outFormat);
+
+   // RGBA8 packed as the renderer's image (r in the low byte). The image data is stored in uncompressed deflate blocks,
+   // so the file is about the size of the pixels
+   static bool WritePNG(const std::string& filepath, const uint32_t* pixels, uint32_t width, uint32_t height);
+   static bool WritePFM(const std::string& filepath, const glm::vec3* pixels, uint32_t width, uint32_t height);
+   static bool WriteEXR(const std::string& filepath, const glm::vec3* pixels, uint32_t width, uint32_t height, bool halfFloat);
+};
+
+// Streams an RGB8 image into a tiled BigTIFF, one tile at a time, for images too large to keep in memory. Only the offsets
+// of the tiles written so far are held until Close writes the directory
+class TiledImageWriter
+{
+public:
+   TiledImageWriter() = default;
+   TiledImageWriter(const TiledImageWriter&) = delete;
+   TiledImageWriter& operator=(const TiledImageWriter&) = delete;
+   ~TiledImageWriter();
+
+   // TIFF tiles are squares of a multiple of 16 pixels
+   bool Open(const std::string& filepath, uint32_t width, uint32_t height, uint32_t tileSize);
+   // Tiles are counted from the top left, those at the right and bottom edges are smaller than tileSize.
+   // The pixels are RGBA8 in the renderer's layout (rows bottom to top), the alpha is dropped
+   bool WriteTile(uint32_t tileX, uint32_t tileY, const uint32_t* pixels, uint32_t width, uint32_t height);
+   // Writes the directory. False if a tile was never written or any write failed
+   bool Close();
+
+   uint32_t GetTilesAcross() const { return (m_Width + m_TileSize - 1) / m_TileSize; }
+   uint32_t GetTilesDown() const { return (m_Height + m_TileSize - 1) / m_TileSize; }
+private:
+   std::ofstream m_File;
+   uint32_t m_Width = 0, m_Height = 0;
+   uint32_t m_TileSize = 0;
+   std::vector<uint64_t> m_TileOffsets; // 0 until the tile is written
+   std::vector<uint8_t> m_TileData;
+};
@@ -0,0 +1,541 @@
+#include "Json.h"
+
+#include <charconv>
+#include <cstdio>
+
+JsonWriter::JsonWriter(std::ostream& stream)
+   : m_Stream(stream)
+{
+}
+
+void JsonWriter::BeginObject()
+{
+   BeforeValue();
+   m_Stream << '{';
+   m_Scopes.push_back({});
+}
+
+void JsonWriter::EndObject()
+{
+   bool isEmpty = m_Scopes.back().IsEmpty;
+   m_Scopes.pop_back();
+   if (not isEmpty)
+   {
+      NewLine();
+   }
+   m_Stream << '}';
+}
+
+void JsonWriter::BeginArray()
+{
+   BeforeValue();
+   m_Stream << '[';
+   m_Scopes.push_back({});
+}
+
+void JsonWriter::BeginCompactArray()
+{
+   BeginArray();
+   m_Scopes.back().IsCompact = true;
+}
+
+void JsonWriter::EndArray()
+{
+   Scope scope = m_Scopes.back();
+   m_Scopes.pop_back();
+   if (not scope.IsEmpty && not scope.IsCompact)
+   {
+      NewLine();
+   }
+   m_Stream << ']';
+}
+
+void JsonWriter::Key(const char* key)
+{
+   BeforeValue();
+   WriteString(key);
+   m_Stream << ": ";
+   m_AfterKey = true;
+}
+
+void JsonWriter::Value(double value)
+{
+   BeforeValue();
+
+   // 17 significant digits round trip any double exactly
+   char buffer[32];
+   snprintf(buffer, sizeof(buffer), "%.17g", value);
+   m_Stream << buffer;
+}
+
+void JsonWriter::Value(float value)
+{
+   BeforeValue();
+
+   char buffer[32];
+   snprintf(buffer, sizeof(buffer), "%.9g", value);
+   m_Stream << buffer;
+}
+
+void JsonWriter::Value(uint32_t value)
+{
+   BeforeValue();
+   m_Stream << value;
+}
+
+void JsonWriter::Value(bool value)
+{
+   BeforeValue();
+   m_Stream << (value ? "true" : "false");
+}
+
+void JsonWriter::Value(const std::string& value)
+{
+   BeforeValue();
+   WriteString(value);
+}
+
+void JsonWriter::WriteString(const std::string& value)
+{
+   m_Stream << '"';
+   for (char c : value)
+   {
+      switch (c)
+      {
+      case '"':  m_Stream << "\\\""; break;
+      case '\\': m_Stream << "\\\\"; break;
+      case '\n': m_Stream << "\\n"; break;
+      case '\r': m_Stream << "\\r"; break;
+      case '\t': m_Stream << "\\t"; break;
+      default:
+         if ((unsigned char)c < 0x20)
+         {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            m_Stream << escaped;
+         }
+         else
+         {
+            m_Stream << c;
+         }
+      }
+   }
+   m_Stream << '"';
+}
+
+void JsonWriter::BeforeValue()
+{
+   // A value right after its key goes on the same line
+   if (m_AfterKey)
+   {
+      m_AfterKey = false;
+      return;
+   }
+
+   if (m_Scopes.empty())
+   {
+      return;
+   }
+
+   Scope& scope = m_Scopes.back();
+   if (not scope.IsEmpty)
+   {
+      m_Stream << ',';
+   }
+
+   if (scope.IsCompact)
+   {
+      if (not scope.IsEmpty)
+      {
+         m_Stream << ' ';
+      }
+   }
+   else
+   {
+      NewLine();
+   }
+   scope.IsEmpty = false;
+}
+
+void JsonWriter::NewLine()
+{
+   m_Stream << '\n';
+   for (size_t i = 0; i < m_Scopes.size(); i++)
+   {
+      m_Stream << "  ";
+   }
+}
+
+JsonReader::JsonReader(std::istream& stream)
+   : m_Stream(stream), m_Buffer(1 << 16)
+{
+}
+
+bool JsonReader::BeginObject()
+{
+   if (not Expect('{'))
+   {
+      return false;
+   }
+
+   return PushScope();
+}
+
+bool JsonReader::NextKey(std::string& outKey)
+{
+   if (HasError() || m_IsFirst.empty())
+   {
+      return false;
+   }
+
+   SkipWhitespace();
+   if (Peek() == '}')
+   {
+      Get();
+      m_IsFirst.pop_back();
+      return false;
+   }
+
+   if (not m_IsFirst.back() && not Expect(','))
+   {
+      return false;
+   }
+   m_IsFirst.back() = false;
+
+   return ReadString(outKey) && Expect(':');
+}
+
+bool JsonReader::BeginArray()
+{
+   if (not Expect('['))
+   {
+      return false;
+   }
+
+   return PushScope();
+}
+
+bool JsonReader::NextElement()
+{
+   if (HasError() || m_IsFirst.empty())
+   {
+      return false;
+   }
+
+   SkipWhitespace();
+   if (Peek() == ']')
+   {
+      Get();
+      m_IsFirst.pop_back();
+      return false;
+   }
+
+   if (not m_IsFirst.back() && not Expect(','))
+   {
+      return false;
+   }
+   m_IsFirst.back() = false;
+   return true;
+}
+
+bool JsonReader::ReadNumber(double& outValue)
+{
+   if (HasError())
+   {
+      return false;
+   }
+
+   SkipWhitespace();
+
+   char text[64];
+   uint32_t length = 0;
+   while (length < sizeof(text))
+   {
+      char c = Peek();
+      if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')
+      {
+         text[length++] = Get();
+      }
+      else
+      {
+         break;
+      }
+   }
+
+   auto [end, error] = std::from_chars(text, text + length, outValue);
+   if (length == 0 || error != std::errc() || end != text + length)
+   {
+      SetError("expected a number");
+      return false;
+   }
+
+   return true;
+}
+
+bool JsonReader::ReadFloat(float& outValue)
+{
+   double value = 0.0;
+   if (not ReadNumber(value))
+   {
+      return false;
+   }
+
+   outValue = (float)value;
+   return true;
+}
+
+bool JsonReader::ReadUInt(uint32_t& outValue)
+{
+   double value = 0.0;
+   if (not ReadNumber(value))
+   {
+      return false;
+   }
+
+   if (value < 0.0 || value > (double)UINT32_MAX || value != (double)(uint32_t)value)
+   {
+      SetError("expected an unsigned integer");
+      return false;
+   }
+
+   outValue = (uint32_t)value;
+   return true;
+}
+
+bool JsonReader::ReadBool(bool& outValue)
+{
+   if (HasError())
+   {
+      return false;
+   }
+
+   SkipWhitespace();
+   const char* expected = (Peek() == 't') ? "true" : "false";
+   for (const char* c = expected; *c != '\0'; c++)
+   {
+      if (Get() != *c)
+      {
+         SetError("expected true or false");
+         return false;
+      }
+   }
+
+   outValue = (expected[0] == 't');
+   return true;
+}
+
+bool JsonReader::ReadString(std::string& outValue)
+{
+   if (not Expect('"'))
+   {
+      return false;
+   }
+
+   outValue.clear();
+   while (true)
+   {
+      char c = Get();
+      if (c == '"')
+      {
+         return true;
+      }
+
+      if (c == '\0' || c == '\n')
+      {
+         SetError("unterminated string");
+         return false;
+      }
+
+      if (c != '\\')
+      {
+         outValue += c;
+         continue;
+      }
+
+      switch (Get())
+      {
+      case '"':  outValue += '"'; break;
+      case '\\': outValue += '\\'; break;
+      case '/':  outValue += '/'; break;
+      case 'b':  outValue += '\b'; break;
+      case 'f':  outValue += '\f'; break;
+      case 'n':  outValue += '\n'; break;
+      case 'r':  outValue += '\r'; break;
+      case 't':  outValue += '\t'; break;
+      case 'u':
+      {
+         char hex[4];
+         for (char& digit : hex)
+         {
+            digit = Get();
+         }
+
+         uint32_t codePoint = 0;
+         auto [end, error] = std::from_chars(hex, hex + 4, codePoint, 16);
+         if (error != std::errc() || end != hex + 4)
+         {
+            SetError("invalid \\u escape");
+            return false;
+         }
+
+         // Encode as UTF-8 (surrogate pairs are not combined)
+         if (codePoint < 0x80)
+         {
+            outValue += (char)codePoint;
+         }
+         else if (codePoint < 0x800)
+         {
+            outValue += (char)(0xC0 | (codePoint >> 6));
+            outValue += (char)(0x80 | (codePoint & 0x3F));
+         }
+         else
+         {
+            outValue += (char)(0xE0 | (codePoint >> 12));
+            outValue += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+            outValue += (char)(0x80 | (codePoint & 0x3F));
+         }
+         break;
+      }
+      default:
+         SetError("invalid escape");
+         return false;
+      }
+   }
+}
+
+bool JsonReader::Skip()
+{
+   if (HasError())
+   {
+      return false;
+   }
+
+   SkipWhitespace();
+   switch (Peek())
+   {
+   case '{':
+   {
+      BeginObject();
+      std::string key;
+      while (NextKey(key))
+      {
+         Skip();
+      }
+      return not HasError();
+   }
+   case '[':
+      BeginArray();
+      while (NextElement())
+      {
+         Skip();
+      }
+      return not HasError();
+   case '"':
+   {
+      std::string value;
+      return ReadString(value);
+   }
+   case 't':
+   case 'f':
+   {
+      bool value;
+      return ReadBool(value);
+   }
+   case 'n':
+      for (const char* c = "null"; *c != '\0'; c++)
+      {
+         if (Get() != *c)
+         {
+            SetError("expected null");
+            return false;
+         }
+      }
+      return true;
+   default:
+   {
+      double value;
+      return ReadNumber(value);
+   }
+   }
+}
+
+char JsonReader::Peek()
+{
+   if (m_Position == m_Size)
+   {
+      m_Stream.read(m_Buffer.data(), m_Buffer.size());
+      m_Size = (size_t)m_Stream.gcount();
+      m_Position = 0;
+      if (m_Size == 0)
+      {
+         return '\0';
+      }
+   }
+
+   return m_Buffer[m_Position];
+}
+
+char JsonReader::Get()
+{
+   char c = Peek();
+   if (c != '\0')
+   {
+      m_Position++;
+      m_Line += (c == '\n') ? 1 : 0;
+   }
+   return c;
+}
+
+void JsonReader::SkipWhitespace()
+{
+   while (true)
+   {
+      char c = Peek();
+      if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+      {
+         return;
+      }
+      Get();
+   }
+}
+
+bool JsonReader::Expect(char c)
+{
+   if (HasError())
+   {
+      return false;
+   }
+
+   SkipWhitespace();
+   if (Get() != c)
+   {
+      char message[32];
+      snprintf(message, sizeof(message), "expected '%c'", c);
+      SetError(message);
+      return false;
+   }
+
+   return true;
+}
+
+bool JsonReader::PushScope()
+{
+   if (m_IsFirst.size() >= MaxDepth)
+   {
+      SetError("nested too deeply");
+      return false;
+   }
+
+   m_IsFirst.push_back(true);
+   return true;
+}
+
+void JsonReader::SetError(const char* message)
+{
+   if (HasError())
+   {
+      return;
+   }
+
+   m_Error = "line " + std::to_string(m_Line) + ": " + message;
+}
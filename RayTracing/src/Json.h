@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Minimal streaming JSON writer. Keys/values are written as they come, nothing is kept in memory
+class JsonWriter
+{
+public:
+   JsonWriter(std::ostream& stream);
+
+   void BeginObject();
+   void EndObject();
+   void BeginArray();
+   void EndArray();
+   // Keeps the elements of the next array on one line, for long lists of numbers
+   void BeginCompactArray();
+
+   void Key(const char* key);
+   void Value(double value);
+   void Value(float value);
+   void Value(uint32_t value);
+   void Value(bool value);
+   void Value(const std::string& value);
+
+private:
+   void BeforeValue();
+   void NewLine();
+   void WriteString(const std::string& value);
+
+   struct Scope
+   {
+      bool IsEmpty = true;
+      bool IsCompact = false;
+   };
+
+   std::ostream& m_Stream;
+   std::vector<Scope> m_Scopes;
+   bool m_AfterKey = false;
+};
+
+// Pull parser over a stream, read in fixed size chunks so the size of the document doesn't matter.
+// Loops are written as
+//    reader.BeginObject();
+//    while (reader.NextKey(key)) { ...read or Skip() the value... }
+// Any error makes every further call fail, check HasError() once at the end
+class JsonReader
+{
+public:
+   JsonReader(std::istream& stream);
+
+   // Deeper documents are rejected, so Skip() can't run out of stack on hostile input
+   static constexpr size_t MaxDepth = 256;
+
+   bool BeginObject();
+   // Reads the next key of the current object. Returns false at the end of the object
+   bool NextKey(std::string& outKey);
+
+   bool BeginArray();
+   // Moves to the next element of the current array. Returns false at the end of the array
+   bool NextElement();
+
+   bool ReadNumber(double& outValue);
+   bool ReadFloat(float& outValue);
+   bool ReadUInt(uint32_t& outValue);
+   bool ReadBool(bool& outValue);
+   bool ReadString(std::string& outValue);
+   // Skips whatever value comes next, objects and arrays included
+   bool Skip();
+
+   bool HasError() const { return not m_Error.empty(); }
+   const std::string& GetError() const { return m_Error; }
+
+private:
+   char Peek();
+   char Get();
+   void SkipWhitespace();
+   bool Expect(char c);
+   bool PushScope();
+   void SetError(const char* message);
+
+   std::istream& m_Stream;
+   std::vector<char> m_Buffer;
+   size_t m_Position = 0, m_Size = 0;
+   uint32_t m_Line = 1;
+
+   std::vector<bool> m_IsFirst; // Per open object/array, if no element was read yet
+   std::string m_Error;
+};
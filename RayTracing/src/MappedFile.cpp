@@ -0,0 +1,90 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+   #define NOMINMAX
+   #include <Windows.h>
+#else
+   #include <fcntl.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <unistd.h>
+#endif
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& filepath)
+{
+   std::shared_ptr<MappedFile> file(new MappedFile());
+   file->m_Filepath = filepath;
+
+#if defined(_WIN32)
+   HANDLE fileHandle = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+   if (fileHandle == INVALID_HANDLE_VALUE)
+   {
+      return nullptr;
+   }
+   file->m_FileHandle = fileHandle;
+
+   LARGE_INTEGER size;
+   if (not GetFileSizeEx(fileHandle, &size) || size.QuadPart == 0)
+   {
+      return nullptr;
+   }
+   file->m_Size = (uint64_t)size.QuadPart;
+
+   file->m_MappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+   if (file->m_MappingHandle == nullptr)
+   {
+      return nullptr;
+   }
+
+   file->m_Data = (uint8_t*)MapViewOfFile(file->m_MappingHandle, FILE_MAP_COPY, 0, 0, 0);
+#else
+   int descriptor = open(filepath.c_str(), O_RDONLY);
+   if (descriptor < 0)
+   {
+      return nullptr;
+   }
+
+   struct stat status;
+   if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+   {
+      close(descriptor);
+      return nullptr;
+   }
+   file->m_Size = (uint64_t)status.st_size;
+
+   // The mapping stays valid after the descriptor is closed
+   void* data = mmap(nullptr, file->m_Size, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+   close(descriptor);
+   file->m_Data = (data != MAP_FAILED) ? (uint8_t*)data : nullptr;
+#endif
+
+   if (file->m_Data == nullptr)
+   {
+      return nullptr;
+   }
+
+   return file;
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(_WIN32)
+   if (m_Data != nullptr)
+   {
+      UnmapViewOfFile(m_Data);
+   }
+   if (m_MappingHandle != nullptr)
+   {
+      CloseHandle(m_MappingHandle);
+   }
+   if (m_FileHandle != nullptr)
+   {
+      CloseHandle(m_FileHandle);
+   }
+#else
+   if (m_Data != nullptr)
+   {
+      munmap(m_Data, m_Size);
+   }
+#endif
+}
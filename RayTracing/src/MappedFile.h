@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// A whole file mapped into memory. The mapping is copy-on-write: the pages can be written to,
+// but the changes stay private to the process and never reach the file
+class MappedFile
+{
+public:
+   // Returns nullptr when the file can't be opened or mapped
+   static std::shared_ptr<MappedFile> Open(const std::string& filepath);
+
+   MappedFile(const MappedFile&) = delete;
+   MappedFile& operator=(const MappedFile&) = delete;
+   ~MappedFile();
+
+   uint8_t* GetData() const { return m_Data; }
+   uint64_t GetSize() const { return m_Size; }
+   const std::string& GetFilepath() const { return m_Filepath; }
+
+private:
+   MappedFile() = default;
+
+   std::string m_Filepath;
+   uint8_t* m_Data = nullptr;
+   uint64_t m_Size = 0;
+
+#if defined(_WIN32)
+   void* m_FileHandle = nullptr;
+   void* m_MappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+// Array of trivially copyable T in 64 byte aligned memory. Resize only reallocates when growing past the capacity, the
+// contents are not kept either way
+template<typename T>
+class AlignedBuffer
+{
+public:
+   static_assert(std::is_trivially_copyable_v<T>);
+   static constexpr size_t Alignment = 64;
+
+   AlignedBuffer() = default;
+   AlignedBuffer(const AlignedBuffer&) = delete;
+   AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+   ~AlignedBuffer() { Free(); }
+
+   void Resize(size_t count)
+   {
+      if (count > m_Capacity)
+      {
+         Free();
+         m_Data = (T*)::operator new(count * sizeof(T), std::align_val_t(Alignment));
+         m_Capacity = count;
+      }
+      m_Size = count;
+   }
+
+   T* data() { return m_Data; }
+   const T* data() const { return m_Data; }
+   size_t size() const { return m_Size; }
+
+   T& operator[](size_t index) { return m_Data[index]; }
+   const T& operator[](size_t index) const { return m_Data[index]; }
+
+   // Gives the memory back, the next Resize allocates again
+   void Free()
+   {
+      if (m_Data != nullptr)
+      {
+         ::operator delete((void*)m_Data, std::align_val_t(Alignment));
+      }
+      m_Data = nullptr;
+      m_Size = 0;
+      m_Capacity = 0;
+   }
+private:
+   T* m_Data = nullptr;
+   size_t m_Size = 0;
+   size_t m_Capacity = 0;
+};
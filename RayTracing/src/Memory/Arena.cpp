@@ -0,0 +1,39 @@
+#include "Arena.h"
+
+#include <new>
+
+Arena::Arena(size_t blockSize)
+   : m_BlockSize(blockSize)
+{
+}
+
+Arena::~Arena()
+{
+   for (const Block& block : m_Blocks)
+   {
+      ::operator delete((void*)block.Data, std::align_val_t(Alignment));
+   }
+}
+
+void* Arena::Allocate(size_t bytes)
+{
+   // Keeps every allocation (and so the next one) aligned
+   bytes = (bytes + Alignment - 1) & ~(Alignment - 1);
+   if (bytes == 0)
+   {
+      bytes = Alignment;
+   }
+
+   if (m_Blocks.empty() || m_Offset + bytes > m_Blocks.back().Size)
+   {
+      // Buffers bigger than a block get a block of their own
+      size_t size = (bytes > m_BlockSize) ? bytes : m_BlockSize;
+      m_Blocks.push_back({ (std::byte*)::operator new(size, std::align_val_t(Alignment)), size });
+      m_Offset = 0;
+      m_ReservedBytes += size;
+   }
+
+   void* memory = m_Blocks.back().Data + m_Offset;
+   m_Offset += bytes;
+   return memory;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator handing out 64 byte aligned ranges of large blocks, so the buffers of an owner (like the meshes of a scene)
+// sit next to each other. Nothing is freed on its own, all blocks go at once with the arena
+class Arena
+{
+public:
+   static constexpr size_t Alignment = 64;
+
+   explicit Arena(size_t blockSize = 4 << 20);
+   Arena(const Arena&) = delete;
+   Arena& operator=(const Arena&) = delete;
+   ~Arena();
+
+   void* Allocate(size_t bytes);
+
+   // Uninitialized, only for types that need no destructor
+   template<typename T>
+   T* Allocate(size_t count)
+   {
+      static_assert(std::is_trivially_destructible_v<T>, "Arena memory is released without running destructors");
+      return (T*)Allocate(count * sizeof(T));
+   }
+
+   template<typename T>
+   T* Copy(const T* data, size_t count)
+   {
+      static_assert(std::is_trivially_copyable_v<T>);
+      T* copy = Allocate<T>(count);
+      if (count > 0)
+      {
+         memcpy(copy, data, count * sizeof(T));
+      }
+      return copy;
+   }
+
+   // Bytes of all blocks, used or not
+   size_t GetReservedBytes() const { return m_ReservedBytes; }
+private:
+   struct Block
+   {
+      std::byte* Data;
+      size_t Size;
+   };
+
+   std::vector<Block> m_Blocks;
+   size_t m_BlockSize;
+   size_t m_Offset = 0; // Into the last block
+   size_t m_ReservedBytes = 0;
+};
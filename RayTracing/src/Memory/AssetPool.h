@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Refers to an asset of an AssetPool. The generation tells a handle to a released asset apart from the asset that reuses its slot
+template<typename T>
+struct AssetHandle
+{
+   uint32_t Index = UINT32_MAX;
+   uint32_t Generation = 0;
+
+   bool IsValid() const { return Index != UINT32_MAX; }
+   bool operator==(const AssetHandle& other) const = default;
+};
+
+// Assets stored in chunks of contiguous, 64 byte aligned memory. Chunks never move, so an asset's address is stable until it
+// is released. The pool releases everything at once when it is destroyed, the owning scene doesn't free assets one by one
+template<typename T, uint32_t ChunkSize = 256>
+class AssetPool
+{
+public:
+   static constexpr size_t Alignment = 64;
+
+   AssetPool() = default;
+   AssetPool(const AssetPool&) = delete;
+   AssetPool& operator=(const AssetPool&) = delete;
+   ~AssetPool() { Clear(); }
+
+   template<typename... Args>
+   AssetHandle<T> Create(Args&&... args)
+   {
+      uint32_t index;
+      if (not m_FreeSlots.empty())
+      {
+         index = m_FreeSlots.back();
+         m_FreeSlots.pop_back();
+      }
+      else
+      {
+         index = (uint32_t)m_Generations.size();
+         m_Generations.push_back(0);
+         m_Alive.push_back(false);
+         if (index % ChunkSize == 0)
+         {
+            m_Chunks.push_back((T*)::operator new(sizeof(T) * ChunkSize, std::align_val_t(Alignment)));
+         }
+      }
+
+      new (GetSlot(index)) T(std::forward<Args>(args)...);
+      m_Alive[index] = true;
+      m_Count++;
+      return { index, m_Generations[index] };
+   }
+
+   // The slot is reused by a later Create, handles to the released asset stop resolving
+   void Release(AssetHandle<T> handle)
+   {
+      if (Get(handle) == nullptr)
+      {
+         return;
+      }
+
+      GetSlot(handle.Index)->~T();
+      m_Alive[handle.Index] = false;
+      m_Generations[handle.Index]++;
+      m_FreeSlots.push_back(handle.Index);
+      m_Count--;
+   }
+
+   // nullptr for invalid and released handles
+   T* Get(AssetHandle<T> handle)
+   {
+      return IsAlive(handle) ? GetSlot(handle.Index) : nullptr;
+   }
+
+   const T* Get(AssetHandle<T> handle) const
+   {
+      return IsAlive(handle) ? GetSlot(handle.Index) : nullptr;
+   }
+
+   uint32_t GetCount() const { return m_Count; }
+
+   // Calls func(handle, asset) for every asset, in slot order
+   template<typename Func>
+   void ForEach(Func&& func) const
+   {
+      for (uint32_t index = 0; index < (uint32_t)m_Alive.size(); index++)
+      {
+         if (m_Alive[index])
+         {
+            func(AssetHandle<T>{ index, m_Generations[index] }, *GetSlot(index));
+         }
+      }
+   }
+
+   void Clear()
+   {
+      for (uint32_t index = 0; index < (uint32_t)m_Alive.size(); index++)
+      {
+         if (m_Alive[index])
+         {
+            GetSlot(index)->~T();
+         }
+      }
+
+      for (T* chunk : m_Chunks)
+      {
+         ::operator delete((void*)chunk, std::align_val_t(Alignment));
+      }
+
+      m_Chunks.clear();
+      m_Generations.clear();
+      m_Alive.clear();
+      m_FreeSlots.clear();
+      m_Count = 0;
+   }
+
+private:
+   bool IsAlive(AssetHandle<T> handle) const
+   {
+      return handle.Index < m_Alive.size() && m_Alive[handle.Index] && m_Generations[handle.Index] == handle.Generation;
+   }
+
+   T* GetSlot(uint32_t index) const { return m_Chunks[index / ChunkSize] + (index % ChunkSize); }
+
+   std::vector<T*> m_Chunks;
+   std::vector<uint32_t> m_Generations;
+   std::vector<bool> m_Alive;
+   std::vector<uint32_t> m_FreeSlots;
+   uint32_t m_Count = 0;
+};
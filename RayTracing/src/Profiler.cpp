@@ -0,0 +1,163 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+
+std::vector<Profiler::FrameStats> Profiler::s_History(Profiler::s_HistorySize);
+
+void Profiler::Record(ProfileStage stage, uint64_t startNs, uint64_t endNs)
+{
+   ThreadBuffer& buffer = GetThreadBuffer();
+
+   // Single writer per ring, the reader only looks at indices below WriteIndex
+   uint64_t index = buffer.WriteIndex.load(std::memory_order_relaxed);
+   buffer.Ring[index & (s_RingCapacity - 1)] = { stage, buffer.ThreadID, startNs, endNs - startNs };
+   buffer.WriteIndex.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::Accumulate(ProfileStage stage, uint64_t durationNs)
+{
+   ThreadBuffer& buffer = GetThreadBuffer();
+   buffer.HotNs[(uint32_t)stage] += durationNs;
+   buffer.HotCalls[(uint32_t)stage]++;
+}
+
+void Profiler::EndFrame()
+{
+   FrameStats stats = {};
+
+   {
+      std::lock_guard<std::mutex> lock(s_ThreadBuffersMutex);
+      for (ThreadBuffer* buffer : s_ThreadBuffers)
+      {
+         uint64_t writeIndex = buffer->WriteIndex.load(std::memory_order_acquire);
+         uint64_t oldest = (writeIndex > s_RingCapacity) ? (writeIndex - s_RingCapacity) : 0;
+
+         for (uint64_t i = std::max(buffer->ReadIndex, oldest); i < writeIndex; i++)
+         {
+            const Event& event = buffer->Ring[i & (s_RingCapacity - 1)];
+            stats.StageMs[(uint32_t)event.Stage] += event.DurationNs * 1e-6;
+            stats.StageCalls[(uint32_t)event.Stage]++;
+         }
+         buffer->ReadIndex = writeIndex;
+
+         for (uint32_t stage = 0; stage < (uint32_t)ProfileStage::Count; stage++)
+         {
+            uint64_t hotNs = buffer->HotNs[stage];
+            uint64_t hotCalls = buffer->HotCalls[stage];
+            stats.StageMs[stage] += (hotNs - buffer->HotNsRead[stage]) * 1e-6;
+            stats.StageCalls[stage] += (uint32_t)(hotCalls - buffer->HotCallsRead[stage]);
+            buffer->HotNsRead[stage] = hotNs;
+            buffer->HotCallsRead[stage] = hotCalls;
+         }
+      }
+   }
+
+   s_History[s_HistoryOffset] = stats;
+   s_HistoryOffset = (s_HistoryOffset + 1) % s_HistorySize;
+   s_HistoryCount = std::min(s_HistoryCount + 1, s_HistorySize);
+}
+
+const char* Profiler::GetStageName(ProfileStage stage)
+{
+   switch (stage)
+   {
+   case ProfileStage::Frame:         return "Frame";
+   case ProfileStage::ScenePacking:  return "Scene packing";
+   case ProfileStage::RayGeneration: return "Ray generation";
+   case ProfileStage::Trace:         return "Trace";
+   case ProfileStage::Traversal:     return "Traversal";
+   case ProfileStage::Shading:       return "Shading";
+   case ProfileStage::Resolve:       return "Resolve";
+   case ProfileStage::Upload:        return "Upload";
+   default:                          return "Unknown";
+   }
+}
+
+Profiler::FrameStats Profiler::GetAverage()
+{
+   FrameStats average = {};
+   if (s_HistoryCount == 0)
+   {
+      return average;
+   }
+
+   for (uint32_t i = 0; i < s_HistoryCount; i++)
+   {
+      const FrameStats& stats = s_History[(s_HistoryOffset + s_HistorySize - 1 - i) % s_HistorySize];
+      for (uint32_t stage = 0; stage < (uint32_t)ProfileStage::Count; stage++)
+      {
+         average.StageMs[stage] += stats.StageMs[stage];
+         average.StageCalls[stage] += stats.StageCalls[stage];
+      }
+   }
+
+   for (uint32_t stage = 0; stage < (uint32_t)ProfileStage::Count; stage++)
+   {
+      average.StageMs[stage] /= s_HistoryCount;
+      average.StageCalls[stage] /= s_HistoryCount;
+   }
+
+   return average;
+}
+
+bool Profiler::ExportChromeTrace(const std::string& filepath)
+{
+   std::ofstream file(filepath);
+   if (not file.is_open())
+   {
+      return false;
+   }
+
+   std::lock_guard<std::mutex> lock(s_ThreadBuffersMutex);
+
+   // Timestamps relative to the oldest event still in a ring
+   uint64_t baseNs = UINT64_MAX;
+   for (ThreadBuffer* buffer : s_ThreadBuffers)
+   {
+      uint64_t writeIndex = buffer->WriteIndex.load(std::memory_order_acquire);
+      uint64_t oldest = (writeIndex > s_RingCapacity) ? (writeIndex - s_RingCapacity) : 0;
+      for (uint64_t i = oldest; i < writeIndex; i++)
+      {
+         baseNs = std::min(baseNs, buffer->Ring[i & (s_RingCapacity - 1)].StartNs);
+      }
+   }
+
+   file << "{\"traceEvents\":[";
+   bool first = true;
+   for (ThreadBuffer* buffer : s_ThreadBuffers)
+   {
+      uint64_t writeIndex = buffer->WriteIndex.load(std::memory_order_acquire);
+      uint64_t oldest = (writeIndex > s_RingCapacity) ? (writeIndex - s_RingCapacity) : 0;
+      for (uint64_t i = oldest; i < writeIndex; i++)
+      {
+         const Event& event = buffer->Ring[i & (s_RingCapacity - 1)];
+
+         file << (first ? "\n" : ",\n");
+         file << "{\"name\":\"" << GetStageName(event.Stage) << "\",\"cat\":\"RayTracing\",\"ph\":\"X\""
+              << ",\"ts\":" << (event.StartNs - baseNs) / 1000.0
+              << ",\"dur\":" << event.DurationNs / 1000.0
+              << ",\"pid\":0,\"tid\":" << event.ThreadID << "}";
+         first = false;
+      }
+   }
+   file << "\n]}\n";
+
+   return file.good();
+}
+
+Profiler::ThreadBuffer& Profiler::GetThreadBuffer()
+{
+   // Intentionally never freed, the pool threads behind std::execution::par outlive every frame
+   thread_local ThreadBuffer* buffer = nullptr;
+   if (buffer == nullptr)
+   {
+      buffer = new ThreadBuffer();
+
+      std::lock_guard<std::mutex> lock(s_ThreadBuffersMutex);
+      buffer->ThreadID = (uint32_t)s_ThreadBuffers.size();
+      s_ThreadBuffers.push_back(buffer);
+   }
+
+   return *buffer;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Compile-time switches. The per-pixel scopes (traversal/shading) are off by default,
+// as a clock read per ray is noticeable next to a traversal of a handful of spheres
+#ifndef RT_ENABLE_PROFILER
+   #define RT_ENABLE_PROFILER 1
+#endif
+#ifndef RT_PROFILE_HOT_PATH
+   #define RT_PROFILE_HOT_PATH 0
+#endif
+
+enum class ProfileStage : uint32_t
+{
+   Frame = 0,
+   ScenePacking,
+   RayGeneration,
+   Trace,
+   Traversal,
+   Shading,
+   Resolve,
+   Upload,
+
+   Count
+};
+
+class Profiler
+{
+public:
+   struct Event
+   {
+      ProfileStage Stage;
+      uint32_t ThreadID;
+      uint64_t StartNs;
+      uint64_t DurationNs;
+   };
+
+   // Aggregated numbers of one frame. Stages recorded on several threads are summed (CPU time)
+   struct FrameStats
+   {
+      double StageMs[(uint32_t)ProfileStage::Count] = {};
+      uint32_t StageCalls[(uint32_t)ProfileStage::Count] = {};
+   };
+
+   static uint64_t Now()
+   {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   }
+
+   static void Record(ProfileStage stage, uint64_t startNs, uint64_t endNs);
+   // Hot path counters only add to a per-thread total, no event is stored
+   static void Accumulate(ProfileStage stage, uint64_t durationNs);
+
+   // Collects everything recorded since the last call into the rolling history. Called once per frame from the main thread
+   static void EndFrame();
+
+   static const char* GetStageName(ProfileStage stage);
+   static const std::vector<FrameStats>& GetHistory() { return s_History; }
+   static uint32_t GetHistoryOffset() { return s_HistoryOffset; }
+   static FrameStats GetAverage();
+
+   // Writes the events still held by the ring buffers in the Chrome tracing format (chrome://tracing, Perfetto)
+   static bool ExportChromeTrace(const std::string& filepath);
+
+private:
+   static constexpr uint32_t s_RingCapacity = 1 << 14; // Events per thread, must be a power of two
+   static constexpr uint32_t s_HistorySize = 128;      // Frames
+
+   struct alignas(64) ThreadBuffer
+   {
+      uint32_t ThreadID = 0;
+      std::vector<Event> Ring = std::vector<Event>(s_RingCapacity);
+      std::atomic<uint64_t> WriteIndex = 0;
+      uint64_t ReadIndex = 0; // Only touched by EndFrame
+
+      uint64_t HotNs[(uint32_t)ProfileStage::Count] = {};
+      uint64_t HotCalls[(uint32_t)ProfileStage::Count] = {};
+      uint64_t HotNsRead[(uint32_t)ProfileStage::Count] = {};
+      uint64_t HotCallsRead[(uint32_t)ProfileStage::Count] = {};
+   };
+
+   static ThreadBuffer& GetThreadBuffer();
+
+   inline static std::mutex s_ThreadBuffersMutex;
+   inline static std::vector<ThreadBuffer*> s_ThreadBuffers;
+
+   static std::vector<FrameStats> s_History;
+   inline static uint32_t s_HistoryOffset = 0; // Next slot to be written
+   inline static uint32_t s_HistoryCount = 0;
+};
+
+class ProfileScope
+{
+public:
+   ProfileScope(ProfileStage stage)
+      : m_Stage(stage), m_Start(Profiler::Now()) {}
+   ~ProfileScope() { Profiler::Record(m_Stage, m_Start, Profiler::Now()); }
+private:
+   ProfileStage m_Stage;
+   uint64_t m_Start;
+};
+
+class ProfileHotScope
+{
+public:
+   ProfileHotScope(ProfileStage stage)
+      : m_Stage(stage), m_Start(Profiler::Now()) {}
+   ~ProfileHotScope() { Profiler::Accumulate(m_Stage, Profiler::Now() - m_Start); }
+private:
+   ProfileStage m_Stage;
+   uint64_t m_Start;
+};
+
+#define RT_PROFILE_CONCAT_INNER(a, b) a##b
+#define RT_PROFILE_CONCAT(a, b) RT_PROFILE_CONCAT_INNER(a, b)
+
+#if RT_ENABLE_PROFILER
+   #define PROFILE_SCOPE(stage) ProfileScope RT_PROFILE_CONCAT(profileScope, __LINE__)(stage)
+#else
+   #define PROFILE_SCOPE(stage)
+#endif
+
+#if RT_ENABLE_PROFILER && RT_PROFILE_HOT_PATH
+   #define PROFILE_HOT_SCOPE(stage) ProfileHotScope RT_PROFILE_CONCAT(profileHotScope, __LINE__)(stage)
+#else
+   #define PROFILE_HOT_SCOPE(stage)
+#endif
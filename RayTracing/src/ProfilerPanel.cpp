@@ -0,0 +1,100 @@
+#include "ProfilerPanel.h"
+#include "Profiler.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+void ProfilerPanel::Render()
+{
+   if (not ImGui::CollapsingHeader("Profiler"))
+   {
+      return;
+   }
+
+   Profiler::FrameStats average = Profiler::GetAverage();
+   double frameMs = average.StageMs[(uint32_t)ProfileStage::Frame];
+
+   ImGui::Text("Frame: %.3fms (average of the last frames)", frameMs);
+   ImGui::TextDisabled("Stages running on several threads show summed CPU time");
+
+   if (ImGui::BeginTable("ProfilerStages", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+   {
+      ImGui::TableSetupColumn("Stage");
+      ImGui::TableSetupColumn("ms");
+      ImGui::TableSetupColumn("Calls");
+      ImGui::TableHeadersRow();
+
+      for (uint32_t stage = 1; stage < (uint32_t)ProfileStage::Count; stage++)
+      {
+         if (average.StageCalls[stage] == 0)
+         {
+            continue;
+         }
+
+         ImGui::TableNextRow();
+         ImGui::TableNextColumn();
+         ImGui::TextUnformatted(Profiler::GetStageName((ProfileStage)stage));
+         ImGui::TableNextColumn();
+         ImGui::Text("%.3f", average.StageMs[stage]);
+         ImGui::TableNextColumn();
+         ImGui::Text("%u", average.StageCalls[stage]);
+      }
+
+      ImGui::EndTable();
+   }
+
+   // Frame time over the history, oldest first
+   const std::vector<Profiler::FrameStats>& history = Profiler::GetHistory();
+   std::vector<float> frameTimes(history.size());
+   for (uint32_t i = 0; i < history.size(); i++)
+   {
+      const Profiler::FrameStats& stats = history[(Profiler::GetHistoryOffset() + i) % history.size()];
+      frameTimes[i] = (float)stats.StageMs[(uint32_t)ProfileStage::Frame];
+   }
+   ImGui::PlotLines("##FrameTimes", frameTimes.data(), (int)frameTimes.size(), 0, "Frame time (ms)", 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+
+   // Distribution of the frame times
+   float minTime = FLT_MAX, maxTime = 0.0f;
+   for (float frameTime : frameTimes)
+   {
+      if (frameTime > 0.0f)
+      {
+         minTime = std::min(minTime, frameTime);
+         maxTime = std::max(maxTime, frameTime);
+      }
+   }
+
+   if (maxTime > 0.0f)
+   {
+      constexpr uint32_t binCount = 24;
+      float bins[binCount] = {};
+      float binSize = std::max((maxTime - minTime) / binCount, 1e-3f);
+      for (float frameTime : frameTimes)
+      {
+         if (frameTime > 0.0f)
+         {
+            uint32_t bin = std::min((uint32_t)((frameTime - minTime) / binSize), binCount - 1);
+            bins[bin] += 1.0f;
+         }
+      }
+
+      char overlay[64];
+      snprintf(overlay, sizeof(overlay), "%.2fms - %.2fms", minTime, maxTime);
+      ImGui::PlotHistogram("##FrameTimeHistogram", bins, binCount, 0, overlay, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+   }
+
+   if (ImGui::Button("Export Chrome trace"))
+   {
+      const char* filepath = "profile_trace.json";
+      m_ExportStatus = Profiler::ExportChromeTrace(filepath) ? std::string("Saved ") + filepath : std::string("Could not write ") + filepath;
+   }
+
+   if (not m_ExportStatus.empty())
+   {
+      ImGui::SameLine();
+      ImGui::TextUnformatted(m_ExportStatus.c_str());
+   }
+}
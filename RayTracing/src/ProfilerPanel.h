@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+class ProfilerPanel
+{
+public:
+   ProfilerPanel() = default;
+   ~ProfilerPanel() = default;
+
+   // Draws into the currently open window (the Settings window)
+   void Render();
+private:
+   std::string m_ExportStatus = {};
+};
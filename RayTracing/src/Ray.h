@@ -6,4 +6,5 @@ struct Ray
 {
    glm::vec3 Origin;
    glm::vec3 Direction;
+   float Time = 0.0f; // Time since the shutter opened, only used with motion blur
 };
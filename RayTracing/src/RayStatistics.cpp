@@ -0,0 +1,39 @@
+#include "RayStatistics.h"
+
+RayStatistics::FrameStatistics RayStatistics::Collect(double frameSeconds)
+{
+   RayCounters totals = {};
+
+   std::lock_guard<std::mutex> lock(s_Mutex);
+   for (const RayCounters* counters : s_ThreadCounters)
+   {
+      totals.PrimaryRays   += counters->PrimaryRays;
+      totals.SecondaryRays += counters->SecondaryRays;
+      totals.Misses        += counters->Misses;
+      totals.SphereTests   += counters->SphereTests;
+      totals.TriangleTests += counters->TriangleTests;
+      totals.NodeTests     += counters->NodeTests;
+   }
+
+   FrameStatistics frame;
+   frame.Seconds = frameSeconds;
+   frame.Counters.PrimaryRays   = totals.PrimaryRays   - s_CollectedTotals.PrimaryRays;
+   frame.Counters.SecondaryRays = totals.SecondaryRays - s_CollectedTotals.SecondaryRays;
+   frame.Counters.Misses        = totals.Misses        - s_CollectedTotals.Misses;
+   frame.Counters.SphereTests   = totals.SphereTests   - s_CollectedTotals.SphereTests;
+   frame.Counters.TriangleTests = totals.TriangleTests - s_CollectedTotals.TriangleTests;
+   frame.Counters.NodeTests     = totals.NodeTests     - s_CollectedTotals.NodeTests;
+
+   s_CollectedTotals = totals;
+   return frame;
+}
+
+RayCounters* RayStatistics::RegisterThread()
+{
+   // Intentionally never freed, the pool threads behind std::execution::par outlive every frame
+   RayCounters* counters = new RayCounters();
+
+   std::lock_guard<std::mutex> lock(s_Mutex);
+   s_ThreadCounters.push_back(counters);
+   return counters;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Compile-time switch, with 0 every RAY_STATS_ADD disappears
+#ifndef RT_ENABLE_RAY_STATISTICS
+   #define RT_ENABLE_RAY_STATISTICS 1
+#endif
+
+// Owned by one thread, padded to a cache line so neighbouring threads never share one
+struct alignas(64) RayCounters
+{
+   uint64_t PrimaryRays = 0;
+   uint64_t SecondaryRays = 0;
+   uint64_t Misses = 0;
+   uint64_t SphereTests = 0;
+   uint64_t TriangleTests = 0;
+   uint64_t NodeTests = 0; // BVH nodes tested, a wide node (all children at once) counts once
+};
+
+class RayStatistics
+{
+public:
+   // Counters of one frame, summed over all threads
+   struct FrameStatistics
+   {
+      RayCounters Counters = {};
+      double Seconds = 0.0;
+
+      uint64_t GetRays() const { return Counters.PrimaryRays + Counters.SecondaryRays; }
+      double GetMraysPerSecond() const { return (Seconds > 0.0) ? (GetRays() / Seconds) * 1e-6 : 0.0; }
+      double GetAverageBounceDepth() const { return (Counters.PrimaryRays > 0) ? (double)GetRays() / Counters.PrimaryRays : 0.0; }
+      double GetMissRate() const { return (GetRays() > 0) ? (double)Counters.Misses / GetRays() : 0.0; }
+   };
+
+   static RayCounters& GetThreadCounters()
+   {
+      thread_local RayCounters* counters = RegisterThread();
+      return *counters;
+   }
+
+   // Sums what every thread counted since the last call. Must not run while a frame is being traced
+   static FrameStatistics Collect(double frameSeconds);
+
+private:
+   static RayCounters* RegisterThread();
+
+   inline static std::mutex s_Mutex;
+   inline static std::vector<RayCounters*> s_ThreadCounters;
+   inline static RayCounters s_CollectedTotals = {};
+};
+
+#if RT_ENABLE_RAY_STATISTICS
+   #define RAY_STATS_ADD(counter, value) RayStatistics::GetThreadCounters().counter += (value)
+#else
+   #define RAY_STATS_ADD(counter, value)
+#endif
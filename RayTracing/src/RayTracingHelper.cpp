@@ -68,6 +68,39 @@ float RayTracingHelper::RayTriangleIntersection(const Ray& ray, const Vertex tri
    return -1.0f;
 }
 
+float RayTracingHelper::RayTriangleIntersection(const Ray& ray, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+{
+   // Moller-Trumbore. No normal is needed, the winding decides which side is the front
+   glm::vec3 edge0 = p1 - p0;
+   glm::vec3 edge1 = p2 - p0;
+   glm::vec3 pVec = glm::cross(ray.Direction, edge1);
+   float determinant = glm::dot(edge0, pVec);
+
+   // Negative when looking at the back face, ~0 when the ray is parallel to the triangle
+   if (determinant < 1e-8f)
+   {
+      return -1.0f;
+   }
+
+   float invDeterminant = 1.0f / determinant;
+   glm::vec3 tVec = ray.Origin - p0;
+   float u = glm::dot(tVec, pVec) * invDeterminant;
+   if (u < 0.0f || u > 1.0f)
+   {
+      return -1.0f;
+   }
+
+   glm::vec3 qVec = glm::cross(tVec, edge0);
+   float v = glm::dot(ray.Direction, qVec) * invDeterminant;
+   if (v < 0.0f || u + v > 1.0f)
+   {
+      return -1.0f;
+   }
+
+   float t = glm::dot(edge1, qVec) * invDeterminant;
+   return (t >= 0.0f) ? t : -1.0f;
+}
+
 float RayTracingHelper::RaySphereIntersection(const Ray& ray, glm::vec3 position, float radius)
 {
    glm::vec3 origin = ray.Origin - position;
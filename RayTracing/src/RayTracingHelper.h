@@ -9,6 +9,8 @@ class RayTracingHelper
 public:
    // Returns -1 on miss, otherwise returns T
    static float RayTriangleIntersection(const Ray& ray, const Vertex triangle[]);
+   // Same culling as above, but only needs the positions. The front face is the one with counter-clockwise winding
+   static float RayTriangleIntersection(const Ray& ray, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2);
    static float RaySphereIntersection(const Ray& ray, glm::vec3 position, float radius);
 
    static bool IsPerpendicular(glm::vec3 vec0, glm::vec3 vec1);
@@ -0,0 +1,340 @@
+#include "RenderScene.h"
+
+#include "Acceleration/WideBVH.h"
+#include "Hasher.h"
+
+namespace
+{
+   bool IsSameMaterial(const RenderScene& a, uint32_t indexA, const RenderScene& b, uint32_t indexB)
+   {
+      if (indexA == RenderScene::NoMaterial || indexB == RenderScene::NoMaterial)
+      {
+         return indexA == indexB;
+      }
+
+      const Material& materialA = a.Materials[indexA];
+      const Material& materialB = b.Materials[indexB];
+      return materialA.m_Albedo == materialB.m_Albedo && materialA.m_Roughness == materialB.m_Roughness &&
+             materialA.m_Metallic == materialB.m_Metallic && materialA.m_EmissionPower == materialB.m_EmissionPower;
+   }
+
+   bool IsEmissive(const RenderScene& scene, uint32_t materialIndex)
+   {
+      return materialIndex != RenderScene::NoMaterial && scene.Materials[materialIndex].m_EmissionPower > 0.0f;
+   }
+}
+
+uint64_t RenderScene::GetContentHash() const
+{
+   auto addMaterial = [this](Hasher& hasher, uint32_t materialIndex)
+   {
+      if (materialIndex == NoMaterial)
+      {
+         hasher.Add(NoMaterial);
+         return;
+      }
+
+      const Material& material = Materials[materialIndex];
+      hasher.Add(material.m_Albedo);
+      hasher.Add(material.m_Roughness);
+      hasher.Add(material.m_Metallic);
+      hasher.Add(material.m_EmissionPower);
+   };
+
+   // The primitives' hashes are summed, so their order doesn't matter
+   uint64_t sphereHash = 0;
+   for (const Sphere& sphere : Spheres)
+   {
+      Hasher hasher;
+      hasher.Add(sphere.Position);
+      hasher.Add(sphere.Radius);
+      hasher.Add(sphere.Velocity);
+      addMaterial(hasher, sphere.MaterialIndex);
+      sphereHash += hasher.Get();
+   }
+
+   uint64_t meshHash = 0;
+   for (const MeshInstance& instance : Meshes)
+   {
+      const Mesh& mesh = *instance.Mesh;
+      Hasher hasher;
+      for (uint32_t i = 0; i < mesh.m_VertexCount; i++)
+      {
+         hasher.Add(mesh.m_Vertices[i].m_Position);
+         hasher.Add(mesh.m_Vertices[i].m_Normal);
+      }
+      hasher.Add(mesh.m_Indices, (uint64_t)mesh.m_TriangleCount * 3 * sizeof(uint32_t));
+      addMaterial(hasher, instance.MaterialIndex);
+      meshHash += hasher.Get();
+   }
+
+   Hasher hasher;
+   hasher.Add((uint64_t)Spheres.size());
+   hasher.Add(sphereHash);
+   hasher.Add((uint64_t)Meshes.size());
+   hasher.Add(meshHash);
+   return hasher.Get();
+}
+
+AABB RenderScene::GetSphereBounds(uint32_t index) const
+{
+   const Sphere& sphere = Spheres[index];
+   const glm::vec3 extent(sphere.Radius);
+
+   AABB bounds(sphere.Position - extent, sphere.Position + extent);
+   if (ShutterTime > 0.0f)
+   {
+      glm::vec3 endPosition = sphere.Position + sphere.Velocity * ShutterTime;
+      bounds.Grow(AABB(endPosition - extent, endPosition + extent));
+   }
+   return bounds;
+}
+
+AABB RenderScene::GetMeshBounds(uint32_t index) const
+{
+   const Mesh& mesh = *Meshes[index].Mesh;
+   if (mesh.m_WideBVHNodeCount > 0)
+   {
+      return WideBVHBuilder::GetBounds(mesh.m_WideBVHNodes[0]);
+   }
+   if (mesh.m_BVHNodeCount == 0)
+   {
+      return AABB();
+   }
+   return AABB(mesh.m_BVHNodes[0].m_Min, mesh.m_BVHNodes[0].m_Max);
+}
+
+bool RenderScene::Diff(const RenderScene& previous, const RenderScene& current, std::vector<UUID>& changedIDs, std::vector<AABB>& changedBounds)
+{
+   bool changedLighting = false;
+
+   // Whatever is left in the maps after going over the current primitives was removed
+   std::unordered_map<UUID, uint32_t> previousSpheres;
+   for (uint32_t i = 0; i < (uint32_t)previous.Spheres.size(); i++)
+   {
+      previousSpheres[previous.SphereIDs[i]] = i;
+   }
+
+   for (uint32_t i = 0; i < (uint32_t)current.Spheres.size(); i++)
+   {
+      auto it = previousSpheres.find(current.SphereIDs[i]);
+      if (it == previousSpheres.end())
+      {
+         changedIDs.push_back(current.SphereIDs[i]);
+         changedBounds.push_back(current.GetSphereBounds(i));
+         changedLighting |= IsEmissive(current, current.Spheres[i].MaterialIndex);
+         continue;
+      }
+
+      const Sphere& before = previous.Spheres[it->second];
+      const Sphere& after = current.Spheres[i];
+      const bool sameMaterial = IsSameMaterial(previous, before.MaterialIndex, current, after.MaterialIndex);
+      if (before.Position != after.Position || before.Radius != after.Radius || before.Velocity != after.Velocity || not sameMaterial)
+      {
+         changedLighting |= IsEmissive(previous, before.MaterialIndex) || IsEmissive(current, after.MaterialIndex);
+         changedIDs.push_back(current.SphereIDs[i]);
+         changedBounds.push_back(previous.GetSphereBounds(it->second));
+         changedBounds.push_back(current.GetSphereBounds(i));
+      }
+      previousSpheres.erase(it);
+   }
+
+   for (const auto& [id, index] : previousSpheres)
+   {
+      changedLighting |= IsEmissive(previous, previous.Spheres[index].MaterialIndex);
+      changedIDs.push_back(id);
+      changedBounds.push_back(previous.GetSphereBounds(index));
+   }
+
+   std::unordered_map<UUID, uint32_t> previousMeshes;
+   for (uint32_t i = 0; i < (uint32_t)previous.Meshes.size(); i++)
+   {
+      previousMeshes[previous.MeshIDs[i]] = i;
+   }
+
+   for (uint32_t i = 0; i < (uint32_t)current.Meshes.size(); i++)
+   {
+      auto it = previousMeshes.find(current.MeshIDs[i]);
+      if (it == previousMeshes.end())
+      {
+         changedIDs.push_back(current.MeshIDs[i]);
+         changedBounds.push_back(current.GetMeshBounds(i));
+         changedLighting |= IsEmissive(current, current.Meshes[i].MaterialIndex);
+         continue;
+      }
+
+      const MeshInstance& before = previous.Meshes[it->second];
+      const MeshInstance& after = current.Meshes[i];
+      const bool sameMaterial = IsSameMaterial(previous, before.MaterialIndex, current, after.MaterialIndex);
+      if (before.Mesh != after.Mesh || not sameMaterial)
+      {
+         changedLighting |= IsEmissive(previous, before.MaterialIndex) || IsEmissive(current, after.MaterialIndex);
+         changedIDs.push_back(current.MeshIDs[i]);
+         changedBounds.push_back(previous.GetMeshBounds(it->second));
+         changedBounds.push_back(current.GetMeshBounds(i));
+      }
+      previousMeshes.erase(it);
+   }
+
+   for (const auto& [id, index] : previousMeshes)
+   {
+      changedLighting |= IsEmissive(previous, previous.Meshes[index].MaterialIndex);
+      changedIDs.push_back(id);
+      changedBounds.push_back(previous.GetMeshBounds(index));
+   }
+   return changedLighting;
+}
+
+std::shared_ptr<const RenderScene> RenderSceneBuilder::Update(Scene& scene, const Options& options)
+{
+   bool spheresChanged = false;
+   bool changed = false;
+   if (m_SceneID != scene.GetInstanceID())
+   {
+      m_SceneID = scene.GetInstanceID();
+      scene.ConsumeChanges();
+
+      m_Spheres.Clear();
+      for (entt::entity entity : scene.GetAllEntitiesWith<SphereComponent, IDComponent>())
+      {
+         m_Spheres.Update(scene, entity);
+      }
+
+      m_Meshes.Clear();
+      for (entt::entity entity : scene.GetAllEntitiesWith<MeshComponent, IDComponent>())
+      {
+         m_Meshes.Update(scene, entity);
+      }
+      spheresChanged = changed = true;
+   }
+   else
+   {
+      Scene::Changes changes = scene.ConsumeChanges();
+      for (entt::entity entity : changes.Spheres)
+      {
+         spheresChanged |= m_Spheres.Update(scene, entity);
+      }
+      for (entt::entity entity : changes.Meshes)
+      {
+         changed |= m_Meshes.Update(scene, entity);
+      }
+
+      // Picks up another material assigned to the entity. The values of all materials are copied with the next snapshot anyway
+      for (entt::entity entity : changes.Materials)
+      {
+         changed |= m_Spheres.Update(scene, entity);
+         changed |= m_Meshes.Update(scene, entity);
+      }
+      changed |= spheresChanged;
+   }
+
+   if (spheresChanged)
+   {
+      m_HasMovingSpheres = false;
+      for (const auto& sphere : m_Spheres)
+      {
+         m_HasMovingSpheres |= (sphere.Component.m_Velocity != glm::vec3(0.0f));
+      }
+   }
+
+   const float shutterTime = m_HasMovingSpheres ? options.ShutterTime : 0.0f;
+   const BVHBuildQuality quality = scene.GetBVHBuildQuality();
+   const bool rebuildSphereBVH = spheresChanged || (m_Snapshot == nullptr) || (shutterTime != m_Snapshot->ShutterTime) ||
+                                 (quality != m_SphereBVHQuality) || (options.WideBVH != m_SphereBVHWide);
+   if (not changed && not rebuildSphereBVH)
+   {
+      return m_Snapshot;
+   }
+
+   std::shared_ptr<RenderScene> snapshot = std::make_shared<RenderScene>();
+   snapshot->HasMovingSpheres = m_HasMovingSpheres;
+   snapshot->ShutterTime = shutterTime;
+   snapshot->SceneID = m_SceneID;
+   snapshot->Version = ++m_Version;
+
+   if (rebuildSphereBVH)
+   {
+      BuildSphereBVH(*snapshot, quality, options.WideBVH);
+   }
+   else
+   {
+      snapshot->SphereBVH = m_Snapshot->SphereBVH;
+      snapshot->SphereWideBVH = m_Snapshot->SphereWideBVH;
+   }
+
+   // Primitives sharing a material share its copy
+   std::unordered_map<const Material*, uint32_t> materialIndices;
+   auto getMaterialIndex = [&](const Material* material)
+   {
+      if (material == nullptr)
+      {
+         return RenderScene::NoMaterial;
+      }
+
+      auto [it, inserted] = materialIndices.try_emplace(material, (uint32_t)snapshot->Materials.size());
+      if (inserted)
+      {
+         snapshot->Materials.push_back(*material);
+      }
+      return it->second;
+   };
+
+   snapshot->Spheres.reserve(m_SphereOrder.size());
+   snapshot->SphereIDs.reserve(m_SphereOrder.size());
+   for (uint32_t slot : m_SphereOrder)
+   {
+      const auto& sphere = m_Spheres[slot];
+      snapshot->Spheres.push_back({ sphere.Component.m_Position, sphere.Component.m_Radius, sphere.Component.m_Velocity, getMaterialIndex(sphere.SourceMaterial) });
+      snapshot->SphereIDs.push_back(sphere.ID);
+   }
+
+   snapshot->Meshes.reserve(m_Meshes.size());
+   snapshot->MeshIDs.reserve(m_Meshes.size());
+   for (const auto& mesh : m_Meshes)
+   {
+      const Mesh* source = scene.GetMesh(mesh.Component.m_Mesh);
+      if (source != nullptr)
+      {
+         snapshot->Meshes.push_back({ source, getMaterialIndex(mesh.SourceMaterial) });
+         snapshot->MeshIDs.push_back(mesh.ID);
+      }
+   }
+
+   m_Snapshot = snapshot;
+   return m_Snapshot;
+}
+
+void RenderSceneBuilder::BuildSphereBVH(RenderScene& snapshot, BVHBuildQuality quality, bool wideBVH)
+{
+   std::vector<AABB> sphereBounds(m_Spheres.size());
+   for (size_t i = 0; i < m_Spheres.size(); i++)
+   {
+      const SphereComponent& sphere = m_Spheres[i].Component;
+      const glm::vec3 extent(sphere.m_Radius);
+
+      // With motion blur the box has to cover the whole path of the sphere while the shutter is open
+      sphereBounds[i].Grow(AABB(sphere.m_Position - extent, sphere.m_Position + extent));
+      if (snapshot.ShutterTime > 0.0f)
+      {
+         glm::vec3 endPosition = sphere.m_Position + sphere.m_Velocity * snapshot.ShutterTime;
+         sphereBounds[i].Grow(AABB(endPosition - extent, endPosition + extent));
+      }
+   }
+
+   BVHBuildSettings settings;
+   settings.Quality = quality;
+   std::vector<BVHNode> nodes = BVHBuilder::Build(sphereBounds, m_SphereOrder, settings);
+
+   // Like meshes, only one layout is kept
+   if (wideBVH)
+   {
+      snapshot.SphereWideBVH = WideBVHBuilder::Collapse(nodes.data(), (uint32_t)nodes.size());
+   }
+   else
+   {
+      snapshot.SphereBVH = std::move(nodes);
+   }
+
+   m_SphereBVHQuality = quality;
+   m_SphereBVHWide = wideBVH;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include "Acceleration/AABB.h"
+#include "Acceleration/BVH.h"
+#include "Acceleration/BVHNode.h"
+#include "Acceleration/WideBVHNode.h"
+#include "Scene/Scene.h"
+#include "Scene/Entity.h"
+#include "Scene/Components.h"
+#include "UUID.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Everything the tracer reads, compiled from a Scene so rendering never touches the live registry or the Material objects
+// the UI edits. Immutable once built, a changed scene gets a new snapshot (see RenderSceneBuilder).
+// Meshes still point at the buffers the Scene owns. Those never change after creation, but the Scene has to outlive the
+// frames traced with its snapshots
+struct RenderScene
+{
+   static constexpr uint32_t NoMaterial = UINT32_MAX;
+
+   struct Sphere
+   {
+      glm::vec3 Position;
+      float Radius;
+      glm::vec3 Velocity; // Units per second
+      uint32_t MaterialIndex;
+   };
+
+   struct MeshInstance
+   {
+      const ::Mesh* Mesh;
+      uint32_t MaterialIndex;
+   };
+
+   // Spheres are in the leaf order of the sphere BVH, the IDs run parallel to the primitives
+   std::vector<Sphere> Spheres;
+   std::vector<UUID> SphereIDs;
+   std::vector<MeshInstance> Meshes;
+   std::vector<UUID> MeshIDs;
+   // Copies of the materials the primitives use
+   std::vector<Material> Materials;
+
+   // Only one of the two is built, the wide one when built with the wide layout
+   std::vector<BVHNode> SphereBVH;
+   std::vector<WideBVHNode> SphereWideBVH;
+   bool HasMovingSpheres = false;
+   // The sphere bounds cover the motion over this long, 0 without motion blur
+   float ShutterTime = 0.0f;
+
+   uint64_t SceneID = 0; // Scene::GetInstanceID of the source
+   uint64_t Version = 0; // Counts up with every snapshot a builder publishes
+
+   bool IsEmpty() const { return Spheres.empty() && Meshes.empty(); }
+   // Of what the image depends on: the geometry and materials of the primitives, in any order. Snapshots of scenes with the
+   // same contents hash the same, whatever their IDs, versions or BVH layouts
+   uint64_t GetContentHash() const;
+
+   // World bounds of a primitive, a sphere's include its motion over ShutterTime
+   AABB GetSphereBounds(uint32_t index) const;
+   AABB GetMeshBounds(uint32_t index) const;
+
+   // Collects the entities whose primitive differs between two snapshots of the same scene, in its geometry or the values
+   // of its material, and the bounds of the primitive in each snapshot it is part of. Returns true when a light was added,
+   // removed, moved or edited, which changes the lighting of the whole image
+   static bool Diff(const RenderScene& previous, const RenderScene& current, std::vector<UUID>& changedIDs, std::vector<AABB>& changedBounds);
+};
+
+// Keeps packed copies of the components of a scene up to date through Scene::ConsumeChanges, only the entities that changed
+// are repacked. A new RenderScene is compiled when they, or the options, changed
+class RenderSceneBuilder
+{
+public:
+   struct Options
+   {
+      // Of the camera. Ignored (0) while no sphere moves
+      float ShutterTime = 0.0f;
+      bool WideBVH = true;
+   };
+
+   // Returns the previous snapshot when nothing changed. Everything is packed again when called with a different scene
+   std::shared_ptr<const RenderScene> Update(Scene& scene, const Options& options);
+
+private:
+   // Copies of the components of all entities that have T and an ID, in no particular order. A removed entity's slot is
+   // filled with the last element, so the arrays stay dense
+   template<typename T>
+   class PackedComponents
+   {
+   public:
+      struct Item
+      {
+         T Component;
+         UUID ID;
+         const Material* SourceMaterial; // nullptr without a (valid) MaterialComponent. Pool addresses are stable
+      };
+
+      // Returns false when the entity neither has nor had the component
+      bool Update(Scene& scene, entt::entity handle)
+      {
+         Entity entity = { handle, &scene };
+         auto slot = m_Slots.find(handle);
+         if (entity.HasComponent<T>() && entity.HasComponent<IDComponent>())
+         {
+            Item item = { entity.GetComponent<T>(), entity.GetComponent<IDComponent>().m_UUID, nullptr };
+            if (entity.HasComponent<MaterialComponent>())
+            {
+               item.SourceMaterial = scene.GetMaterial(entity.GetComponent<MaterialComponent>().m_Material);
+            }
+
+            if (slot == m_Slots.end())
+            {
+               m_Slots[handle] = (uint32_t)m_Items.size();
+               m_Items.push_back(item);
+               m_Entities.push_back(handle);
+            }
+            else
+            {
+               m_Items[slot->second] = item;
+            }
+            return true;
+         }
+
+         if (slot == m_Slots.end())
+         {
+            return false;
+         }
+
+         uint32_t index = slot->second;
+         m_Items[index] = m_Items.back();
+         m_Entities[index] = m_Entities.back();
+         m_Slots[m_Entities[index]] = index;
+         m_Slots.erase(handle);
+         m_Items.pop_back();
+         m_Entities.pop_back();
+         return true;
+      }
+
+      void Clear()
+      {
+         m_Items.clear();
+         m_Entities.clear();
+         m_Slots.clear();
+      }
+
+      const Item& operator[](size_t index) const { return m_Items[index]; }
+      size_t size() const { return m_Items.size(); }
+      auto begin() const { return m_Items.begin(); }
+      auto end() const { return m_Items.end(); }
+   private:
+      std::vector<Item> m_Items;
+      std::vector<entt::entity> m_Entities;
+      std::unordered_map<entt::entity, uint32_t> m_Slots;
+   };
+
+   // Builds the sphere BVH over the packed spheres, m_SphereOrder maps its leaf order to their slots
+   void BuildSphereBVH(RenderScene& snapshot, BVHBuildQuality quality, bool wideBVH);
+
+   uint64_t m_SceneID = 0;
+   PackedComponents<SphereComponent> m_Spheres;
+   PackedComponents<MeshComponent> m_Meshes;
+   bool m_HasMovingSpheres = false;
+
+   std::shared_ptr<const RenderScene> m_Snapshot;
+   uint64_t m_Version = 0;
+   // Slots of the packed spheres in the leaf order of the snapshot's BVH, valid until a sphere changes
+   std::vector<uint32_t> m_SphereOrder;
+   BVHBuildQuality m_SphereBVHQuality = BVHBuildQuality::HighQuality;
+   bool m_SphereBVHWide = false;
+};
@@ -1,14 +1,49 @@
 #include "Renderer.h"
 
+#include "Acceleration/BVH.h"
+#include "Acceleration/WideBVH.h"
 #include "AppRandom.h"
+#include "Hasher.h"
+#include "MappedFile.h"
+#include "Profiler.h"
 #include "RayTracingHelper.h"
 
+#include <cstring>
 #include <execution>
+#include <filesystem>
+#include <fstream>
+#include <unordered_set>
+#include <utility>
+
+#include "glm/gtc/constants.hpp"
+
+#include "Walnut/Timer.h"
 
 #include "Scene/Scene.h"
 #include "Scene/Components.h"
 #include "Scene/Entity.h"
 
+namespace
+{
+   constexpr char s_CheckpointMagic[4] = { 'R', 'T', 'C', 'P' };
+   constexpr uint32_t s_CheckpointFileVersion = 1;
+
+   struct CheckpointHeader
+   {
+      char Magic[4];
+      uint32_t FileVersion;
+      uint64_t RenderHash;  // Of the scene, camera and settings the samples were taken with
+      uint64_t PayloadHash; // Of the accumulation data, catches truncated or damaged files
+      uint64_t FileSize;
+      uint32_t Width, Height;
+      uint32_t Format;      // AccumulationFormat
+      uint32_t FrameIndex;  // Of the next frame
+      uint64_t DataOffset;
+      uint64_t Reserved;
+   };
+   static_assert(sizeof(CheckpointHeader) == 64);
+}
+
 namespace Utils
 {
    static uint32_t ConvertToRGBA(const glm::vec4& color)
@@ -21,30 +56,81 @@ namespace Utils
       uint32_t result = ((a << 24) | (b << 16) | (g << 8) | (r << 0));
       return result;
    }
-}
 
-void Renderer::Resize(uint32_t width, uint32_t height)
-{
-   if (m_FinalImage != nullptr)
+   // 1D filter profiles, evaluated separably. x is the distance to the pixel center in pixels
+   static float EvaluateFilter(ReconstructionFilter filter, float x, float radius)
    {
-      if (m_FinalImage->GetWidth() == width && m_FinalImage->GetHeight() == height)
+      x = glm::abs(x);
+      if (x > radius)
       {
-         return;
+         return 0.0f;
       }
 
-      m_FinalImage->Resize(width, height);
+      switch (filter)
+      {
+      case ReconstructionFilter::Tent:
+         return radius - x;
+      case ReconstructionFilter::BlackmanHarris:
+      {
+         // 4-term Blackman-Harris window stretched over [-radius, radius]
+         const float a0 = 0.35875f, a1 = 0.48829f, a2 = 0.14128f, a3 = 0.01168f;
+         float t = glm::two_pi<float>() * (0.5f + 0.5f * x / radius);
+         return a0 - a1 * glm::cos(t) + a2 * glm::cos(2.0f * t) - a3 * glm::cos(3.0f * t);
+      }
+      case ReconstructionFilter::Box:
+      default:
+         return 1.0f;
+      }
    }
-   else
+}
+
+glm::vec3 Renderer::GetHeatmapColor(float t)
+{
+   static const glm::vec3 stops[] =
    {
-      m_FinalImage = std::make_shared<Walnut::Image>(width, height, Walnut::ImageFormat::RGBA); // 4 bytes per pixel
+      { 0.0f, 0.0f, 0.5f },
+      { 0.0f, 0.4f, 1.0f },
+      { 0.0f, 0.9f, 0.6f },
+      { 0.9f, 0.9f, 0.0f },
+      { 1.0f, 0.3f, 0.0f },
+      { 0.8f, 0.0f, 0.0f },
+   };
+   constexpr uint32_t segments = (sizeof(stops) / sizeof(stops[0])) - 1;
+
+   float position = glm::clamp(t, 0.0f, 1.0f) * segments;
+   uint32_t segment = glm::min((uint32_t)position, segments - 1);
+   return glm::mix(stops[segment], stops[segment + 1], position - segment);
+}
+
+float Renderer::GetDefaultFilterRadius(ReconstructionFilter filter)
+{
+   switch (filter)
+   {
+   case ReconstructionFilter::Tent:           return 1.0f;
+   case ReconstructionFilter::BlackmanHarris: return 1.5f;
+   case ReconstructionFilter::Box:
+   default:                                   return 0.5f;
    }
+}
 
-   delete[] m_AccumulationData;
-   m_AccumulationData = new glm::vec4[width * height];
+void Renderer::Resize(uint32_t width, uint32_t height)
+{
+   if (m_ImageData.data() != nullptr && m_Width == width && m_Height == height)
+   {
+      return;
+   }
+
+   m_Width = width;
+   m_Height = height;
+
+   // Shrinking keeps the allocations, so resizing the viewport back and forth doesn't reallocate
+   m_Accumulation.Resize(width * height, m_Settings.Accumulation);
    m_FrameIndex = 1;
 
-   delete[] m_ImageData;
-   m_ImageData = new uint32_t[width * height];
+   m_ImageData.Resize(width * height);
+   m_DisplayAllChanged = true;
+
+   m_IDData.assign(width * height, 0);
 
    m_ImageHorizontalIter.resize(width);
    m_ImageVerticalIter.resize(height);
@@ -62,73 +148,98 @@ void Renderer::Resize(uint32_t width, uint32_t height)
 
 void Renderer::Render(Scene& scene, const Camera& camera)
 {
-   m_ActiveScene = &scene;
+   Walnut::Timer timer;
+
    m_ActiveCamera = &camera;
 
-   // Package the entities we need nicely in an array for easy access
+   // Pick the specialization once per frame
+   const Camera::Lens& lens = m_ActiveCamera->GetLens();
+   const bool thinLens = lens.IsThinLens();
+
+   if (m_Accumulation.GetFormat() != m_Settings.Accumulation)
    {
-      const auto& sphereView = m_ActiveScene->GetAllEntitiesWith<SphereComponent, IDComponent>();
-      m_SphereComponents.clear();
-      for (auto& entity : sphereView)
+      m_Accumulation.Resize(m_Width * m_Height, m_Settings.Accumulation);
+      m_FrameIndex = 1;
+   }
+
+   {
+      PROFILE_SCOPE(ProfileStage::ScenePacking);
+
+      RenderSceneBuilder::Options options;
+      options.ShutterTime = lens.ShutterTime;
+      options.WideBVH = m_Settings.WideBVH;
+      std::shared_ptr<const RenderScene> previousScene = std::move(m_FrameScene);
+      m_FrameScene = m_SceneBuilder.Update(scene, options);
+      m_RenderScene.store(m_FrameScene);
+
+      m_RenderRegion = { 0, 0, m_Width, m_Height };
+      if (previousScene != nullptr && previousScene != m_FrameScene)
       {
-         auto [sphere, id] = sphereView.get<SphereComponent, IDComponent>(entity);
-         m_SphereComponents.push_back(std::make_pair(sphere, id));
+         InvalidateChangedPixels(*previousScene, *m_FrameScene);
       }
+   }
+
+   const bool motionBlur = (lens.ShutterTime > 0.0f) && m_FrameScene->HasMovingSpheres;
+
+   m_FrameSeed = AppRandom::PCGHash(m_FrameIndex);
+
+   if (m_FrameIndex == 1)
+   {
+      m_Accumulation.Clear();
+   }
 
-      const auto& meshView = m_ActiveScene->GetAllEntitiesWith<MeshComponent, IDComponent>();
-      m_MeshComponents.clear();
-      for (auto& entity : meshView)
+   if (m_Settings.View != DebugView::None)
+   {
+      if (m_FrameIndex == 1 || m_CostData.empty())
       {
-         auto [mesh, id] = meshView.get<MeshComponent, IDComponent>(entity);
-         m_MeshComponents.push_back(std::make_pair(mesh, id));
+         m_CostData.assign(m_Width * m_Height, 0.0f);
       }
    }
+   else if (not m_CostData.empty())
+   {
+      m_CostData.clear();
+      m_CostData.shrink_to_fit();
+   }
 
-   if (m_FrameIndex == 1)
+   void (Renderer::*renderRow)(uint32_t) = &Renderer::RenderRow<false, false>;
+   if (thinLens && motionBlur)
    {
-      memset(m_AccumulationData, 0, m_FinalImage->GetWidth() * m_FinalImage->GetHeight() * sizeof(glm::vec4));
+      renderRow = &Renderer::RenderRow<true, true>;
+   }
+   else if (thinLens)
+   {
+      renderRow = &Renderer::RenderRow<true, false>;
+   }
+   else if (motionBlur)
+   {
+      renderRow = &Renderer::RenderRow<false, true>;
    }
 
 #define MT
 #if defined(MT)
-   std::for_each(std::execution::par, m_ImageVerticalIter.begin(), m_ImageVerticalIter.end(),
-      [this](uint32_t y) 
+   std::for_each(std::execution::par, m_ImageVerticalIter.begin() + m_RenderRegion.MinY, m_ImageVerticalIter.begin() + m_RenderRegion.MaxY,
+      [this, renderRow](uint32_t y) 
       {
-         for (uint32_t x = 0; x < m_FinalImage->GetWidth(); x++)
-         {
-            uint32_t imageDataIndex = x + (y * m_FinalImage->GetWidth());
-
-            glm::vec4 color = PerPixel(x, y);
-            m_AccumulationData[imageDataIndex] += color;
-
-            glm::vec4 accumulatedColor = m_AccumulationData[imageDataIndex];
-            accumulatedColor /= (float)m_FrameIndex;
-
-            // Write out the color
-            accumulatedColor = glm::clamp(accumulatedColor, glm::vec4(0.0f), glm::vec4(1.0f));
-            m_ImageData[imageDataIndex] = Utils::ConvertToRGBA(accumulatedColor);
-         }
+         (this->*renderRow)(y);
       });
 #else
-   for (uint32_t y = 0; y < m_FinalImage->GetHeight(); y++)
+   for (uint32_t y = m_RenderRegion.MinY; y < m_RenderRegion.MaxY; y++)
    {
-      for (uint32_t x = 0; x < m_FinalImage->GetWidth(); x++)
-      {
-         uint32_t imageDataIndex = x + (y * m_FinalImage->GetWidth());
+      (this->*renderRow)(y);
+   }
+#endif
 
-         glm::vec4 color = PerPixel(x, y);
-         m_AccumulationData[imageDataIndex] += color;
+   if (m_Settings.View != DebugView::None)
+   {
+      ResolveCostHeatmap();
+   }
 
-         glm::vec4 accumulatedColor = m_AccumulationData[imageDataIndex];
-         accumulatedColor /= (float)m_FrameIndex;
+   // Only the rendered region changed, unless the heatmap got rescaled
+   UpdateDisplay(m_RenderRegion, m_Settings.View != DebugView::None);
 
-         // Write out the color
-         accumulatedColor = glm::clamp(accumulatedColor, glm::vec4(0.0f), glm::vec4(1.0f));
-         m_ImageData[imageDataIndex] = Utils::ConvertToRGBA(accumulatedColor);
-      }
-   }
+#if RT_ENABLE_RAY_STATISTICS
+   m_RayStatistics = RayStatistics::Collect(timer.Elapsed());
 #endif
-   m_FinalImage->SetData(m_ImageData);
 
    if (m_Settings.Accumulate == true)
    {
@@ -140,13 +251,211 @@ void Renderer::Render(Scene& scene, const Camera& camera)
    }
 }
 
-glm::vec4 Renderer::PerPixel(uint32_t x, uint32_t y)
+void Renderer::StartAtFrame(uint32_t firstFrameIndex)
+{
+   if (m_Accumulation.GetFormat() != m_Settings.Accumulation)
+   {
+      m_Accumulation.Resize(m_Width * m_Height, m_Settings.Accumulation);
+   }
+   m_Accumulation.Clear();
+   m_FrameIndex = glm::max(firstFrameIndex, 1u);
+}
+
+void Renderer::AddSamples(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const glm::vec4* sums)
+{
+   for (uint32_t row = 0; row < height; row++)
+   {
+      for (uint32_t column = 0; column < width; column++)
+      {
+         const uint32_t imageDataIndex = (x + column) + (y + row) * m_Width;
+         uint32_t seed = AppRandom::PixelSeed((x + column) + (uint64_t)(y + row) * m_Width, m_FrameSeed);
+         m_Accumulation.AddSum(imageDataIndex, sums[column + row * width], seed);
+
+         glm::vec3 accumulatedColor = glm::clamp(m_Accumulation.GetColor(imageDataIndex), glm::vec3(0.0f), glm::vec3(1.0f));
+         m_ImageData[imageDataIndex] = Utils::ConvertToRGBA(glm::vec4(accumulatedColor, 1.0f));
+      }
+   }
+
+   // Merged results of the same pixels get other rounding offsets in the compact formats
+   m_FrameSeed = AppRandom::PCGHash(m_FrameSeed);
+
+   UpdateDisplay({ x, y, x + width, y + height }, false);
+}
+
+template<bool ThinLens, bool MotionBlur>
+void Renderer::RenderRow(uint32_t y)
+{
+   const uint32_t width = m_Width;
+   const bool jitter = m_Settings.Jitter;
+   const float filterRadius = glm::max(m_Settings.FilterRadius, 0.5f);
+
+   thread_local std::vector<uint32_t> rowSeeds;
+   thread_local std::vector<glm::vec2> rowOffsets;
+   thread_local std::vector<glm::vec3> rowDirections;
+
+   const glm::vec3* rayDirections = nullptr;
+   {
+      PROFILE_SCOPE(ProfileStage::RayGeneration);
+
+      // Seeded by the pixel's index in the whole image, a tile of a crop window renders the same samples as the full frame
+      const glm::uvec2 cropOffset = m_ActiveCamera->GetCropOffset();
+      const uint32_t imageWidth = m_ActiveCamera->GetImageSize().x;
+      const uint64_t rowStart = cropOffset.x + (uint64_t)(y + cropOffset.y) * imageWidth;
+      rowSeeds.resize(width);
+      for (uint32_t x = 0; x < width; x++)
+      {
+         rowSeeds[x] = AppRandom::PixelSeed(rowStart + x, m_FrameSeed);
+      }
+
+      if (jitter)
+      {
+         // Spread the samples over the filter footprint around the pixel center
+         rowOffsets.resize(width);
+         for (uint32_t x = 0; x < width; x++)
+         {
+            rowOffsets[x] = glm::vec2(0.5f) + (AppRandom::Vec2(rowSeeds[x]) * 2.0f - 1.0f) * filterRadius;
+         }
+
+         rowDirections.resize(width);
+         m_ActiveCamera->GenerateRayDirections(y, rowDirections.data(), rowOffsets.data());
+         rayDirections = rowDirections.data();
+      }
+      else if (m_ActiveCamera->GetRayGenerationMode() == RayGenerationMode::Cached)
+      {
+         // Either read the cached directions of this row, or derive them from the camera basis (SIMD across the row)
+         rayDirections = m_ActiveCamera->GetRayDirections().data() + (y * width);
+      }
+      else
+      {
+         rowDirections.resize(width);
+         m_ActiveCamera->GenerateRayDirections(y, rowDirections.data());
+         rayDirections = rowDirections.data();
+      }
+   }
+
+   {
+      PROFILE_SCOPE(ProfileStage::Trace);
+
+      const DebugView view = m_Settings.View;
+      for (uint32_t x = m_RenderRegion.MinX; x < m_RenderRegion.MaxX; x++)
+      {
+         uint32_t imageDataIndex = x + (y * width);
+
+         float weight = 1.0f;
+         if (jitter)
+         {
+            glm::vec2 fromCenter = rowOffsets[x] - glm::vec2(0.5f);
+            weight = Utils::EvaluateFilter(m_Settings.Filter, fromCenter.x, filterRadius) *
+                     Utils::EvaluateFilter(m_Settings.Filter, fromCenter.y, filterRadius);
+         }
+
+         uint64_t costStart = 0;
+         if (view == DebugView::CostTime)
+         {
+            costStart = Profiler::Now();
+         }
+#if RT_ENABLE_RAY_STATISTICS
+         else if (view == DebugView::CostTests)
+         {
+            const RayCounters& counters = RayStatistics::GetThreadCounters();
+            costStart = counters.SphereTests + counters.TriangleTests + counters.NodeTests;
+         }
+#endif
+
+         glm::vec4 color = PerPixel<ThinLens, MotionBlur>(rayDirections[x], rowSeeds[x], m_IDData[imageDataIndex]);
+         m_Accumulation.Add(imageDataIndex, glm::vec3(color), weight, rowSeeds[x]);
+
+         if (view == DebugView::CostTime)
+         {
+            m_CostData[imageDataIndex] += (float)(Profiler::Now() - costStart);
+         }
+#if RT_ENABLE_RAY_STATISTICS
+         else if (view == DebugView::CostTests)
+         {
+            const RayCounters& counters = RayStatistics::GetThreadCounters();
+            m_CostData[imageDataIndex] += (float)(counters.SphereTests + counters.TriangleTests + counters.NodeTests - costStart);
+         }
+#endif
+      }
+   }
+
+   // The heatmap is resolved for the whole image at once, as it needs the min/max of all pixels
+   if (m_Settings.View != DebugView::None)
+   {
+      return;
+   }
+
+   PROFILE_SCOPE(ProfileStage::Resolve);
+   for (uint32_t x = 0; x < width; x++)
+   {
+      uint32_t imageDataIndex = x + (y * width);
+
+      glm::vec3 accumulatedColor = m_Accumulation.GetColor(imageDataIndex);
+
+      // Write out the color
+      accumulatedColor = glm::clamp(accumulatedColor, glm::vec3(0.0f), glm::vec3(1.0f));
+      m_ImageData[imageDataIndex] = Utils::ConvertToRGBA(glm::vec4(accumulatedColor, 1.0f));
+   }
+}
+
+void Renderer::ResolveCostHeatmap()
+{
+   PROFILE_SCOPE(ProfileStage::Resolve);
+
+   const uint32_t width = m_Width;
+   const float invFrameCount = 1.0f / (float)m_FrameIndex;
+
+   float minCost = FLT_MAX;
+   float maxCost = 0.0f;
+   for (float cost : m_CostData)
+   {
+      minCost = glm::min(minCost, cost);
+      maxCost = glm::max(maxCost, cost);
+   }
+   m_CostRange = glm::vec2(minCost, maxCost) * invFrameCount;
+
+   const float range = glm::max(maxCost - minCost, 1e-6f);
+   std::for_each(std::execution::par, m_ImageVerticalIter.begin(), m_ImageVerticalIter.end(),
+      [this, width, minCost, range](uint32_t y)
+      {
+         for (uint32_t x = 0; x < width; x++)
+         {
+            uint32_t imageDataIndex = x + (y * width);
+            glm::vec3 color = GetHeatmapColor((m_CostData[imageDataIndex] - minCost) / range);
+            m_ImageData[imageDataIndex] = Utils::ConvertToRGBA(glm::vec4(color, 1.0f));
+         }
+      });
+}
+
+template<bool ThinLens, bool MotionBlur>
+glm::vec4 Renderer::PerPixel(const glm::vec3& rayDirection, uint32_t& seed, uint64_t& primaryHitUUID)
 {
-   uint32_t imageDataIndex = x + (y * m_FinalImage->GetWidth());
-   
    Ray ray;
    ray.Origin = m_ActiveCamera->GetPosition();
-   ray.Direction = m_ActiveCamera->GetRayDirections()[imageDataIndex];
+   ray.Direction = rayDirection;
+
+   if constexpr (ThinLens)
+   {
+      const Camera::RayBasis& basis = m_ActiveCamera->GetRayBasis();
+      const Camera::Lens& lens = m_ActiveCamera->GetLens();
+
+      // Every ray through this pixel converges on the same point of the focal plane
+      glm::vec3 focalPoint = ray.Origin + ray.Direction * (lens.FocusDistance / glm::dot(ray.Direction, basis.Forward));
+
+      // Uniform sample on the lens disk
+      glm::vec2 u = AppRandom::Vec2(seed);
+      float r = 0.5f * lens.Aperture * glm::sqrt(u.x);
+      float phi = glm::two_pi<float>() * u.y;
+
+      ray.Origin += basis.Right * (r * glm::cos(phi)) + basis.Up * (r * glm::sin(phi));
+      ray.Direction = glm::normalize(focalPoint - ray.Origin);
+   }
+
+   if constexpr (MotionBlur)
+   {
+      // One shutter time per camera sample, kept by every bounce of the path
+      ray.Time = AppRandom::Float(seed) * m_ActiveCamera->GetLens().ShutterTime;
+   }
    
    glm::vec3 contribution { 1.0f };
    glm::vec3 accumulatedLight{ 0.0f };
@@ -154,124 +463,585 @@ glm::vec4 Renderer::PerPixel(uint32_t x, uint32_t y)
    uint32_t numBounces = 5;
    for (uint32_t i = 0; i < numBounces; i++)
    {
-      HitPayload payload = TraceRay(ray);
+      HitPayload payload;
+      {
+         PROFILE_HOT_SCOPE(ProfileStage::Traversal);
+         payload = TraceRay<MotionBlur>(ray);
+      }
+
+      if (i == 0)
+      {
+         RAY_STATS_ADD(PrimaryRays, 1);
+         primaryHitUUID = payload.EntityUUID;
+      }
+      else
+      {
+         RAY_STATS_ADD(SecondaryRays, 1);
+      }
    
+      // A missed ray would miss again with the same origin and direction, so the path ends here
       if ((payload.HitDistance < 0) || (payload.EntityUUID == 0))
       {
-         continue;
+         RAY_STATS_ADD(Misses, 1);
+         break;
       }
-   
-      Entity entity = m_ActiveScene->GetEntityByUUID(payload.EntityUUID);
-      if (entity.HasComponent<MaterialComponent>())
+
+      PROFILE_HOT_SCOPE(ProfileStage::Shading);
+      if (payload.MaterialIndex != RenderScene::NoMaterial)
       {
-         const MaterialComponent& materialComponent = entity.GetComponent<MaterialComponent>();
-   
-         Material& mat = *materialComponent.m_Material;
+         const Material& mat = m_FrameScene->Materials[payload.MaterialIndex];
    
          accumulatedLight += (mat.m_Albedo * contribution);
          contribution *= mat.m_Albedo;
          accumulatedLight += (mat.GetEmission());
       }
    
-      // Prepare for next iteration
+      // Prepare for next iteration (the shutter time is kept)
       ray.Origin = payload.WorldPos + (payload.WorldNorm * 0.001f);
-      ray.Direction = glm::normalize(payload.WorldNorm + AppRandom::InUnitSphere());
+      ray.Direction = glm::normalize(payload.WorldNorm + AppRandom::InUnitSphere(seed));
    }
    accumulatedLight /= numBounces;
    
    return glm::vec4(accumulatedLight, 1.0f);
 }
 
-Renderer::HitPayload Renderer::TraceRay(const Ray& ray)
+uint64_t Renderer::GetEntityAt(uint32_t x, uint32_t y) const
 {
-   HitPayload payload;
-   payload.EntityUUID = 0;
-   payload.HitDistance = -1;
-   if (m_SphereComponents.empty() && m_MeshComponents.empty())
+   if (x >= m_Width || y >= m_Height)
    {
-      return payload;
+      return 0;
+   }
+   return m_IDData[x + (y * m_Width)];
+}
+
+std::vector<Renderer::PixelRegion> Renderer::ConsumeDisplayChanges(bool& allChanged)
+{
+   allChanged = m_DisplayAllChanged;
+   m_DisplayAllChanged = false;
+   return std::exchange(m_DisplayChanges, {});
+}
+
+void Renderer::UpdateDisplay(const PixelRegion& region, bool allChanged)
+{
+   if (m_Headless)
+   {
+      return;
    }
 
-   float closestIntersectionHit = FLT_MAX;
+   // Another outlined entity changes pixels anywhere
+   if (m_OutlinedUUID != m_PresentedOutlineUUID)
+   {
+      allChanged = true;
+   }
+   m_PresentedOutlineUUID = m_OutlinedUUID;
+   if (m_OutlinedUUID != 0)
+   {
+      DrawOutline();
+   }
 
-   for (auto[sphereComponent, idComponent] : m_SphereComponents)
+   if (allChanged)
+   {
+      m_DisplayAllChanged = true;
+      m_DisplayChanges.clear();
+   }
+   else if (not m_DisplayAllChanged)
    {
-      float closestT = RayTracingHelper::RaySphereIntersection(ray, sphereComponent.m_Position, sphereComponent.m_Radius);
-      
-      if ((closestT < closestIntersectionHit) && (closestT >= 0.0f))
+      // The outline reaches beyond the pixels of the entity
+      const uint32_t margin = (m_OutlinedUUID != 0) ? s_OutlineThickness : 0;
+      m_DisplayChanges.push_back({ region.MinX - glm::min(region.MinX, margin), region.MinY - glm::min(region.MinY, margin),
+                                   glm::min(region.MaxX + margin, m_Width), glm::min(region.MaxY + margin, m_Height) });
+   }
+}
+
+void Renderer::DrawOutline()
+{
+   // Drawn around the outside of the entity's pixels, found in two separable passes over the ID buffer
+   const uint32_t outlineColor = Utils::ConvertToRGBA(glm::vec4(1.0f, 0.5f, 0.0f, 1.0f));
+
+   m_OutlineImageData.assign(m_ImageData.data(), m_ImageData.data() + (m_Width * m_Height));
+   m_OutlineMask.resize(m_Width * m_Height);
+
+   // Whether the entity is within the thickness horizontally
+   std::for_each(std::execution::par, m_ImageVerticalIter.begin(), m_ImageVerticalIter.end(),
+      [this](uint32_t y)
       {
-         closestIntersectionHit = closestT;
-         payload.EntityUUID = idComponent.m_UUID;
-      }
+         const uint64_t* ids = &m_IDData[y * m_Width];
+         for (uint32_t x = 0; x < m_Width; x++)
+         {
+            uint32_t begin = (x > s_OutlineThickness) ? x - s_OutlineThickness : 0;
+            uint32_t end = glm::min(x + s_OutlineThickness + 1, m_Width);
+
+            uint8_t covered = 0;
+            for (uint32_t i = begin; i < end && not covered; i++)
+            {
+               covered = (ids[i] == m_OutlinedUUID);
+            }
+            m_OutlineMask[x + (y * m_Width)] = covered;
+         }
+      });
+
+   // ... and vertically, on pixels showing something else
+   std::for_each(std::execution::par, m_ImageVerticalIter.begin(), m_ImageVerticalIter.end(),
+      [this, outlineColor](uint32_t y)
+      {
+         uint32_t begin = (y > s_OutlineThickness) ? y - s_OutlineThickness : 0;
+         uint32_t end = glm::min(y + s_OutlineThickness + 1, m_Height);
+         for (uint32_t x = 0; x < m_Width; x++)
+         {
+            uint32_t imageDataIndex = x + (y * m_Width);
+            if (m_IDData[imageDataIndex] == m_OutlinedUUID)
+            {
+               continue;
+            }
+
+            for (uint32_t i = begin; i < end; i++)
+            {
+               if (m_OutlineMask[x + (i * m_Width)])
+               {
+                  m_OutlineImageData[imageDataIndex] = outlineColor;
+                  break;
+               }
+            }
+         }
+      });
+}
+
+void Renderer::InvalidateChangedPixels(const RenderScene& previous, const RenderScene& current)
+{
+   // Everything gets rendered again anyway
+   if (m_FrameIndex == 1)
+   {
+      return;
    }
 
-   // Check if we hit anything with the "intersection shader"
-   if (closestIntersectionHit != FLT_MAX)
+   // The heatmap averages over the frame count and a thin lens blurs objects beyond their projected bounds, those start over
+   if (not m_Settings.DirtyRegions || not m_Settings.Accumulate || m_Settings.View != DebugView::None ||
+       m_ActiveCamera->GetLens().IsThinLens() || previous.SceneID != current.SceneID)
    {
-      payload = ReportIntersectionHit(closestIntersectionHit, ray, payload.EntityUUID);
+      ResetFrameIndex();
+      return;
    }
 
-   float closestTriangleHit = FLT_MAX;
-   for (auto [meshComponent, idComponent] : m_MeshComponents)
+   std::vector<UUID> changedIDs;
+   std::vector<AABB> changedBounds;
+   const bool changedLighting = RenderScene::Diff(previous, current, changedIDs, changedBounds);
+   if (changedIDs.empty())
    {
-      float closestT = RayTracingHelper::RayTriangleIntersection(ray, meshComponent.m_Mesh->m_Vertices);
-   
-      if ((closestT < closestTriangleHit) && (closestT >= 0.0f))
+      return;
+   }
+
+   // A changed light reaches pixels far beyond the ones it covers
+   if (changedLighting)
+   {
+      ResetFrameIndex();
+      return;
+   }
+
+   // A jittered sample lands up to the filter radius away from the pixel center
+   const uint32_t margin = m_Settings.Jitter ? (uint32_t)glm::ceil(m_Settings.FilterRadius) + 1 : 1;
+   std::vector<PixelRegion> regions;
+   for (const AABB& bounds : changedBounds)
+   {
+      PixelRegion region;
+      if (not bounds.IsValid())
+      {
+         continue;
+      }
+      if (not ProjectBounds(bounds, margin, region))
+      {
+         ResetFrameIndex();
+         return;
+      }
+      if (region.MinX < region.MaxX && region.MinY < region.MaxY)
       {
-         closestTriangleHit = closestT;
-         payload.EntityUUID = idComponent.m_UUID;
+         regions.push_back(region);
       }
    }
 
-   // Check if we hit anything with the "triangle-tracing shader"
-   if (closestTriangleHit != FLT_MAX)
+   // The ID buffer catches pixels of the entities the bounds might miss. Each row keeps the range of its reset pixels
+   std::unordered_set<uint64_t> ids(changedIDs.begin(), changedIDs.end());
+   std::vector<PixelRegion> rowRegions(m_Height);
+   std::for_each(std::execution::par, m_ImageVerticalIter.begin(), m_ImageVerticalIter.end(),
+      [this, &ids, &regions, &rowRegions](uint32_t y)
+      {
+         PixelRegion& rowRegion = rowRegions[y];
+         rowRegion = { m_Width, y, 0, y + 1 };
+         for (uint32_t x = 0; x < m_Width; x++)
+         {
+            uint32_t imageDataIndex = x + (y * m_Width);
+
+            bool changed = ids.contains(m_IDData[imageDataIndex]);
+            for (size_t i = 0; i < regions.size() && not changed; i++)
+            {
+               changed = (x >= regions[i].MinX && x < regions[i].MaxX && y >= regions[i].MinY && y < regions[i].MaxY);
+            }
+
+            if (changed)
+            {
+               m_Accumulation.Clear(imageDataIndex);
+               rowRegion.MinX = glm::min(rowRegion.MinX, x);
+               rowRegion.MaxX = x + 1;
+            }
+         }
+      });
+
+   PixelRegion renderRegion = { m_Width, m_Height, 0, 0 };
+   for (const PixelRegion& rowRegion : rowRegions)
    {
-      // Check whichever is closer, the intersectionGeometry or a triangle
-      if (closestTriangleHit < closestIntersectionHit)
+      if (rowRegion.MinX < rowRegion.MaxX)
       {
-         // We hit the triangle. Overwrite the payload with the triangle hit info
-         payload.HitDistance = closestTriangleHit;
+         renderRegion.MinX = glm::min(renderRegion.MinX, rowRegion.MinX);
+         renderRegion.MinY = glm::min(renderRegion.MinY, rowRegion.MinY);
+         renderRegion.MaxX = glm::max(renderRegion.MaxX, rowRegion.MaxX);
+         renderRegion.MaxY = glm::max(renderRegion.MaxY, rowRegion.MaxY);
+      }
+   }
 
-         // Calculate worldPos and normals;
-         payload.WorldPos = {};
-         payload.WorldNorm = {};
+   // Nothing visible changed, the frame renders the whole image as usual
+   if (renderRegion.MinX < renderRegion.MaxX)
+   {
+      m_RenderRegion = renderRegion;
+   }
+}
+
+bool Renderer::ProjectBounds(const AABB& bounds, uint32_t margin, PixelRegion& region) const
+{
+   const Camera::RayBasis& basis = m_ActiveCamera->GetRayBasis();
+   const glm::vec3 origin = m_ActiveCamera->GetPosition();
+   const float planeDepth = glm::dot(basis.BottomLeft, basis.Forward);
+
+   glm::vec2 min(FLT_MAX), max(-FLT_MAX);
+   for (uint32_t corner = 0; corner < 8; corner++)
+   {
+      glm::vec3 point((corner & 1) ? bounds.m_Max.x : bounds.m_Min.x,
+                      (corner & 2) ? bounds.m_Max.y : bounds.m_Min.y,
+                      (corner & 4) ? bounds.m_Max.z : bounds.m_Min.z);
+
+      glm::vec3 toPoint = point - origin;
+      float depth = glm::dot(toPoint, basis.Forward);
+      if (depth <= 1e-4f)
+      {
+         return false;
       }
+
+      // Where the ray through the point crosses the image plane of the ray basis, in pixels (see Camera::RayBasis)
+      glm::vec3 onPlane = toPoint * (planeDepth / depth) - basis.BottomLeft;
+      glm::vec2 pixel(glm::dot(onPlane, basis.PixelRight) / glm::dot(basis.PixelRight, basis.PixelRight),
+                      glm::dot(onPlane, basis.PixelUp) / glm::dot(basis.PixelUp, basis.PixelUp));
+      min = glm::min(min, pixel);
+      max = glm::max(max, pixel);
    }
 
-   // No hit
-   if (payload.HitDistance == -1)
+   // The basis spans the whole image, the viewport may be a crop window of it
+   const glm::vec2 cropOffset = glm::vec2(m_ActiveCamera->GetCropOffset());
+   min -= cropOffset;
+   max -= cropOffset;
+
+   region.MinX = (uint32_t)glm::clamp(glm::floor(min.x) - (float)margin, 0.0f, (float)m_Width);
+   region.MinY = (uint32_t)glm::clamp(glm::floor(min.y) - (float)margin, 0.0f, (float)m_Height);
+   region.MaxX = (uint32_t)glm::clamp(glm::ceil(max.x) + (float)margin, 0.0f, (float)m_Width);
+   region.MaxY = (uint32_t)glm::clamp(glm::ceil(max.y) + (float)margin, 0.0f, (float)m_Height);
+   return true;
+}
+
+uint64_t Renderer::GetBVHMemory() const
+{
+   std::shared_ptr<const RenderScene> scene = m_RenderScene.load();
+   if (scene == nullptr)
+   {
+      return 0;
+   }
+
+   // Every BVH has only one of the two layouts
+   uint64_t bytes = scene->SphereWideBVH.size() * sizeof(WideBVHNode) + scene->SphereBVH.size() * sizeof(BVHNode);
+   for (const RenderScene::MeshInstance& instance : scene->Meshes)
+   {
+      const Mesh& mesh = *instance.Mesh;
+      bytes += (uint64_t)mesh.m_WideBVHNodeCount * sizeof(WideBVHNode) + (uint64_t)mesh.m_BVHNodeCount * sizeof(BVHNode);
+   }
+   return bytes;
+}
+
+uint64_t Renderer::GetCheckpointHash(const RenderScene& scene, const Camera& camera) const
+{
+   Hasher hasher;
+   hasher.Add(scene.GetContentHash());
+
+   // The ray basis covers the orientation, field of view and image size of the camera
+   hasher.Add(camera.GetPosition());
+   hasher.Add(camera.GetRayBasis());
+   hasher.Add(camera.GetLens());
+   hasher.Add(camera.GetCropOffset());
+
+   hasher.Add(m_Settings.Jitter);
+   hasher.Add(m_Settings.Filter);
+   hasher.Add(m_Settings.FilterRadius);
+   hasher.Add(m_Settings.Accumulation);
+   hasher.Add(m_Width);
+   hasher.Add(m_Height);
+   return hasher.Get();
+}
+
+bool Renderer::SaveCheckpoint(const std::string& filepath) const
+{
+   if (m_FrameScene == nullptr || m_ActiveCamera == nullptr || m_Accumulation.GetPixelCount() != m_Width * m_Height)
+   {
+      return false;
+   }
+
+   CheckpointHeader header = {};
+   memcpy(header.Magic, s_CheckpointMagic, sizeof(s_CheckpointMagic));
+   header.FileVersion = s_CheckpointFileVersion;
+   header.RenderHash = GetCheckpointHash(*m_FrameScene, *m_ActiveCamera);
+   header.Width = m_Width;
+   header.Height = m_Height;
+   header.Format = (uint32_t)m_Accumulation.GetFormat();
+   header.FrameIndex = m_FrameIndex;
+   header.DataOffset = sizeof(CheckpointHeader);
+
+   // Written straight from the buffers, without a copy of them
+   const std::vector<std::span<const uint8_t>> buffers = m_Accumulation.GetRawData();
+   Hasher payloadHasher;
+   header.FileSize = header.DataOffset;
+   for (std::span<const uint8_t> buffer : buffers)
+   {
+      payloadHasher.Add(buffer.data(), buffer.size());
+      header.FileSize += buffer.size();
+   }
+   header.PayloadHash = payloadHasher.Get();
+
+   // Written under a temporary name and renamed, a crash while saving keeps the previous checkpoint
+   const std::string temporaryFilepath = filepath + ".tmp";
+   {
+      std::ofstream file(temporaryFilepath, std::ios::binary);
+      file.write((const char*)&header, sizeof(header));
+      for (std::span<const uint8_t> buffer : buffers)
+      {
+         file.write((const char*)buffer.data(), buffer.size());
+      }
+      if (not file.good())
+      {
+         return false;
+      }
+   }
+
+   std::error_code error;
+   std::filesystem::rename(temporaryFilepath, filepath, error);
+   if (error)
+   {
+      std::filesystem::remove(temporaryFilepath, error);
+      return false;
+   }
+   return true;
+}
+
+bool Renderer::LoadCheckpoint(const std::string& filepath, Scene& scene, const Camera& camera)
+{
+   std::shared_ptr<MappedFile> file = MappedFile::Open(filepath);
+   if (file == nullptr || m_Width == 0 || m_Height == 0)
+   {
+      return false;
+   }
+
+   const uint8_t* data = file->GetData();
+   const uint64_t fileSize = file->GetSize();
+   if (fileSize < sizeof(CheckpointHeader))
+   {
+      return false;
+   }
+
+   if (m_Accumulation.GetFormat() != m_Settings.Accumulation)
+   {
+      m_Accumulation.Resize(m_Width * m_Height, m_Settings.Accumulation);
+      m_FrameIndex = 1;
+   }
+
+   const CheckpointHeader& header = *(const CheckpointHeader*)data;
+   const std::vector<std::span<uint8_t>> buffers = m_Accumulation.GetRawData();
+   uint64_t dataSize = 0;
+   for (std::span<uint8_t> buffer : buffers)
+   {
+      dataSize += buffer.size();
+   }
+   if (memcmp(header.Magic, s_CheckpointMagic, sizeof(s_CheckpointMagic)) != 0 || header.FileVersion != s_CheckpointFileVersion ||
+       header.FileSize != fileSize || header.Width != m_Width || header.Height != m_Height ||
+       header.Format != (uint32_t)m_Settings.Accumulation || header.FrameIndex == 0 ||
+       header.DataOffset < sizeof(CheckpointHeader) || header.DataOffset > fileSize || dataSize != fileSize - header.DataOffset)
+   {
+      printf("'%s' is not a checkpoint of a %ux%u render in this accumulation format\n", filepath.c_str(), m_Width, m_Height);
+      return false;
+   }
+
+   // The snapshot the next frame starts from, so it doesn't count the scene as changed
+   RenderSceneBuilder::Options options;
+   options.ShutterTime = camera.GetLens().ShutterTime;
+   options.WideBVH = m_Settings.WideBVH;
+   m_FrameScene = m_SceneBuilder.Update(scene, options);
+   m_RenderScene.store(m_FrameScene);
+
+   if (header.RenderHash != GetCheckpointHash(*m_FrameScene, camera))
+   {
+      printf("Checkpoint '%s' was rendered from another scene, camera or settings\n", filepath.c_str());
+      return false;
+   }
+
+   // Hashed buffer by buffer, like when it was saved
+   Hasher payloadHasher;
+   const uint8_t* source = data + header.DataOffset;
+   for (std::span<uint8_t> buffer : buffers)
+   {
+      payloadHasher.Add(source, buffer.size());
+      source += buffer.size();
+   }
+   if (payloadHasher.Get() != header.PayloadHash)
+   {
+      printf("Checkpoint '%s' is damaged\n", filepath.c_str());
+      return false;
+   }
+
+   source = data + header.DataOffset;
+   for (std::span<uint8_t> buffer : buffers)
+   {
+      memcpy(buffer.data(), source, buffer.size());
+      source += buffer.size();
+   }
+   m_FrameIndex = header.FrameIndex;
+
+   const uint32_t width = m_Width;
+   std::for_each(std::execution::par, m_ImageVerticalIter.begin(), m_ImageVerticalIter.end(),
+      [this, width](uint32_t y)
+      {
+         for (uint32_t x = 0; x < width; x++)
+         {
+            uint32_t imageDataIndex = x + (y * width);
+            glm::vec3 accumulatedColor = glm::clamp(m_Accumulation.GetColor(imageDataIndex), glm::vec3(0.0f), glm::vec3(1.0f));
+            m_ImageData[imageDataIndex] = Utils::ConvertToRGBA(glm::vec4(accumulatedColor, 1.0f));
+         }
+      });
+   UpdateDisplay({}, true);
+   return true;
+}
+
+template<bool MotionBlur>
+Renderer::HitPayload Renderer::TraceRay(const Ray& ray)
+{
+   const RenderScene& scene = *m_FrameScene;
+   if (scene.IsEmpty())
    {
       return Miss(ray);
    }
 
-   return payload;
+   const glm::vec3 invDirection = 1.0f / ray.Direction;
+
+   // Spheres and meshes share closestT, so every traversal skips what is behind the closest hit so far
+   float closestT = FLT_MAX;
+   uint64_t sphereTests = 0, triangleTests = 0, nodeTests = 0;
+
+   // Both layouts hold the primitives in the same order, only the traversal differs
+   auto traverse = [&](const BVHNode* nodes, uint32_t nodeCount, const WideBVHNode* wideNodes, uint32_t wideNodeCount, auto&& intersectPrimitive)
+   {
+      // Whichever layout the BVH was built with, meshes keep the one the scene had when they were created
+      if (wideNodeCount > 0)
+      {
+         return TraverseWideBVH(wideNodes, wideNodeCount, ray, invDirection, closestT, intersectPrimitive);
+      }
+      return TraverseBVH(nodes, nodeCount, ray, invDirection, closestT, intersectPrimitive);
+   };
+
+   uint32_t closestSphere = UINT32_MAX;
+   glm::vec3 closestSpherePosition = {};
+   nodeTests += traverse(scene.SphereBVH.data(), (uint32_t)scene.SphereBVH.size(), scene.SphereWideBVH.data(), (uint32_t)scene.SphereWideBVH.size(), [&](uint32_t sphereIndex)
+   {
+      const RenderScene::Sphere& sphere = scene.Spheres[sphereIndex];
+      glm::vec3 spherePosition = sphere.Position;
+      if constexpr (MotionBlur)
+      {
+         spherePosition += sphere.Velocity * ray.Time;
+      }
+
+      sphereTests++;
+      float t = RayTracingHelper::RaySphereIntersection(ray, spherePosition, sphere.Radius);
+      if ((t < closestT) && (t >= 0.0f))
+      {
+         closestT = t;
+         closestSphere = sphereIndex;
+         closestSpherePosition = spherePosition;
+      }
+   });
+
+   // Meshes are few, they're looped over and each one traverses its own BVH
+   uint32_t closestMesh = UINT32_MAX;
+   uint32_t closestTriangle = 0;
+   for (uint32_t meshIndex = 0; meshIndex < (uint32_t)scene.Meshes.size(); meshIndex++)
+   {
+      const Mesh& mesh = *scene.Meshes[meshIndex].Mesh;
+      nodeTests += traverse(mesh.m_BVHNodes, mesh.m_BVHNodeCount, mesh.m_WideBVHNodes, mesh.m_WideBVHNodeCount, [&](uint32_t triangleIndex)
+      {
+         const uint32_t* indices = &mesh.m_Indices[triangleIndex * 3];
+
+         triangleTests++;
+         float t = RayTracingHelper::RayTriangleIntersection(ray, mesh.m_Vertices[indices[0]].m_Position, mesh.m_Vertices[indices[1]].m_Position, mesh.m_Vertices[indices[2]].m_Position);
+         if ((t < closestT) && (t >= 0.0f))
+         {
+            closestT = t;
+            closestMesh = meshIndex;
+            closestTriangle = triangleIndex;
+         }
+      });
+   }
+
+   RAY_STATS_ADD(SphereTests, sphereTests);
+   RAY_STATS_ADD(TriangleTests, triangleTests);
+   RAY_STATS_ADD(NodeTests, nodeTests);
+
+   // A triangle hit replaces any sphere hit, as it was only accepted when closer
+   if (closestMesh != UINT32_MAX)
+   {
+      const Mesh& mesh = *scene.Meshes[closestMesh].Mesh;
+      const uint32_t* indices = &mesh.m_Indices[closestTriangle * 3];
+      const glm::vec3& p0 = mesh.m_Vertices[indices[0]].m_Position;
+      const glm::vec3& p1 = mesh.m_Vertices[indices[1]].m_Position;
+      const glm::vec3& p2 = mesh.m_Vertices[indices[2]].m_Position;
+
+      HitPayload payload;
+      payload.HitDistance = closestT;
+      payload.EntityUUID = scene.MeshIDs[closestMesh];
+      payload.MaterialIndex = scene.Meshes[closestMesh].MaterialIndex;
+      payload.WorldPos = ray.Origin + ray.Direction * closestT;
+      payload.WorldNorm = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+      return payload;
+   }
+
+   // Check if we hit anything with the "intersection shader"
+   if (closestSphere != UINT32_MAX)
+   {
+      return ReportIntersectionHit(closestT, ray, scene.SphereIDs[closestSphere], scene.Spheres[closestSphere].MaterialIndex, closestSpherePosition);
+   }
+
+   // No hit
+   return Miss(ray);
 }
 
 Renderer::HitPayload Renderer::Miss(const Ray& ray)
 {
    HitPayload payload;
    payload.HitDistance = -1;
+   payload.EntityUUID = 0;
+   payload.MaterialIndex = RenderScene::NoMaterial;
    return payload;
 }
 
-Renderer::HitPayload Renderer::ReportIntersectionHit(float closestT, const Ray& ray, uint64_t entityUUID)
+Renderer::HitPayload Renderer::ReportIntersectionHit(float closestT, const Ray& ray, uint64_t entityUUID, uint32_t materialIndex, const glm::vec3& spherePosition)
 {
-   Entity entity = m_ActiveScene->GetEntityByUUID(entityUUID);
-   
    HitPayload payload;
    payload.HitDistance = closestT;
    payload.EntityUUID = entityUUID;
+   payload.MaterialIndex = materialIndex;
    // Currently the only "intersection shader" geometry we got besides triangles.
    // Later we could add support for other customs types here, like metaballs, planes etc etc
-   // So right now there is no pointin testing if we have a sphere, as we wouldn't get in here if we didn't
-   // And apparently entt seems to be slow when checking this for some reason..
-   // if (entity.HasComponent<SphereComponent>())
-   {
-      SphereComponent sphereComponent = entity.GetComponent<SphereComponent>();
-
-      payload.WorldPos = ray.Origin + ray.Direction * closestT;
-      payload.WorldNorm = glm::normalize(payload.WorldPos - sphereComponent.m_Position);
-   }
+   // The sphere position is passed in rather than read from the snapshot, as it depends on the ray time with motion blur
+   payload.WorldPos = ray.Origin + ray.Direction * closestT;
+   payload.WorldNorm = glm::normalize(payload.WorldPos - spherePosition);
 
    return payload;
-}
\ No newline at end of file
+}
@@ -1,37 +1,134 @@
 #pragma once
 
-#include "Walnut/Image.h"
 #include "glm/glm.hpp"
 
+#include "Acceleration/BVHNode.h"
+#include "Acceleration/WideBVHNode.h"
+#include "AccumulationBuffer.h"
 #include "Camera.h"
+#include "Memory/AlignedBuffer.h"
 #include "Ray.h"
+#include "RayStatistics.h"
+#include "RenderScene.h"
 #include "Scene/Scene.h"
 #include "Scene/Entity.h"
 #include "Scene/Components.h"
 
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
 namespace entt
 {
    typedef basic_view<SphereComponent, IDComponent> SphereView;
    typedef basic_view<MeshComponent  , IDComponent> MeshView;
 }
 
+enum class ReconstructionFilter
+{
+   Box = 0,
+   Tent,
+   BlackmanHarris,
+};
+
+enum class DebugView
+{
+   None = 0,
+   CostTime,  // Nanoseconds spent in PerPixel
+   CostTests, // Intersection tests done by the pixel's paths
+};
+
 class Renderer
 {
 public:
    struct Settings
    {
       bool Accumulate = true;
+
+      // Sub-pixel jitter of the primary rays, each sample is weighted by the reconstruction filter. The rays are generated per
+      // sample then, the cached directions of RayGenerationMode::Cached are only used without jitter
+      bool Jitter = true;
+      ReconstructionFilter Filter = ReconstructionFilter::Box;
+      float FilterRadius = 0.5f; // In pixels
+
+      // Replaces the image with a false color map of the per-pixel cost, averaged over the accumulated frames
+      DebugView View = DebugView::None;
+
+      // Traverses the 4-wide BVHs (all children tested at once), the binary ones when off
+      bool WideBVH = true;
+
+      // An edited entity only resets the pixels it covers (before and after the edit) and the next frame renders just those,
+      // the rest of the image keeps accumulating. Edits to lights reset everything. The reflections, shadows and bounce
+      // light an edited entity casts elsewhere stay until the next full reset
+      bool DirtyRegions = true;
+
+      // Memory per pixel of the accumulated samples. The compact formats keep a rounded mean, their precision limits how far
+      // the image converges (thousands of samples for RGB16F, around a thousand for RGB9E5)
+      AccumulationFormat Accumulation = AccumulationFormat::RGBA32F;
    };
 
+   static float GetDefaultFilterRadius(ReconstructionFilter filter);
+   // Maps t in [0, 1] from cold (blue) to hot (red)
+   static glm::vec3 GetHeatmapColor(float t);
+
    Renderer() = default;
+   // A headless renderer keeps no display image, the result is read back with GetImageData()/GetAccumulationData()
+   explicit Renderer(bool headless)
+      : m_Headless(headless) {}
    ~Renderer() = default;
 
    void Resize(uint32_t width, uint32_t height);
    void Render(Scene& scene, const Camera& camera);
    void ResetFrameIndex() { m_FrameIndex = 1; }
+   // Clears the accumulation and carries on at frame firstFrameIndex: the next frames take the same samples as those frames
+   // of a render started at 1. Renders a range of the samples apart from the others, call after Resize
+   void StartAtFrame(uint32_t firstFrameIndex);
+   // Adds samples rendered elsewhere to the pixels of the region, as the filter weighted color and weight sums of each pixel
+   // (rows bottom to top, like GetAccumulationData), and resolves them into the image
+   void AddSamples(uint32_t x, uint32_t y, uint32_t width, uint32_t height, const glm::vec4* sums);
 
-   std::shared_ptr<Walnut::Image> GetFinalImage() const { return m_FinalImage; }
+   uint32_t GetWidth() const { return m_Width; }
+   uint32_t GetHeight() const { return m_Height; }
+   const uint32_t* GetImageData() const { return m_ImageData.data(); }
+   // Filter weighted color sums in rgb and weight sums in a, nullptr unless the accumulation format is RGBA32F
+   const glm::vec4* GetAccumulationData() const { return m_Accumulation.GetSums(); }
+   const AccumulationBuffer& GetAccumulation() const { return m_Accumulation; }
+   // UUID of the entity the primary ray of each pixel hit in its latest sample, 0 where it hit nothing
+   const uint64_t* GetIDData() const { return m_IDData.data(); }
+   // Picking, the entity visible at the pixel of the last frame (row 0 is the bottom of the image). 0 for none or outside the image
+   uint64_t GetEntityAt(uint32_t x, uint32_t y) const;
+   // The entity gets an outline in the displayed image, 0 for none. GetImageData() stays without it
+   void SetOutlinedEntity(uint64_t uuid) { m_OutlinedUUID = uuid; }
+
+   // Pixels [Min, Max)
+   struct PixelRegion
+   {
+      uint32_t MinX = 0, MinY = 0;
+      uint32_t MaxX = 0, MaxY = 0;
+   };
+   // The image to display, GetImageData() with the outline drawn in. The app uploads it to the GPU, only the regions
+   // ConsumeDisplayChanges returns changed since the previous upload (all of it when allChanged is set). Empty when headless
+   const uint32_t* GetDisplayData() const { return (m_PresentedOutlineUUID != 0) ? m_OutlineImageData.data() : m_ImageData.data(); }
+   std::vector<PixelRegion> ConsumeDisplayChanges(bool& allChanged);
+   // Frames accumulated so far (the next frame rendered gets this index)
+   uint32_t GetFrameIndex() const { return m_FrameIndex; }
    Settings& GetSettings() { return m_Settings; }
+   const RayStatistics::FrameStatistics& GetRayStatistics() const { return m_RayStatistics; }
+   // Min/max of the displayed cost heatmap, in the unit of the debug view
+   glm::vec2 GetCostRange() const { return m_CostRange; }
+   // Bytes of the BVHs traversed last frame in the active layout, the sphere BVH and those of the meshes
+   uint64_t GetBVHMemory() const;
+   // The snapshot of the scene the last frame was rendered from. Safe to call from any thread
+   std::shared_ptr<const RenderScene> GetRenderScene() const { return m_RenderScene.load(); }
+
+   // A progressive render survives the process through checkpoints: the accumulation buffer as it is in memory and the
+   // frame index, which seeds every sample. Resuming continues with exactly the samples the interrupted render would have
+   // taken. Saving needs a rendered frame, the file is replaced atomically
+   bool SaveCheckpoint(const std::string& filepath) const;
+   // Only restores a checkpoint of the same scene contents, camera, sampling settings and size (call after Resize).
+   // The image is resolved from it right away
+   bool LoadCheckpoint(const std::string& filepath, Scene& scene, const Camera& camera);
 private:
    struct HitPayload
    {
@@ -39,27 +136,59 @@ private:
       glm::vec3 WorldPos;
       glm::vec3 WorldNorm;
       uint64_t EntityUUID;
+      uint32_t MaterialIndex; // Into the materials of the frame's RenderScene
    };
 
-   glm::vec4 PerPixel(uint32_t x, uint32_t y);
+   // The camera features are compile-time switches so the pinhole/static path pays nothing for them
+   template<bool ThinLens, bool MotionBlur>
+   void RenderRow(uint32_t y);
+   template<bool ThinLens, bool MotionBlur>
+   glm::vec4 PerPixel(const glm::vec3& rayDirection, uint32_t& seed, uint64_t& primaryHitUUID);
+   template<bool MotionBlur>
    HitPayload TraceRay(const Ray& ray);
+   void ResolveCostHeatmap();
+
+   // Copies the image and draws the outline of m_OutlinedUUID into the copy
+   void DrawOutline();
+   // The pixels of the image in region changed (or all of them), records what the display has to upload
+   void UpdateDisplay(const PixelRegion& region, bool allChanged);
+
+   // Resets the accumulation of the pixels the entities changed between the snapshots cover, and limits the frame to them
+   void InvalidateChangedPixels(const RenderScene& previous, const RenderScene& current);
+   // The pixels the bounds project to, grown by margin. False when the bounds reach behind the camera
+   bool ProjectBounds(const AABB& bounds, uint32_t margin, PixelRegion& region) const;
+   // Of everything a checkpoint's samples depend on
+   uint64_t GetCheckpointHash(const RenderScene& scene, const Camera& camera) const;
    HitPayload Miss(const Ray& ray);
-   HitPayload ReportIntersectionHit(float closestT, const Ray& ray, uint64_t entityUUID); // Custom hit "shader" for geometry other than triangles (Spheres)
+   HitPayload ReportIntersectionHit(float closestT, const Ray& ray, uint64_t entityUUID, uint32_t materialIndex, const glm::vec3& spherePosition); // Custom hit "shader" for geometry other than triangles (Spheres)
 
-   Scene* m_ActiveScene = nullptr;
    const Camera* m_ActiveCamera = nullptr;
 
-   // A bit ugly to store the unpacked "entt::views" like this, but it might be decent for the cache anyways since we'll iterate these
-   // Doing this for now because it's extremly slow to grab the views and the components for each pixel, so might aswell do it once per frame and store them for easy access
-   std::vector<std::pair<const SphereComponent, const IDComponent>> m_SphereComponents;
-   std::vector<std::pair<const MeshComponent, const IDComponent>> m_MeshComponents;
+   // Compiled from the scene at the start of a frame. The tracer only reads m_FrameScene, the snapshot of the frame
+   RenderSceneBuilder m_SceneBuilder;
+   std::atomic<std::shared_ptr<const RenderScene>> m_RenderScene;
+   std::shared_ptr<const RenderScene> m_FrameScene;
 
    Settings m_Settings = {};
+   RayStatistics::FrameStatistics m_RayStatistics = {};
 
    std::vector<uint32_t> m_ImageHorizontalIter, m_ImageVerticalIter;
-   std::shared_ptr<Walnut::Image> m_FinalImage = nullptr;
-   uint32_t* m_ImageData = nullptr;
-   glm::vec4* m_AccumulationData = nullptr;
+   bool m_Headless = false;
+   uint32_t m_Width = 0, m_Height = 0;
+   AlignedBuffer<uint32_t> m_ImageData;
+   AccumulationBuffer m_Accumulation;
+   std::vector<float> m_CostData; // Only allocated while a debug view is active
+   std::vector<uint64_t> m_IDData;
+   uint64_t m_OutlinedUUID = 0;
+   uint64_t m_PresentedOutlineUUID = 0; // Outlined in the display data
+   static constexpr uint32_t s_OutlineThickness = 2; // Pixels
+   std::vector<uint32_t> m_OutlineImageData; // Only used while an entity is outlined
+   std::vector<uint8_t> m_OutlineMask;
+   std::vector<PixelRegion> m_DisplayChanges;
+   bool m_DisplayAllChanged = false;
+   PixelRegion m_RenderRegion; // Of the current frame, the whole image unless only changed pixels are rendered
+   glm::vec2 m_CostRange = { 0.0f, 0.0f };
 
    uint32_t m_FrameIndex = 1;
+   uint32_t m_FrameSeed = 0;
 };
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "UUID.h"
+#include "Acceleration/BVHNode.h"
+#include "Acceleration/WideBVHNode.h"
+#include "Memory/AssetPool.h"
 #include <glm/glm.hpp>
 
 #include <string>
@@ -11,9 +14,22 @@ struct Vertex
 	glm::vec3 m_Normal;
 };
 
+// Indexed triangle list. The Scene owns it and its arrays (see Scene::CreateMesh), components refer to it by handle
 struct Mesh
 {
 	Vertex* m_Vertices = nullptr;
+	uint32_t m_VertexCount = 0;
+	uint32_t* m_Indices = nullptr; // 3 per triangle, in the leaf order of the BVH
+	uint32_t m_TriangleCount = 0;
+	// Above 0 the BVH is an SBVH built with this budget, triangles split by it are in m_Indices (and m_TriangleCount) more than once
+	float m_SpatialSplitBudget = 0.0f;
+
+	// Only one of the two layouts is kept, see Scene::SetWideBVH
+	const BVHNode* m_BVHNodes = nullptr;
+	uint32_t m_BVHNodeCount = 0;
+	// Collapsed from the binary BVH when the scene creates the mesh, over the same triangle order
+	const WideBVHNode* m_WideBVHNodes = nullptr;
+	uint32_t m_WideBVHNodeCount = 0;
 };
 
 struct Material
@@ -57,6 +73,7 @@ struct SphereComponent
 {
 	glm::vec3 m_Position;
 	float m_Radius;
+	glm::vec3 m_Velocity = {}; // Units per second, only visible with motion blur
 
 	SphereComponent() = default;
 	SphereComponent(const SphereComponent&) = default;
@@ -64,23 +81,24 @@ struct SphereComponent
 		: m_Position(position), m_Radius(radius) {}
 };
 
+// The handles resolve through the scene, see Scene::GetMesh/GetMaterial
 struct MeshComponent
 {
-	Mesh* m_Mesh;
+	AssetHandle<Mesh> m_Mesh;
 
 	MeshComponent() = default;
 	MeshComponent(const MeshComponent&) = default;
-	MeshComponent(Mesh* mesh)
+	MeshComponent(AssetHandle<Mesh> mesh)
 		: m_Mesh(mesh) {}
 };
 
 struct MaterialComponent
 {
-	Material* m_Material;
+	AssetHandle<Material> m_Material;
 
 	MaterialComponent() = default;
 	MaterialComponent(const MaterialComponent&) = default;
-	MaterialComponent(Material* mat)
+	MaterialComponent(AssetHandle<Material> mat)
 		: m_Material(mat) {}
 };
 #pragma endregion
\ No newline at end of file
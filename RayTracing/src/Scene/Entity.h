@@ -35,6 +35,13 @@ public:
    }
 
 
+   // Call after editing a component in place (through GetComponent), so the change tracking of the scene sees it
+   template<typename T>
+   void PatchComponent()
+   {
+      m_Scene->m_Registry.patch<T>(m_EntityHandle);
+   }
+
    template<typename T>
    T& GetComponent()
    {
@@ -2,13 +2,66 @@
 #include "Entity.h"
 #include "Components.h"
 
+#include "Acceleration/BVH.h"
+#include "Acceleration/BVHCache.h"
+#include "Acceleration/WideBVH.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+   std::atomic<uint64_t> s_NextInstanceID = 1;
+
+   void SortUnique(std::vector<entt::entity>& entities)
+   {
+      std::sort(entities.begin(), entities.end());
+      entities.erase(std::unique(entities.begin(), entities.end()), entities.end());
+   }
+}
+
 Scene::Scene()
+   : m_InstanceID(s_NextInstanceID++)
 {
+   m_Registry.on_construct<SphereComponent>().connect<&Scene::OnSphereChanged>(*this);
+   m_Registry.on_update<SphereComponent>().connect<&Scene::OnSphereChanged>(*this);
+   m_Registry.on_destroy<SphereComponent>().connect<&Scene::OnSphereChanged>(*this);
+
+   m_Registry.on_construct<MeshComponent>().connect<&Scene::OnMeshChanged>(*this);
+   m_Registry.on_update<MeshComponent>().connect<&Scene::OnMeshChanged>(*this);
+   m_Registry.on_destroy<MeshComponent>().connect<&Scene::OnMeshChanged>(*this);
+
+   m_Registry.on_construct<MaterialComponent>().connect<&Scene::OnMaterialChanged>(*this);
+   m_Registry.on_update<MaterialComponent>().connect<&Scene::OnMaterialChanged>(*this);
+   m_Registry.on_destroy<MaterialComponent>().connect<&Scene::OnMaterialChanged>(*this);
 }
 
 Scene::~Scene()
 {
+   m_Registry.on_construct<SphereComponent>().disconnect(*this);
+   m_Registry.on_update<SphereComponent>().disconnect(*this);
+   m_Registry.on_destroy<SphereComponent>().disconnect(*this);
+
+   m_Registry.on_construct<MeshComponent>().disconnect(*this);
+   m_Registry.on_update<MeshComponent>().disconnect(*this);
+   m_Registry.on_destroy<MeshComponent>().disconnect(*this);
+
+   m_Registry.on_construct<MaterialComponent>().disconnect(*this);
+   m_Registry.on_update<MaterialComponent>().disconnect(*this);
+   m_Registry.on_destroy<MaterialComponent>().disconnect(*this);
+}
+
+Scene::Changes Scene::ConsumeChanges()
+{
+   Changes changes = std::move(m_Changes);
+   m_Changes = {};
 
+   // A component edited every frame from the UI is patched many times in between
+   SortUnique(changes.Spheres);
+   SortUnique(changes.Meshes);
+   SortUnique(changes.Materials);
+   return changes;
 }
 
 Entity Scene::CreateEntity(std::string tag)
@@ -42,3 +95,86 @@ Entity Scene::GetEntityByUUID(UUID uuid)
 
    return { entt::null, nullptr};
 }
+
+AssetHandle<Material> Scene::CreateMaterial(const Material& material)
+{
+   return m_Materials.Create(material);
+}
+
+AssetHandle<Mesh> Scene::CreateMesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices)
+{
+   BVHBuildSettings settings;
+   settings.Quality = m_BVHBuildQuality;
+   return CreateMesh(std::move(vertices), std::move(indices), settings);
+}
+
+AssetHandle<Mesh> Scene::CreateMesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices, const BVHBuildSettings& settings)
+{
+   Mesh mesh;
+   mesh.m_Vertices = m_MeshData.Copy(vertices.data(), vertices.size());
+   mesh.m_VertexCount = (uint32_t)vertices.size();
+   mesh.m_TriangleCount = (uint32_t)(indices.size() / 3);
+   mesh.m_SpatialSplitBudget = settings.SpatialSplitBudget;
+
+   uint64_t hash = 0;
+   if (BVHCache::IsEnabled())
+   {
+      hash = BVHCache::HashMesh(mesh.m_Vertices, mesh.m_VertexCount, indices.data(), mesh.m_TriangleCount, settings);
+
+      // The hash only covers the bytes, a stale or edited file whose hash still matches must not send traversal out of bounds.
+      // One that fails the checks is built again (and overwritten)
+      BVHCache::Entry entry;
+      const uint32_t vertexCount = mesh.m_VertexCount;
+      if (BVHCache::Load(hash, mesh.m_VertexCount, mesh.m_TriangleCount, entry) &&
+          BVHBuilder::IsValid(entry.Nodes, entry.NodeCount, entry.TriangleCount) &&
+          std::none_of(entry.Indices, entry.Indices + (uint64_t)entry.TriangleCount * 3, [vertexCount](uint32_t index) { return index >= vertexCount; }))
+      {
+         mesh.m_Indices = entry.Indices;
+         mesh.m_TriangleCount = entry.TriangleCount;
+         SetMeshBVH(mesh, entry.Nodes, entry.NodeCount, false);
+         KeepAlive(std::move(entry.File));
+         return m_Meshes.Create(mesh);
+      }
+   }
+
+   std::vector<BVHNode> nodes = BVHBuilder::BuildForTriangles(mesh.m_Vertices, indices, settings);
+   if (BVHCache::IsEnabled())
+   {
+      BVHCache::Store(hash, mesh.m_VertexCount, mesh.m_TriangleCount, indices, nodes);
+   }
+
+   mesh.m_Indices = m_MeshData.Copy(indices.data(), indices.size());
+   mesh.m_TriangleCount = (uint32_t)(indices.size() / 3);
+   SetMeshBVH(mesh, nodes.data(), (uint32_t)nodes.size(), true);
+   return m_Meshes.Create(mesh);
+}
+
+AssetHandle<Mesh> Scene::CreateMeshView(const Mesh& mesh)
+{
+   Mesh view = mesh;
+   SetMeshBVH(view, mesh.m_BVHNodes, mesh.m_BVHNodeCount, false);
+   return m_Meshes.Create(view);
+}
+
+void Scene::KeepAlive(std::shared_ptr<MappedFile> file)
+{
+   m_MappedFiles.push_back(std::move(file));
+}
+
+void Scene::SetMeshBVH(Mesh& mesh, const BVHNode* nodes, uint32_t nodeCount, bool copyNodes)
+{
+   if (m_WideBVH)
+   {
+      std::vector<WideBVHNode> wideNodes = WideBVHBuilder::Collapse(nodes, nodeCount);
+      mesh.m_WideBVHNodes = m_MeshData.Copy(wideNodes.data(), wideNodes.size());
+      mesh.m_WideBVHNodeCount = (uint32_t)wideNodes.size();
+      mesh.m_BVHNodes = nullptr;
+      mesh.m_BVHNodeCount = 0;
+      return;
+   }
+
+   mesh.m_BVHNodes = copyNodes ? m_MeshData.Copy(nodes, nodeCount) : nodes;
+   mesh.m_BVHNodeCount = nodeCount;
+   mesh.m_WideBVHNodes = nullptr;
+   mesh.m_WideBVHNodeCount = 0;
+}
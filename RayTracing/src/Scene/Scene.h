@@ -1,19 +1,27 @@
 #pragma once
 
 #include "UUID.h"
+#include "Components.h"
+#include "Acceleration/BVH.h"
+#include "Memory/Arena.h"
+#include "Memory/AssetPool.h"
 
 #include "Ent/raw.githubusercontent.com_skypjack_entt_master_single_include_entt_entt.hpp"
 
 #include "glm/glm.hpp"
+#include <memory>
 #include <vector>
 #include <string>
 
 class Entity;
+class MappedFile;
 
 class Scene
 {
 public:
    Scene();
+   // The registry signals are connected to this object
+   Scene(const Scene&) = delete;
    ~Scene();
 
    Entity CreateEntity(std::string tag = "");
@@ -21,17 +29,79 @@ public:
 
    Entity GetEntityByUUID(UUID uuid);
 
+   // The scene owns the assets its components refer to, in pools that are released with the scene. Resolved assets keep
+   // their address for the lifetime of the scene
+   AssetHandle<Material> CreateMaterial(const Material& material);
+   // Builds the BVH of the mesh with the scene's BVH build quality, this reorders the triangles. The BVH (and triangle order)
+   // comes from the BVHCache when the same mesh was built before. The buffers are copied into the scene's mesh arena
+   AssetHandle<Mesh> CreateMesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices);
+   // With the build settings of this mesh, like spatial splits for meshes of long thin triangles
+   AssetHandle<Mesh> CreateMesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices, const BVHBuildSettings& settings);
+   // Registers a mesh whose buffers (and BVH) live in memory the scene doesn't copy, like a mapped scene file.
+   // The memory has to outlive the scene, see KeepAlive
+   AssetHandle<Mesh> CreateMeshView(const Mesh& mesh);
+
+   // nullptr for invalid handles
+   Material* GetMaterial(AssetHandle<Material> handle) { return m_Materials.Get(handle); }
+   const Material* GetMaterial(AssetHandle<Material> handle) const { return m_Materials.Get(handle); }
+   const Mesh* GetMesh(AssetHandle<Mesh> handle) const { return m_Meshes.Get(handle); }
+   // Keeps a mapped file alive for as long as the scene exists, for components and meshes pointing into it
+   void KeepAlive(std::shared_ptr<MappedFile> file);
+
+   // Fast suits scenes whose spheres move every frame, the sphere BVH is rebuilt each frame with it. Meshes created
+   // afterwards are built with it as well
+   void SetBVHBuildQuality(BVHBuildQuality quality) { m_BVHBuildQuality = quality; }
+   BVHBuildQuality GetBVHBuildQuality() const { return m_BVHBuildQuality; }
+   // Meshes created afterwards keep only the 4-wide BVH collapsed from the binary one, or only the binary one. Should
+   // match the renderer's Settings::WideBVH, a mesh without the layout the renderer wants is traversed with the one it has
+   void SetWideBVH(bool wideBVH) { m_WideBVH = wideBVH; }
+   bool GetWideBVH() const { return m_WideBVH; }
+
    template<typename... Components>
    auto GetAllEntitiesWith() const
    {
       return m_Registry.view<Components...>();
    }
 
+   // Entities whose sphere, mesh or material component was added, patched (see Entity::PatchComponent) or removed since the
+   // last call, each listed once. An entity may have been destroyed since. Editing a Material counts as patching the
+   // MaterialComponent pointing at it. Meant for a single consumer, the renderer keeps its packed copies in sync with it
+   struct Changes
+   {
+      std::vector<entt::entity> Spheres;
+      std::vector<entt::entity> Meshes;
+      std::vector<entt::entity> Materials;
+
+      bool IsEmpty() const { return Spheres.empty() && Meshes.empty() && Materials.empty(); }
+   };
+   Changes ConsumeChanges();
+   // Unique per scene object, so a consumer of the changes notices a new scene even when it was allocated where the old one was
+   uint64_t GetInstanceID() const { return m_InstanceID; }
+
 private:
    friend class Entity;
    friend class SceneHierarchyPanel;
+   friend class SceneBinarySerializer;
 
+   Changes m_Changes;
    entt::registry m_Registry;
+   uint64_t m_InstanceID = 0;
 
    std::unordered_map<UUID, entt::entity> m_EntityMap;
+
+   // Stores the BVH in the layout SetWideBVH asks for. Binary nodes are copied into m_MeshData when copyNodes is set,
+   // otherwise the mesh points at them
+   void SetMeshBVH(Mesh& mesh, const BVHNode* nodes, uint32_t nodeCount, bool copyNodes);
+
+   void OnSphereChanged(entt::registry&, entt::entity entity) { m_Changes.Spheres.push_back(entity); }
+   void OnMeshChanged(entt::registry&, entt::entity entity) { m_Changes.Meshes.push_back(entity); }
+   void OnMaterialChanged(entt::registry&, entt::entity entity) { m_Changes.Materials.push_back(entity); }
+
+   AssetPool<Material> m_Materials;
+   AssetPool<Mesh> m_Meshes;
+   Arena m_MeshData; // Vertices, indices and BVH nodes of the meshes the scene created
+   std::vector<std::shared_ptr<MappedFile>> m_MappedFiles;
+
+   BVHBuildQuality m_BVHBuildQuality = BVHBuildQuality::HighQuality;
+   bool m_WideBVH = true;
 };
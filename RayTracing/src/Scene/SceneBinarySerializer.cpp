@@ -0,0 +1,441 @@
+#include "SceneBinarySerializer.h"
+
+#include "Scene.h"
+#include "Entity.h"
+#include "Components.h"
+
+#include "Acceleration/WideBVH.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <unordered_map>
+
+namespace
+{
+   constexpr char s_Magic[4] = { 'R', 'T', 'S', 'C' };
+   constexpr uint32_t s_Version = 1;
+   constexpr uint64_t s_Alignment = 64;
+   constexpr uint32_t s_InvalidIndex = UINT32_MAX;
+
+   enum ComponentFlags : uint32_t
+   {
+      HasSphere   = 1 << 0,
+      HasMesh     = 1 << 1,
+      HasMaterial = 1 << 2,
+   };
+
+   struct FileHeader
+   {
+      char Magic[4];
+      uint32_t Version;
+      uint64_t FileSize;
+
+      uint32_t EntityCount;
+      uint32_t MaterialCount;
+      uint32_t MeshCount;
+      uint32_t Padding;
+
+      uint64_t EntitiesOffset;
+      uint64_t MaterialsOffset;
+      uint64_t MeshesOffset;
+      uint64_t StringsOffset;
+      uint64_t StringsSize;
+   };
+
+   struct EntityRecord
+   {
+      uint64_t UUID;
+      uint32_t TagOffset; // Into the string table
+      uint32_t TagLength;
+      uint32_t Components; // ComponentFlags
+      uint32_t MaterialIndex;
+      uint32_t MeshIndex;
+
+      glm::vec3 SpherePosition;
+      float SphereRadius;
+      glm::vec3 SphereVelocity;
+   };
+
+   struct MeshRecord
+   {
+      uint64_t VerticesOffset;
+      uint64_t IndicesOffset;
+      uint64_t BVHOffset; // 0 without a BVH
+      uint32_t VertexCount;
+      uint32_t TriangleCount;
+      uint32_t BVHNodeCount;
+      float SpatialSplitBudget; // Of Mesh::m_SpatialSplitBudget, 0 for a plain BVH
+   };
+
+   // The mapped bytes are used as these types directly, so their layout is part of the format
+   static_assert(sizeof(FileHeader) == 72);
+   static_assert(sizeof(EntityRecord) == 56);
+   static_assert(sizeof(MeshRecord) == 40);
+   static_assert(sizeof(Material) == 24 && std::is_trivially_copyable_v<Material>);
+   static_assert(sizeof(Vertex) == 24 && std::is_trivially_copyable_v<Vertex>);
+   static_assert(sizeof(BVHNode) == 32 && std::is_trivially_copyable_v<BVHNode>);
+
+   uint64_t AlignUp(uint64_t offset)
+   {
+      return (offset + s_Alignment - 1) & ~(s_Alignment - 1);
+   }
+
+   // Counts the bytes written so the offsets can be computed in the same pass that writes them
+   class FileWriter
+   {
+   public:
+      FileWriter(const std::string& filepath)
+         : m_Stream(filepath, std::ios::binary) {}
+
+      bool IsOpen() const { return m_Stream.is_open(); }
+      bool IsGood() const { return m_Stream.good(); }
+      uint64_t GetOffset() const { return m_Offset; }
+
+      void Write(const void* data, uint64_t size)
+      {
+         m_Stream.write((const char*)data, size);
+         m_Offset += size;
+      }
+
+      void Align()
+      {
+         static const char zeros[s_Alignment] = {};
+         Write(zeros, AlignUp(m_Offset) - m_Offset);
+      }
+
+      void Seek(uint64_t offset)
+      {
+         m_Stream.seekp(offset);
+      }
+   private:
+      std::ofstream m_Stream;
+      uint64_t m_Offset = 0;
+   };
+
+   bool IsRangeValid(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize)
+   {
+      if (count == 0)
+      {
+         return true;
+      }
+
+      if (offset % alignof(uint32_t) != 0 || offset > fileSize || count > (fileSize - offset) / elementSize)
+      {
+         return false;
+      }
+
+      return true;
+   }
+}
+
+SceneBinarySerializer::SceneBinarySerializer(Scene* scene)
+   : m_Scene(scene)
+{
+}
+
+bool SceneBinarySerializer::Serialize(const std::string& filepath, bool includeBVH)
+{
+   FileWriter writer(filepath);
+   if (not writer.IsOpen())
+   {
+      return false;
+   }
+
+   // Gather the entities and give every distinct material/mesh an index
+   std::vector<EntityRecord> entities;
+   std::vector<const Material*> materials;
+   std::vector<const Mesh*> meshes;
+   std::unordered_map<const Material*, uint32_t> materialIndices;
+   std::unordered_map<const Mesh*, uint32_t> meshIndices;
+   std::string strings;
+
+   // Views iterate the newest entity first, walk them backwards so a load recreates them in the same order
+   const auto& view = m_Scene->m_Registry.view<IDComponent>();
+   entities.reserve(view.size());
+   for (auto it = view.rbegin(); it != view.rend(); ++it)
+   {
+      Entity entity = { *it, m_Scene };
+
+      EntityRecord record = {};
+      record.UUID = entity.GetUUID();
+      record.MaterialIndex = s_InvalidIndex;
+      record.MeshIndex = s_InvalidIndex;
+
+      if (entity.HasComponent<TagComponent>())
+      {
+         const std::string& tag = entity.GetComponent<TagComponent>().m_Tag;
+         record.TagOffset = (uint32_t)strings.size();
+         record.TagLength = (uint32_t)tag.size();
+         strings += tag;
+      }
+
+      if (entity.HasComponent<SphereComponent>())
+      {
+         const SphereComponent& sphere = entity.GetComponent<SphereComponent>();
+         record.Components |= HasSphere;
+         record.SpherePosition = sphere.m_Position;
+         record.SphereRadius = sphere.m_Radius;
+         record.SphereVelocity = sphere.m_Velocity;
+      }
+
+      if (entity.HasComponent<MeshComponent>() && m_Scene->GetMesh(entity.GetComponent<MeshComponent>().m_Mesh) != nullptr)
+      {
+         const Mesh* mesh = m_Scene->GetMesh(entity.GetComponent<MeshComponent>().m_Mesh);
+         auto [it, inserted] = meshIndices.try_emplace(mesh, (uint32_t)meshes.size());
+         if (inserted)
+         {
+            meshes.push_back(mesh);
+         }
+
+         record.Components |= HasMesh;
+         record.MeshIndex = it->second;
+      }
+
+      if (entity.HasComponent<MaterialComponent>() && m_Scene->GetMaterial(entity.GetComponent<MaterialComponent>().m_Material) != nullptr)
+      {
+         const Material* material = m_Scene->GetMaterial(entity.GetComponent<MaterialComponent>().m_Material);
+         auto [it, inserted] = materialIndices.try_emplace(material, (uint32_t)materials.size());
+         if (inserted)
+         {
+            materials.push_back(material);
+         }
+
+         record.Components |= HasMaterial;
+         record.MaterialIndex = it->second;
+      }
+
+      entities.push_back(record);
+   }
+
+   // The header is rewritten at the end, once every offset is known
+   FileHeader header = {};
+   memcpy(header.Magic, s_Magic, sizeof(s_Magic));
+   header.Version = s_Version;
+   header.EntityCount = (uint32_t)entities.size();
+   header.MaterialCount = (uint32_t)materials.size();
+   header.MeshCount = (uint32_t)meshes.size();
+   writer.Write(&header, sizeof(header));
+
+   writer.Align();
+   header.EntitiesOffset = writer.GetOffset();
+   writer.Write(entities.data(), entities.size() * sizeof(EntityRecord));
+
+   writer.Align();
+   header.MaterialsOffset = writer.GetOffset();
+   for (const Material* material : materials)
+   {
+      writer.Write(material, sizeof(Material));
+   }
+
+   // Mesh records point at buffers that come later, reserve their space for now
+   writer.Align();
+   header.MeshesOffset = writer.GetOffset();
+   std::vector<MeshRecord> meshRecords(meshes.size());
+   writer.Write(meshRecords.data(), meshRecords.size() * sizeof(MeshRecord));
+
+   writer.Align();
+   header.StringsOffset = writer.GetOffset();
+   header.StringsSize = strings.size();
+   writer.Write(strings.data(), strings.size());
+
+   for (size_t i = 0; i < meshes.size(); i++)
+   {
+      const Mesh& mesh = *meshes[i];
+      MeshRecord& record = meshRecords[i];
+
+      writer.Align();
+      record.VerticesOffset = writer.GetOffset();
+      record.VertexCount = mesh.m_VertexCount;
+      writer.Write(mesh.m_Vertices, (uint64_t)mesh.m_VertexCount * sizeof(Vertex));
+
+      writer.Align();
+      record.IndicesOffset = writer.GetOffset();
+      record.SpatialSplitBudget = mesh.m_SpatialSplitBudget;
+      if (not includeBVH && mesh.m_SpatialSplitBudget > 0.0f)
+      {
+         // The repeated triangles only belong to this BVH, the loader builds a new one
+         std::vector<uint32_t> indices = BVHBuilder::GetUniqueTriangles(mesh.m_Indices, mesh.m_TriangleCount);
+         record.TriangleCount = (uint32_t)(indices.size() / 3);
+         writer.Write(indices.data(), indices.size() * sizeof(uint32_t));
+      }
+      else
+      {
+         record.TriangleCount = mesh.m_TriangleCount;
+         writer.Write(mesh.m_Indices, (uint64_t)mesh.m_TriangleCount * 3 * sizeof(uint32_t));
+      }
+
+      // The file stores the binary layout, meshes that only kept the wide one are expanded back into it
+      std::vector<BVHNode> expandedNodes;
+      const BVHNode* nodes = mesh.m_BVHNodes;
+      uint32_t nodeCount = mesh.m_BVHNodeCount;
+      if (includeBVH && nodeCount == 0 && mesh.m_WideBVHNodeCount > 0)
+      {
+         expandedNodes = WideBVHBuilder::Expand(mesh.m_WideBVHNodes, mesh.m_WideBVHNodeCount);
+         nodes = expandedNodes.data();
+         nodeCount = (uint32_t)expandedNodes.size();
+      }
+
+      if (includeBVH && nodeCount > 0)
+      {
+         writer.Align();
+         record.BVHOffset = writer.GetOffset();
+         record.BVHNodeCount = nodeCount;
+         writer.Write(nodes, (uint64_t)nodeCount * sizeof(BVHNode));
+      }
+   }
+
+   header.FileSize = writer.GetOffset();
+
+   writer.Seek(header.MeshesOffset);
+   writer.Write(meshRecords.data(), meshRecords.size() * sizeof(MeshRecord));
+   writer.Seek(0);
+   writer.Write(&header, sizeof(header));
+
+   return writer.IsGood();
+}
+
+bool SceneBinarySerializer::Deserialize(const std::string& filepath)
+{
+   std::shared_ptr<MappedFile> file = MappedFile::Open(filepath);
+   if (file == nullptr)
+   {
+      printf("Failed to open scene '%s'\n", filepath.c_str());
+      return false;
+   }
+
+   uint8_t* data = file->GetData();
+   const uint64_t fileSize = file->GetSize();
+
+   // Validate everything before pointing into the file, a truncated or foreign file must not crash the renderer
+   if (fileSize < sizeof(FileHeader))
+   {
+      printf("'%s' is not a scene file\n", filepath.c_str());
+      return false;
+   }
+
+   const FileHeader& header = *(const FileHeader*)data;
+   if (memcmp(header.Magic, s_Magic, sizeof(s_Magic)) != 0)
+   {
+      printf("'%s' is not a scene file\n", filepath.c_str());
+      return false;
+   }
+
+   if (header.Version != s_Version)
+   {
+      printf("'%s' has version %u, expected %u\n", filepath.c_str(), header.Version, s_Version);
+      return false;
+   }
+
+   if (header.FileSize != fileSize ||
+       not IsRangeValid(header.EntitiesOffset, header.EntityCount, sizeof(EntityRecord), fileSize) ||
+       not IsRangeValid(header.MaterialsOffset, header.MaterialCount, sizeof(Material), fileSize) ||
+       not IsRangeValid(header.MeshesOffset, header.MeshCount, sizeof(MeshRecord), fileSize) ||
+       not IsRangeValid(header.StringsOffset, header.StringsSize, 1, fileSize))
+   {
+      printf("'%s' is truncated or corrupt\n", filepath.c_str());
+      return false;
+   }
+
+   const EntityRecord* entities = (const EntityRecord*)(data + header.EntitiesOffset);
+   const Material* materialRecords = (const Material*)(data + header.MaterialsOffset);
+   const MeshRecord* meshRecords = (const MeshRecord*)(data + header.MeshesOffset);
+   const char* strings = (const char*)(data + header.StringsOffset);
+
+   for (uint32_t i = 0; i < header.MeshCount; i++)
+   {
+      const MeshRecord& record = meshRecords[i];
+      if (not IsRangeValid(record.VerticesOffset, record.VertexCount, sizeof(Vertex), fileSize) ||
+          not IsRangeValid(record.IndicesOffset, (uint64_t)record.TriangleCount * 3, sizeof(uint32_t), fileSize) ||
+          not IsRangeValid(record.BVHOffset, record.BVHNodeCount, sizeof(BVHNode), fileSize))
+      {
+         printf("'%s' has a corrupt mesh (%u)\n", filepath.c_str(), i);
+         return false;
+      }
+
+      // The tracer reads vertices and triangles through these without checking, files can come from other machines
+      const uint32_t* indices = (const uint32_t*)(data + record.IndicesOffset);
+      const uint32_t* indicesEnd = indices + (uint64_t)record.TriangleCount * 3;
+      const uint32_t vertexCount = record.VertexCount;
+      if (std::any_of(indices, indicesEnd, [vertexCount](uint32_t index) { return index >= vertexCount; }) ||
+          not BVHBuilder::IsValid((const BVHNode*)(data + record.BVHOffset), record.BVHNodeCount, record.TriangleCount))
+      {
+         printf("'%s' has a corrupt mesh (%u)\n", filepath.c_str(), i);
+         return false;
+      }
+   }
+
+   for (uint32_t i = 0; i < header.EntityCount; i++)
+   {
+      const EntityRecord& record = entities[i];
+      if (((record.Components & HasMaterial) && record.MaterialIndex >= header.MaterialCount) ||
+          ((record.Components & HasMesh) && record.MeshIndex >= header.MeshCount) ||
+          (uint64_t)record.TagOffset + record.TagLength > header.StringsSize)
+      {
+         printf("'%s' has a corrupt entity (%u)\n", filepath.c_str(), i);
+         return false;
+      }
+   }
+
+   // Meshes point into the mapping. Only files without a BVH cost a copy, as the build reorders the triangles
+   std::vector<AssetHandle<Mesh>> meshes(header.MeshCount);
+   for (uint32_t i = 0; i < header.MeshCount; i++)
+   {
+      const MeshRecord& record = meshRecords[i];
+      Vertex* vertices = (Vertex*)(data + record.VerticesOffset);
+      uint32_t* indices = (uint32_t*)(data + record.IndicesOffset);
+
+      if (record.BVHNodeCount == 0)
+      {
+         BVHBuildSettings settings;
+         settings.Quality = m_Scene->GetBVHBuildQuality();
+         settings.SpatialSplitBudget = record.SpatialSplitBudget;
+         meshes[i] = m_Scene->CreateMesh(std::vector<Vertex>(vertices, vertices + record.VertexCount),
+                                         std::vector<uint32_t>(indices, indices + (uint64_t)record.TriangleCount * 3), settings);
+         continue;
+      }
+
+      Mesh mesh;
+      mesh.m_Vertices = vertices;
+      mesh.m_VertexCount = record.VertexCount;
+      mesh.m_Indices = indices;
+      mesh.m_TriangleCount = record.TriangleCount;
+      mesh.m_SpatialSplitBudget = record.SpatialSplitBudget;
+      mesh.m_BVHNodes = (const BVHNode*)(data + record.BVHOffset);
+      mesh.m_BVHNodeCount = record.BVHNodeCount;
+      meshes[i] = m_Scene->CreateMeshView(mesh);
+   }
+
+   // Materials are small and get edited, they're copied into the scene's pool
+   std::vector<AssetHandle<Material>> materials(header.MaterialCount);
+   for (uint32_t i = 0; i < header.MaterialCount; i++)
+   {
+      materials[i] = m_Scene->CreateMaterial(materialRecords[i]);
+   }
+
+   for (uint32_t i = 0; i < header.EntityCount; i++)
+   {
+      const EntityRecord& record = entities[i];
+
+      Entity entity = m_Scene->CreateEntityWithUUID(record.UUID, std::string(strings + record.TagOffset, record.TagLength));
+      if (record.Components & HasSphere)
+      {
+         SphereComponent& sphere = entity.AddComponent<SphereComponent>(record.SpherePosition, record.SphereRadius);
+         sphere.m_Velocity = record.SphereVelocity;
+      }
+      if (record.Components & HasMesh)
+      {
+         entity.AddComponent<MeshComponent>(meshes[record.MeshIndex]);
+      }
+      if (record.Components & HasMaterial)
+      {
+         entity.AddComponent<MaterialComponent>(materials[record.MaterialIndex]);
+      }
+   }
+
+   m_Scene->KeepAlive(std::move(file));
+   return true;
+}
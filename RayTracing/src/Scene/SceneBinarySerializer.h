@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+class Scene;
+
+// Versioned binary scene file (.rtscene), little endian. Layout:
+//   Header
+//   Entity records   (UUID, tag, which components it has, sphere data, material/mesh index)
+//   Materials        (Material as is)
+//   Mesh records     (offsets/counts of the buffers below)
+//   String table     (the tags)
+//   Mesh buffers     (vertices, indices, optional BVH nodes), every buffer 64 byte aligned
+//
+// Loading maps the file and points the materials and meshes straight into the mapping, only the entities
+// are created one by one. Files written without BVHs get them built on load. Every offset, index and BVH node is checked
+// before use, so a corrupt file (or one sent by another machine) fails to load rather than crash the tracer
+class SceneBinarySerializer
+{
+public:
+   SceneBinarySerializer(Scene* scene);
+
+   bool Serialize(const std::string& filepath, bool includeBVH = true);
+   // Adds the entities of the file to the scene. The scene keeps the file mapped for as long as it exists
+   bool Deserialize(const std::string& filepath);
+
+private:
+   Scene* m_Scene = nullptr;
+};
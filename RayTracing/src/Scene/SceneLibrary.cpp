@@ -0,0 +1,308 @@
+#include "SceneLibrary.h"
+
+#include "Scene.h"
+#include "Entity.h"
+#include "Components.h"
+
+#include <random>
+
+namespace
+{
+   void AddSphere(Scene& scene, const std::string& tag, const glm::vec3& position, float radius, AssetHandle<Material> material)
+   {
+      Entity entity = scene.CreateEntity(tag);
+      entity.AddComponent<SphereComponent>(position, radius);
+      entity.AddComponent<MaterialComponent>(material);
+   }
+
+   // Quad a, b, c, d (counter-clockwise seen from the front)
+   void AddQuad(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d)
+   {
+      glm::vec3 normal = glm::normalize(glm::cross(b - a, c - a));
+      uint32_t first = (uint32_t)vertices.size();
+      for (const glm::vec3& position : { a, b, c, d })
+      {
+         Vertex& vertex = vertices.emplace_back();
+         vertex.m_Position = position;
+         vertex.m_Normal = normal;
+      }
+      indices.insert(indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+   }
+
+   // Both faces, for walls seen from either side
+   void AddTwoSidedQuad(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d)
+   {
+      AddQuad(vertices, indices, a, b, c, d);
+      AddQuad(vertices, indices, d, c, b, a);
+   }
+
+   void AddBox(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const glm::vec3& min, const glm::vec3& max)
+   {
+      const glm::vec3 p[8] = {
+         { min.x, min.y, min.z }, { max.x, min.y, min.z }, { max.x, max.y, min.z }, { min.x, max.y, min.z },
+         { min.x, min.y, max.z }, { max.x, min.y, max.z }, { max.x, max.y, max.z }, { min.x, max.y, max.z } };
+
+      AddQuad(vertices, indices, p[4], p[5], p[6], p[7]); // +z
+      AddQuad(vertices, indices, p[1], p[0], p[3], p[2]); // -z
+      AddQuad(vertices, indices, p[5], p[1], p[2], p[6]); // +x
+      AddQuad(vertices, indices, p[0], p[4], p[7], p[3]); // -x
+      AddQuad(vertices, indices, p[7], p[6], p[2], p[3]); // +y
+      AddQuad(vertices, indices, p[0], p[1], p[5], p[4]); // -y
+   }
+
+   void PopulateDefault(Scene& scene)
+   {
+      AssetHandle<Material> purpleMat = scene.CreateMaterial(Material({ 1.0f, 0.0f, 1.0f }, 0.4f, 0.0f, 0.0f));
+      AssetHandle<Material> brownMat = scene.CreateMaterial(Material({ 0.5f, 0.25f, 0.0f }, 0.1f, 1.0f, 0.0f));
+      AssetHandle<Material> sunMat = scene.CreateMaterial(Material({ 0.8f, 0.5f, 0.2f }, 0.1f, 1.0f, 30.0f));
+
+      std::vector<Vertex> vertices(3);
+      vertices[0].m_Position = glm::vec3(1.0f, 1.0f, 0.0f);    //Top Right
+      vertices[1].m_Position = glm::vec3(-1.0f, -1.0f, 0.0f);  //Bottom Left
+      vertices[2].m_Position = glm::vec3(1.0f, -1.0f, 0.0f);   //Bottom Right
+
+      glm::vec3 normal = glm::cross(vertices[0].m_Position - vertices[1].m_Position, vertices[0].m_Position - vertices[2].m_Position);
+      vertices[0].m_Normal = vertices[1].m_Normal = vertices[2].m_Normal = glm::normalize(normal); // All vertices got the same normal obv
+      AssetHandle<Mesh> triangleMesh = scene.CreateMesh(std::move(vertices), { 0, 1, 2 });
+
+      AddSphere(scene, "Sphere", glm::vec3(2.5f, 0.0f, 0.5f), 1.0f, purpleMat);
+      AddSphere(scene, "Floor", glm::vec3(0.0f, -101.f, 0.0f), 100.0f, brownMat); // Big sphere moved down
+      AddSphere(scene, "Sun", glm::vec3(25.0f, 4.0f, -25.0f), 20.0f, sunMat);
+
+      Entity triangle = scene.CreateEntity("Triangle");
+      triangle.AddComponent<MeshComponent>(triangleMesh);
+      triangle.AddComponent<MaterialComponent>(purpleMat);
+   }
+
+   void PopulateFewSpheres(Scene& scene)
+   {
+      AssetHandle<Material> floorMat = scene.CreateMaterial(Material({ 0.6f, 0.6f, 0.6f }, 1.0f, 0.0f, 0.0f));
+      AssetHandle<Material> redMat = scene.CreateMaterial(Material({ 0.9f, 0.2f, 0.2f }, 0.5f, 0.0f, 0.0f));
+      AssetHandle<Material> blueMat = scene.CreateMaterial(Material({ 0.2f, 0.3f, 0.9f }, 0.5f, 0.0f, 0.0f));
+      AssetHandle<Material> sunMat = scene.CreateMaterial(Material({ 1.0f, 0.9f, 0.7f }, 1.0f, 0.0f, 20.0f));
+
+      AddSphere(scene, "Floor", glm::vec3(0.0f, -1001.0f, 0.0f), 1000.0f, floorMat);
+      AddSphere(scene, "Left", glm::vec3(-2.2f, 0.5f, 0.0f), 1.5f, redMat);
+      AddSphere(scene, "Center", glm::vec3(0.0f, 1.0f, -2.0f), 2.0f, blueMat);
+      AddSphere(scene, "Right", glm::vec3(2.2f, 0.5f, 0.0f), 1.5f, redMat);
+      AddSphere(scene, "Sun", glm::vec3(20.0f, 30.0f, 20.0f), 10.0f, sunMat);
+   }
+
+   void PopulateManySpheres(Scene& scene)
+   {
+      const uint32_t gridSize = 100; // 100 x 100 = 10k spheres
+      const float spacing = 0.5f;
+
+      std::mt19937 engine(1337); // Fixed seed, the scene has to be identical in every run
+      std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+      AssetHandle<Material> floorMat = scene.CreateMaterial(Material({ 0.5f, 0.5f, 0.5f }, 1.0f, 0.0f, 0.0f));
+      AssetHandle<Material> sunMat = scene.CreateMaterial(Material({ 1.0f, 1.0f, 1.0f }, 1.0f, 0.0f, 10.0f));
+      AssetHandle<Material> sphereMats[8];
+      for (AssetHandle<Material>& material : sphereMats)
+      {
+         material = scene.CreateMaterial(Material({ unit(engine), unit(engine), unit(engine) }, unit(engine), 0.0f, 0.0f));
+      }
+
+      AddSphere(scene, "Floor", glm::vec3(0.0f, -1000.0f, 0.0f), 1000.0f, floorMat);
+      AddSphere(scene, "Sun", glm::vec3(0.0f, 60.0f, 0.0f), 20.0f, sunMat);
+
+      const float halfExtent = 0.5f * spacing * (gridSize - 1);
+      for (uint32_t z = 0; z < gridSize; z++)
+      {
+         for (uint32_t x = 0; x < gridSize; x++)
+         {
+            float radius = 0.1f + 0.1f * unit(engine);
+            glm::vec3 position = { x * spacing - halfExtent, radius, z * spacing - halfExtent };
+            position.x += (unit(engine) - 0.5f) * 0.1f;
+            position.z += (unit(engine) - 0.5f) * 0.1f;
+
+            AddSphere(scene, "Sphere", position, radius, sphereMats[(x + z) % 8]);
+         }
+      }
+   }
+
+   void PopulateTriangleMesh(Scene& scene)
+   {
+      const uint32_t quadsPerSide = 708; // 2 * 708^2 = 1'002'528 triangles
+      const float size = 20.0f;
+
+      AssetHandle<Material> groundMat = scene.CreateMaterial(Material({ 0.4f, 0.6f, 0.3f }, 1.0f, 0.0f, 0.0f));
+      AssetHandle<Material> sunMat = scene.CreateMaterial(Material({ 1.0f, 0.9f, 0.7f }, 1.0f, 0.0f, 20.0f));
+
+      const uint32_t verticesPerSide = quadsPerSide + 1;
+      std::vector<Vertex> vertices(verticesPerSide * verticesPerSide);
+      for (uint32_t z = 0; z < verticesPerSide; z++)
+      {
+         for (uint32_t x = 0; x < verticesPerSide; x++)
+         {
+            float u = (float)x / quadsPerSide;
+            float v = (float)z / quadsPerSide;
+            float height = 0.8f * glm::sin(u * 12.0f) * glm::cos(v * 9.0f) + 0.3f * glm::sin((u + v) * 31.0f);
+
+            Vertex& vertex = vertices[x + z * verticesPerSide];
+            vertex.m_Position = { (u - 0.5f) * size, height - 1.0f, (v - 0.5f) * size };
+            vertex.m_Normal = { 0.0f, 1.0f, 0.0f };
+         }
+      }
+
+      std::vector<uint32_t> indices;
+      indices.reserve(quadsPerSide * quadsPerSide * 6);
+      for (uint32_t z = 0; z < quadsPerSide; z++)
+      {
+         for (uint32_t x = 0; x < quadsPerSide; x++)
+         {
+            uint32_t a = x + z * verticesPerSide;
+            uint32_t b = a + 1;
+            uint32_t c = a + verticesPerSide;
+            uint32_t d = c + 1;
+
+            // Counter-clockwise seen from above, the front faces point up
+            indices.insert(indices.end(), { a, c, b });
+            indices.insert(indices.end(), { b, c, d });
+         }
+      }
+
+      AssetHandle<Mesh> mesh = scene.CreateMesh(std::move(vertices), std::move(indices));
+
+      Entity terrain = scene.CreateEntity("Terrain");
+      terrain.AddComponent<MeshComponent>(mesh);
+      terrain.AddComponent<MaterialComponent>(groundMat);
+
+      AddSphere(scene, "Sun", glm::vec3(30.0f, 40.0f, -30.0f), 15.0f, sunMat);
+   }
+
+   void PopulateManyLights(Scene& scene)
+   {
+      const uint32_t lightCount = 512;
+
+      std::mt19937 engine(4242);
+      std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+      AssetHandle<Material> floorMat = scene.CreateMaterial(Material({ 0.7f, 0.7f, 0.7f }, 1.0f, 0.0f, 0.0f));
+      AssetHandle<Material> lightMats[16];
+      for (AssetHandle<Material>& material : lightMats)
+      {
+         glm::vec3 color = glm::vec3(0.2f) + 0.8f * glm::vec3(unit(engine), unit(engine), unit(engine));
+         material = scene.CreateMaterial(Material(color, 1.0f, 0.0f, 2.0f + 8.0f * unit(engine)));
+      }
+
+      AddSphere(scene, "Floor", glm::vec3(0.0f, -1000.0f, 0.0f), 1000.0f, floorMat);
+
+      for (uint32_t i = 0; i < lightCount; i++)
+      {
+         glm::vec3 position = { (unit(engine) - 0.5f) * 30.0f, 0.2f + 4.0f * unit(engine), (unit(engine) - 0.5f) * 30.0f };
+         AddSphere(scene, "Light", position, 0.05f + 0.15f * unit(engine), lightMats[i % 16]);
+      }
+   }
+
+   void PopulateArchitecture(Scene& scene)
+   {
+      const uint32_t storeys = 4;
+      const uint32_t roomsPerSide = 8;
+      const uint32_t boxCount = 4000;
+      const float size = 40.0f;
+      const float storeyHeight = 3.0f;
+      const float roomSize = size / roomsPerSide;
+
+      std::mt19937 engine(2718);
+      std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+      AssetHandle<Material> buildingMat = scene.CreateMaterial(Material({ 0.8f, 0.8f, 0.75f }, 1.0f, 0.0f, 0.0f));
+      AssetHandle<Material> sunMat = scene.CreateMaterial(Material({ 1.0f, 0.95f, 0.8f }, 1.0f, 0.0f, 20.0f));
+
+      std::vector<Vertex> vertices;
+      std::vector<uint32_t> indices;
+
+      // Every slab and wall is a single quad across the whole building, the worst case for an object split BVH
+      const float half = 0.5f * size;
+      for (uint32_t storey = 0; storey < storeys; storey++)
+      {
+         const float y0 = storey * storeyHeight;
+         const float y1 = y0 + storeyHeight;
+         AddQuad(vertices, indices, { -half, y0, half }, { half, y0, half }, { half, y0, -half }, { -half, y0, -half });
+
+         for (uint32_t i = 0; i <= roomsPerSide; i++)
+         {
+            const float offset = -half + i * roomSize;
+            AddTwoSidedQuad(vertices, indices, { offset, y0, half }, { offset, y0, -half }, { offset, y1, -half }, { offset, y1, half });
+            AddTwoSidedQuad(vertices, indices, { -half, y0, offset }, { half, y0, offset }, { half, y1, offset }, { -half, y1, offset });
+         }
+      }
+
+      // Furniture standing on the floors
+      for (uint32_t i = 0; i < boxCount; i++)
+      {
+         glm::vec3 extent = { 0.2f + 0.8f * unit(engine), 0.2f + 1.0f * unit(engine), 0.2f + 0.8f * unit(engine) };
+         glm::vec3 min = { (unit(engine) - 0.5f) * (size - 2.0f), (float)(i % storeys) * storeyHeight, (unit(engine) - 0.5f) * (size - 2.0f) };
+         AddBox(vertices, indices, min, min + extent);
+      }
+
+      BVHBuildSettings settings;
+      settings.Quality = scene.GetBVHBuildQuality();
+      settings.SpatialSplitBudget = 0.5f;
+      AssetHandle<Mesh> mesh = scene.CreateMesh(std::move(vertices), std::move(indices), settings);
+
+      Entity building = scene.CreateEntity("Building");
+      building.AddComponent<MeshComponent>(mesh);
+      building.AddComponent<MaterialComponent>(buildingMat);
+
+      AddSphere(scene, "Sun", glm::vec3(40.0f, 60.0f, 30.0f), 20.0f, sunMat);
+   }
+}
+
+const char* SceneLibrary::GetName(CanonicalScene scene)
+{
+   switch (scene)
+   {
+   case CanonicalScene::Default:      return "default";
+   case CanonicalScene::FewSpheres:   return "few-spheres";
+   case CanonicalScene::ManySpheres:  return "many-spheres";
+   case CanonicalScene::TriangleMesh: return "triangle-mesh";
+   case CanonicalScene::ManyLights:   return "many-lights";
+   case CanonicalScene::Architecture: return "architecture";
+   default:                           return "unknown";
+   }
+}
+
+bool SceneLibrary::FromName(const std::string& name, CanonicalScene& outScene)
+{
+   for (uint32_t i = 0; i < (uint32_t)CanonicalScene::Count; i++)
+   {
+      if (name == GetName((CanonicalScene)i))
+      {
+         outScene = (CanonicalScene)i;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+void SceneLibrary::Populate(Scene& scene, CanonicalScene canonicalScene)
+{
+   switch (canonicalScene)
+   {
+   case CanonicalScene::Default:      PopulateDefault(scene); break;
+   case CanonicalScene::FewSpheres:   PopulateFewSpheres(scene); break;
+   case CanonicalScene::ManySpheres:  PopulateManySpheres(scene); break;
+   case CanonicalScene::TriangleMesh: PopulateTriangleMesh(scene); break;
+   case CanonicalScene::ManyLights:   PopulateManyLights(scene); break;
+   case CanonicalScene::Architecture: PopulateArchitecture(scene); break;
+   default: break;
+   }
+}
+
+SceneLibrary::CameraPose SceneLibrary::GetCameraPose(CanonicalScene scene)
+{
+   switch (scene)
+   {
+   case CanonicalScene::FewSpheres:   return { { 0.0f, 2.0f, 9.0f }, { 0.0f, 0.5f, 0.0f } };
+   case CanonicalScene::ManySpheres:  return { { 0.0f, 8.0f, 28.0f }, { 0.0f, 0.0f, 0.0f } };
+   case CanonicalScene::TriangleMesh: return { { 0.0f, 6.0f, 14.0f }, { 0.0f, -1.0f, 0.0f } };
+   case CanonicalScene::ManyLights:   return { { 0.0f, 6.0f, 20.0f }, { 0.0f, 1.0f, 0.0f } };
+   case CanonicalScene::Architecture: return { { 0.0f, 30.0f, 35.0f }, { 0.0f, 4.0f, 0.0f } };
+   case CanonicalScene::Default:
+   default:                           return { { 0.0f, 0.0f, 3.0f }, { 0.0f, 0.0f, 0.0f } };
+   }
+}
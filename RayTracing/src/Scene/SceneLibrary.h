@@ -0,0 +1,39 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <string>
+
+class Scene;
+
+// Canonical scenes shared by the app and the render benchmark, so numbers are always taken on the same content
+enum class CanonicalScene
+{
+   Default = 0,  // The example scene: a sphere, a triangle, a floor and a sun
+   FewSpheres,   // A handful of big spheres, most rays hit something
+   ManySpheres,  // 10k small spheres on a grid
+   TriangleMesh, // 1M triangle heightfield
+   ManyLights,   // Hundreds of small emissive spheres over a dark floor
+   Architecture, // Floors and walls of long thin triangles over lots of furniture boxes, built as an SBVH
+
+   Count
+};
+
+class SceneLibrary
+{
+public:
+   struct CameraPose
+   {
+      glm::vec3 Position;
+      glm::vec3 Target;
+   };
+
+   static const char* GetName(CanonicalScene scene);
+   // Accepts the names returned by GetName. Returns false for unknown names
+   static bool FromName(const std::string& name, CanonicalScene& outScene);
+
+   // Adds the entities (and the materials/meshes they use) to an empty scene
+   static void Populate(Scene& scene, CanonicalScene canonicalScene);
+   // The fixed viewpoint every benchmark run of this scene starts from
+   static CameraPose GetCameraPose(CanonicalScene scene);
+};
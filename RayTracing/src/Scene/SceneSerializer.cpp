@@ -0,0 +1,471 @@
+#include "SceneSerializer.h"
+
+#include "Scene.h"
+#include "Entity.h"
+#include "Components.h"
+
+#include "Json.h"
+
+#include <charconv>
+#include <fstream>
+#include <unordered_map>
+
+namespace
+{
+   constexpr uint32_t s_Version = 1;
+   constexpr uint32_t s_InvalidIndex = UINT32_MAX;
+
+   void WriteVec3(JsonWriter& writer, const char* key, const glm::vec3& value)
+   {
+      writer.Key(key);
+      writer.BeginCompactArray();
+      writer.Value(value.x);
+      writer.Value(value.y);
+      writer.Value(value.z);
+      writer.EndArray();
+   }
+
+   bool ReadVec3(JsonReader& reader, glm::vec3& outValue)
+   {
+      reader.BeginArray();
+      for (int i = 0; i < 3; i++)
+      {
+         reader.NextElement();
+         reader.ReadFloat(outValue[i]);
+      }
+      return not reader.NextElement() && not reader.HasError();
+   }
+
+   bool ReadMaterial(JsonReader& reader, Material& outMaterial)
+   {
+      std::string key;
+      reader.BeginObject();
+      while (reader.NextKey(key))
+      {
+         if (key == "albedo")             ReadVec3(reader, outMaterial.m_Albedo);
+         else if (key == "roughness")     reader.ReadFloat(outMaterial.m_Roughness);
+         else if (key == "metallic")      reader.ReadFloat(outMaterial.m_Metallic);
+         else if (key == "emissionPower") reader.ReadFloat(outMaterial.m_EmissionPower);
+         else                             reader.Skip();
+      }
+      return not reader.HasError();
+   }
+
+   // Vertices come back flat, position.xyz, normal.xyz per vertex, so the caller can check the count
+   bool ReadMesh(JsonReader& reader, std::vector<float>& outVertexValues, std::vector<uint32_t>& outIndices, float& outSpatialSplitBudget)
+   {
+      std::string key;
+      reader.BeginObject();
+      while (reader.NextKey(key))
+      {
+         if (key == "vertices")
+         {
+            reader.BeginArray();
+            while (reader.NextElement())
+            {
+               reader.ReadFloat(outVertexValues.emplace_back());
+            }
+         }
+         else if (key == "indices")
+         {
+            reader.BeginArray();
+            while (reader.NextElement())
+            {
+               reader.ReadUInt(outIndices.emplace_back());
+            }
+         }
+         else if (key == "spatialSplitBudget")
+         {
+            reader.ReadFloat(outSpatialSplitBudget);
+         }
+         else
+         {
+            reader.Skip();
+         }
+      }
+      return not reader.HasError();
+   }
+}
+
+SceneSerializer::SceneSerializer(Scene* scene)
+   : m_Scene(scene)
+{
+}
+
+bool SceneSerializer::Serialize(const std::string& filepath)
+{
+   std::ofstream file(filepath);
+   if (not file.is_open())
+   {
+      m_Error = "Can't open '" + filepath + "' for writing";
+      return false;
+   }
+
+   // Views iterate the newest entity first, walk them backwards so a load recreates them in the same order
+   std::vector<Entity> entities;
+   std::vector<const Material*> materials;
+   std::vector<const Mesh*> meshes;
+   std::unordered_map<const Material*, uint32_t> materialIndices;
+   std::unordered_map<const Mesh*, uint32_t> meshIndices;
+
+   const auto& view = m_Scene->GetAllEntitiesWith<IDComponent>();
+   for (auto it = view.rbegin(); it != view.rend(); ++it)
+   {
+      Entity entity = { *it, m_Scene };
+      entities.push_back(entity);
+
+      if (entity.HasComponent<MaterialComponent>() && m_Scene->GetMaterial(entity.GetComponent<MaterialComponent>().m_Material) != nullptr)
+      {
+         const Material* material = m_Scene->GetMaterial(entity.GetComponent<MaterialComponent>().m_Material);
+         if (materialIndices.try_emplace(material, (uint32_t)materials.size()).second)
+         {
+            materials.push_back(material);
+         }
+      }
+
+      if (entity.HasComponent<MeshComponent>() && m_Scene->GetMesh(entity.GetComponent<MeshComponent>().m_Mesh) != nullptr)
+      {
+         const Mesh* mesh = m_Scene->GetMesh(entity.GetComponent<MeshComponent>().m_Mesh);
+         if (meshIndices.try_emplace(mesh, (uint32_t)meshes.size()).second)
+         {
+            meshes.push_back(mesh);
+         }
+      }
+   }
+
+   JsonWriter writer(file);
+   writer.BeginObject();
+   writer.Key("version");
+   writer.Value(s_Version);
+   writer.Key("bvhQuality");
+   writer.Value(std::string((m_Scene->GetBVHBuildQuality() == BVHBuildQuality::Fast) ? "fast" : "high"));
+
+   writer.Key("materials");
+   writer.BeginArray();
+   for (const Material* material : materials)
+   {
+      writer.BeginObject();
+      WriteVec3(writer, "albedo", material->m_Albedo);
+      writer.Key("roughness");
+      writer.Value(material->m_Roughness);
+      writer.Key("metallic");
+      writer.Value(material->m_Metallic);
+      writer.Key("emissionPower");
+      writer.Value(material->m_EmissionPower);
+      writer.EndObject();
+   }
+   writer.EndArray();
+
+   writer.Key("meshes");
+   writer.BeginArray();
+   for (const Mesh* mesh : meshes)
+   {
+      writer.BeginObject();
+      writer.Key("vertices");
+      writer.BeginCompactArray();
+      for (uint32_t i = 0; i < mesh->m_VertexCount; i++)
+      {
+         const Vertex& vertex = mesh->m_Vertices[i];
+         for (int axis = 0; axis < 3; axis++)
+         {
+            writer.Value(vertex.m_Position[axis]);
+         }
+         for (int axis = 0; axis < 3; axis++)
+         {
+            writer.Value(vertex.m_Normal[axis]);
+         }
+      }
+      writer.EndArray();
+
+      // Without the repetitions of triangles split by an SBVH, the loader builds it again
+      std::vector<uint32_t> uniqueIndices;
+      const uint32_t* indices = mesh->m_Indices;
+      uint32_t indexCount = mesh->m_TriangleCount * 3;
+      if (mesh->m_SpatialSplitBudget > 0.0f)
+      {
+         uniqueIndices = BVHBuilder::GetUniqueTriangles(mesh->m_Indices, mesh->m_TriangleCount);
+         indices = uniqueIndices.data();
+         indexCount = (uint32_t)uniqueIndices.size();
+
+         writer.Key("spatialSplitBudget");
+         writer.Value(mesh->m_SpatialSplitBudget);
+      }
+
+      writer.Key("indices");
+      writer.BeginCompactArray();
+      for (uint32_t i = 0; i < indexCount; i++)
+      {
+         writer.Value(indices[i]);
+      }
+      writer.EndArray();
+      writer.EndObject();
+   }
+   writer.EndArray();
+
+   writer.Key("entities");
+   writer.BeginArray();
+   for (Entity entity : entities)
+   {
+      writer.BeginObject();
+
+      // As a string, a JSON number can't hold every 64 bit value
+      writer.Key("uuid");
+      writer.Value(std::to_string((uint64_t)entity.GetUUID()));
+
+      if (entity.HasComponent<TagComponent>())
+      {
+         writer.Key("tag");
+         writer.Value(entity.GetComponent<TagComponent>().m_Tag);
+      }
+
+      if (entity.HasComponent<SphereComponent>())
+      {
+         const SphereComponent& sphere = entity.GetComponent<SphereComponent>();
+         writer.Key("sphere");
+         writer.BeginObject();
+         WriteVec3(writer, "position", sphere.m_Position);
+         writer.Key("radius");
+         writer.Value(sphere.m_Radius);
+         WriteVec3(writer, "velocity", sphere.m_Velocity);
+         writer.EndObject();
+      }
+
+      if (entity.HasComponent<MeshComponent>() && m_Scene->GetMesh(entity.GetComponent<MeshComponent>().m_Mesh) != nullptr)
+      {
+         writer.Key("mesh");
+         writer.Value(meshIndices.at(m_Scene->GetMesh(entity.GetComponent<MeshComponent>().m_Mesh)));
+      }
+
+      if (entity.HasComponent<MaterialComponent>() && m_Scene->GetMaterial(entity.GetComponent<MaterialComponent>().m_Material) != nullptr)
+      {
+         writer.Key("material");
+         writer.Value(materialIndices.at(m_Scene->GetMaterial(entity.GetComponent<MaterialComponent>().m_Material)));
+      }
+
+      writer.EndObject();
+   }
+   writer.EndArray();
+
+   writer.EndObject();
+   file << '\n';
+
+   if (not file.good())
+   {
+      m_Error = "Failed to write '" + filepath + "'";
+      return false;
+   }
+
+   return true;
+}
+
+bool SceneSerializer::Deserialize(const std::string& filepath)
+{
+   std::ifstream file(filepath, std::ios::binary);
+   if (not file.is_open())
+   {
+      m_Error = "Can't open '" + filepath + "'";
+      return false;
+   }
+
+   // Entities may come before the materials/meshes they use, those references are resolved at the end
+   struct PendingReference
+   {
+      Entity Target;
+      uint32_t MaterialIndex;
+      uint32_t MeshIndex;
+   };
+
+   std::vector<AssetHandle<Material>> materials;
+   std::vector<AssetHandle<Mesh>> meshes;
+   std::vector<PendingReference> pendingReferences;
+
+   JsonReader reader(file);
+   std::string key;
+   reader.BeginObject();
+   while (reader.NextKey(key))
+   {
+      if (key == "version")
+      {
+         uint32_t version = 0;
+         if (reader.ReadUInt(version) && version != s_Version)
+         {
+            m_Error = "Unsupported scene version " + std::to_string(version);
+            return false;
+         }
+      }
+      else if (key == "bvhQuality")
+      {
+         // Written before the meshes, so they are built with it
+         std::string quality;
+         if (reader.ReadString(quality))
+         {
+            m_Scene->SetBVHBuildQuality((quality == "fast") ? BVHBuildQuality::Fast : BVHBuildQuality::HighQuality);
+         }
+      }
+      else if (key == "materials")
+      {
+         reader.BeginArray();
+         while (reader.NextElement())
+         {
+            Material material;
+            if (ReadMaterial(reader, material))
+            {
+               materials.push_back(m_Scene->CreateMaterial(material));
+            }
+         }
+      }
+      else if (key == "meshes")
+      {
+         reader.BeginArray();
+         while (reader.NextElement())
+         {
+            std::vector<float> values;
+            std::vector<uint32_t> indices;
+            BVHBuildSettings settings;
+            settings.Quality = m_Scene->GetBVHBuildQuality();
+            if (not ReadMesh(reader, values, indices, settings.SpatialSplitBudget))
+            {
+               break;
+            }
+
+            if (values.size() % 6 != 0)
+            {
+               m_Error = "Mesh " + std::to_string(meshes.size()) + " has a vertex value count that isn't a multiple of 6";
+               return false;
+            }
+
+            std::vector<Vertex> vertices(values.size() / 6);
+            for (size_t i = 0; i < vertices.size(); i++)
+            {
+               vertices[i].m_Position = { values[i * 6 + 0], values[i * 6 + 1], values[i * 6 + 2] };
+               vertices[i].m_Normal = { values[i * 6 + 3], values[i * 6 + 4], values[i * 6 + 5] };
+            }
+
+            if (indices.size() % 3 != 0)
+            {
+               m_Error = "Mesh " + std::to_string(meshes.size()) + " has an index count that isn't a multiple of 3";
+               return false;
+            }
+
+            for (uint32_t index : indices)
+            {
+               if (index >= vertices.size())
+               {
+                  m_Error = "Mesh " + std::to_string(meshes.size()) + " has an index out of range";
+                  return false;
+               }
+            }
+
+            meshes.push_back(m_Scene->CreateMesh(std::move(vertices), std::move(indices), settings));
+         }
+      }
+      else if (key == "entities")
+      {
+         reader.BeginArray();
+         while (reader.NextElement())
+         {
+            uint64_t uuid = 0;
+            std::string uuidText, tag;
+            bool hasSphere = false;
+            SphereComponent sphere({ 0.0f, 0.0f, 0.0f }, 1.0f);
+            uint32_t materialIndex = s_InvalidIndex, meshIndex = s_InvalidIndex;
+
+            reader.BeginObject();
+            while (reader.NextKey(key))
+            {
+               if (key == "uuid")
+               {
+                  reader.ReadString(uuidText);
+               }
+               else if (key == "tag")
+               {
+                  reader.ReadString(tag);
+               }
+               else if (key == "sphere")
+               {
+                  hasSphere = true;
+                  reader.BeginObject();
+                  while (reader.NextKey(key))
+                  {
+                     if (key == "position")      ReadVec3(reader, sphere.m_Position);
+                     else if (key == "radius")   reader.ReadFloat(sphere.m_Radius);
+                     else if (key == "velocity") ReadVec3(reader, sphere.m_Velocity);
+                     else                        reader.Skip();
+                  }
+               }
+               else if (key == "material")
+               {
+                  reader.ReadUInt(materialIndex);
+               }
+               else if (key == "mesh")
+               {
+                  reader.ReadUInt(meshIndex);
+               }
+               else
+               {
+                  reader.Skip();
+               }
+            }
+
+            if (reader.HasError())
+            {
+               break;
+            }
+
+            if (not uuidText.empty())
+            {
+               const char* end = uuidText.data() + uuidText.size();
+               auto [last, error] = std::from_chars(uuidText.data(), end, uuid);
+               if (error != std::errc() || last != end)
+               {
+                  m_Error = "Entity '" + tag + "' has an invalid uuid '" + uuidText + "'";
+                  return false;
+               }
+            }
+
+            // Entities without a UUID get a new one
+            Entity entity = (uuid != 0) ? m_Scene->CreateEntityWithUUID(uuid, tag) : m_Scene->CreateEntity(tag);
+            if (hasSphere)
+            {
+               entity.AddComponent<SphereComponent>(sphere);
+            }
+
+            if (materialIndex != s_InvalidIndex || meshIndex != s_InvalidIndex)
+            {
+               pendingReferences.push_back({ entity, materialIndex, meshIndex });
+            }
+         }
+      }
+      else
+      {
+         reader.Skip();
+      }
+   }
+
+   if (reader.HasError())
+   {
+      m_Error = filepath + ", " + reader.GetError();
+      return false;
+   }
+
+   for (PendingReference& reference : pendingReferences)
+   {
+      if ((reference.MaterialIndex != s_InvalidIndex && reference.MaterialIndex >= materials.size()) ||
+          (reference.MeshIndex != s_InvalidIndex && reference.MeshIndex >= meshes.size()))
+      {
+         m_Error = "Entity '" + reference.Target.GetComponent<TagComponent>().m_Tag + "' references a material or mesh that doesn't exist";
+         return false;
+      }
+
+      if (reference.MaterialIndex != s_InvalidIndex)
+      {
+         reference.Target.AddComponent<MaterialComponent>(materials[reference.MaterialIndex]);
+      }
+      if (reference.MeshIndex != s_InvalidIndex)
+      {
+         reference.Target.AddComponent<MeshComponent>(meshes[reference.MeshIndex]);
+      }
+   }
+
+   return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+class Scene;
+
+// Human readable scene description (JSON) for authoring tools. Every entity is written with its UUID/tag and
+// whichever of the sphere/mesh/material components it has, materials and meshes are shared by index:
+//   { "version": 1, "bvhQuality": "high", "materials": [...], "meshes": [...], "entities": [{ "uuid": "..", "tag": "..", "sphere": {..}, "material": 0 }] }
+// The reader streams the file, entities are created while reading. See SceneBinarySerializer for the fast format
+class SceneSerializer
+{
+public:
+   SceneSerializer(Scene* scene);
+
+   bool Serialize(const std::string& filepath);
+   // Adds the entities of the file to the scene, the reason of a failure is available from GetError()
+   bool Deserialize(const std::string& filepath);
+
+   const std::string& GetError() const { return m_Error; }
+
+private:
+   Scene* m_Scene = nullptr;
+   std::string m_Error;
+};
@@ -99,20 +99,31 @@ void SceneHierarchyPanel::DrawComponents(Entity entity)
       ImGui::Separator();
       SphereComponent& sc = entity.GetComponent<SphereComponent>();
 
-      ImGui::DragFloat3("Position", glm::value_ptr(sc.m_Position), 0.1f);
-      ImGui::DragFloat("Radius", &(sc.m_Radius), 0.1f);
+      bool changed = false;
+      changed |= ImGui::DragFloat3("Position", glm::value_ptr(sc.m_Position), 0.1f);
+      changed |= ImGui::DragFloat("Radius", &(sc.m_Radius), 0.1f);
+      changed |= ImGui::DragFloat3("Velocity", glm::value_ptr(sc.m_Velocity), 0.1f);
+      if (changed)
+      {
+         entity.PatchComponent<SphereComponent>();
+      }
    }
 
-   if (entity.HasComponent<MaterialComponent>())
+   if (entity.HasComponent<MaterialComponent>() && m_Scene->GetMaterial(entity.GetComponent<MaterialComponent>().m_Material) != nullptr)
    {
       ImGui::Separator();
       MaterialComponent& mc = entity.GetComponent<MaterialComponent>();
 
-      Material& material = *mc.m_Material;
-      ImGui::ColorEdit3("Albedo", glm::value_ptr(material.m_Albedo), 0.1f);
-      ImGui::DragFloat("Roughness", &(material.m_Roughness), 0.05, 0.0f, 1.0f);
-      ImGui::DragFloat("Metallic", &(material.m_Metallic), 0.05, 0.0f, 1.0f);
-      ImGui::DragFloat("Emission Power", &(material.m_EmissionPower), 0.05, 0.0f, FLT_MAX);
+      Material& material = *m_Scene->GetMaterial(mc.m_Material);
+      bool changed = false;
+      changed |= ImGui::ColorEdit3("Albedo", glm::value_ptr(material.m_Albedo), 0.1f);
+      changed |= ImGui::DragFloat("Roughness", &(material.m_Roughness), 0.05, 0.0f, 1.0f);
+      changed |= ImGui::DragFloat("Metallic", &(material.m_Metallic), 0.05, 0.0f, 1.0f);
+      changed |= ImGui::DragFloat("Emission Power", &(material.m_EmissionPower), 0.05, 0.0f, FLT_MAX);
+      if (changed)
+      {
+         entity.PatchComponent<MaterialComponent>();
+      }
    }
    //ImGui::DragInt("Material", &sphere.MaterialIndex, 1.0f, 0, (int)m_Scene.m_Materials.size() - 1);
 }
@@ -12,6 +12,10 @@ public:
 
    void SetScene(Scene* scene);
 
+   // Also set by picking in the viewport
+   void SetSelectedEntity(Entity entity) { m_SelectedEntity = entity; }
+   Entity GetSelectedEntity() const { return m_SelectedEntity; }
+
    void RenderSceneHierarchy();
 private:
    void DrawEntityNode(Entity entity);
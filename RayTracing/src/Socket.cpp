@@ -0,0 +1,265 @@
+#include "Socket.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+   #define NOMINMAX
+   #include <WinSock2.h>
+   #include <WS2tcpip.h>
+#else
+   #include <netdb.h>
+   #include <netinet/in.h>
+   #include <netinet/tcp.h>
+   #include <poll.h>
+   #include <sys/socket.h>
+   #include <sys/time.h>
+   #include <unistd.h>
+#endif
+
+namespace
+{
+#if defined(_WIN32)
+   using SocketHandle = SOCKET;
+   using SocketLength = int;
+
+   void CloseSocketHandle(intptr_t handle) { closesocket((SOCKET)handle); }
+
+   bool Initialize()
+   {
+      static const bool s_Initialized = []
+      {
+         WSADATA data;
+         return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+      }();
+      return s_Initialized;
+   }
+#else
+   using SocketHandle = int;
+   using SocketLength = socklen_t;
+
+   void CloseSocketHandle(intptr_t handle) { close((int)handle); }
+
+   bool Initialize() { return true; }
+#endif
+
+   // A write to a connection the other side closed fails instead of raising SIGPIPE
+#if defined(MSG_NOSIGNAL)
+   constexpr int s_SendFlags = MSG_NOSIGNAL;
+#else
+   constexpr int s_SendFlags = 0;
+#endif
+
+   // Messages are written in one piece, sent right away instead of waiting for more to fill a packet
+   void DisableNagle(SocketHandle handle)
+   {
+      int enable = 1;
+      setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&enable, sizeof(enable));
+   }
+
+   // Probes an idle connection, so one whose peer lost power or network breaks after about a minute instead of never
+   void EnableKeepAlive(SocketHandle handle)
+   {
+      int enable = 1;
+      setsockopt(handle, SOL_SOCKET, SO_KEEPALIVE, (const char*)&enable, sizeof(enable));
+#if defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL) && defined(TCP_KEEPCNT)
+      int idleSeconds = 30, intervalSeconds = 10, probeCount = 3;
+      setsockopt(handle, IPPROTO_TCP, TCP_KEEPIDLE, (const char*)&idleSeconds, sizeof(idleSeconds));
+      setsockopt(handle, IPPROTO_TCP, TCP_KEEPINTVL, (const char*)&intervalSeconds, sizeof(intervalSeconds));
+      setsockopt(handle, IPPROTO_TCP, TCP_KEEPCNT, (const char*)&probeCount, sizeof(probeCount));
+#endif
+   }
+}
+
+Socket Socket::Listen(uint16_t port)
+{
+   if (not Initialize())
+   {
+      return Socket();
+   }
+
+   SocketHandle handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+   Socket listener((intptr_t)handle);
+   if (not listener.IsValid())
+   {
+      return Socket();
+   }
+
+   // A coordinator restarted right away can take its port back
+   int reuse = 1;
+   setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+   sockaddr_in address = {};
+   address.sin_family = AF_INET;
+   address.sin_addr.s_addr = htonl(INADDR_ANY);
+   address.sin_port = htons(port);
+   if (bind(handle, (const sockaddr*)&address, sizeof(address)) != 0 || listen(handle, SOMAXCONN) != 0)
+   {
+      return Socket();
+   }
+   return listener;
+}
+
+Socket Socket::Connect(const std::string& host, uint16_t port)
+{
+   if (not Initialize())
+   {
+      return Socket();
+   }
+
+   addrinfo hints = {};
+   hints.ai_family = AF_INET;
+   hints.ai_socktype = SOCK_STREAM;
+   hints.ai_protocol = IPPROTO_TCP;
+   addrinfo* addresses = nullptr;
+   if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+   {
+      return Socket();
+   }
+
+   Socket connection;
+   for (addrinfo* address = addresses; address != nullptr; address = address->ai_next)
+   {
+      SocketHandle handle = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+      connection = Socket((intptr_t)handle);
+      if (connection.IsValid() && connect(handle, address->ai_addr, (SocketLength)address->ai_addrlen) == 0)
+      {
+         DisableNagle(handle);
+         EnableKeepAlive(handle);
+         break;
+      }
+      connection.Close();
+   }
+   freeaddrinfo(addresses);
+   return connection;
+}
+
+bool Socket::Poll(const std::vector<const Socket*>& sockets, int timeoutMilliseconds, std::vector<bool>& outReadable)
+{
+#if defined(_WIN32)
+   std::vector<WSAPOLLFD> descriptors(sockets.size());
+#else
+   std::vector<pollfd> descriptors(sockets.size());
+#endif
+   for (size_t i = 0; i < sockets.size(); i++)
+   {
+      descriptors[i].fd = (SocketHandle)sockets[i]->m_Handle;
+      descriptors[i].events = POLLIN;
+      descriptors[i].revents = 0;
+   }
+
+#if defined(_WIN32)
+   int ready = WSAPoll(descriptors.data(), (ULONG)descriptors.size(), timeoutMilliseconds);
+#else
+   int ready = poll(descriptors.data(), (nfds_t)descriptors.size(), timeoutMilliseconds);
+#endif
+
+   // A closed or broken connection counts as readable, the read that follows fails
+   outReadable.assign(sockets.size(), false);
+   for (size_t i = 0; i < sockets.size() && ready > 0; i++)
+   {
+      outReadable[i] = (descriptors[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+   }
+   return ready > 0;
+}
+
+Socket::Socket(Socket&& other) noexcept
+   : m_Handle(other.m_Handle)
+{
+   other.m_Handle = s_InvalidHandle;
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept
+{
+   if (this != &other)
+   {
+      Close();
+      m_Handle = other.m_Handle;
+      other.m_Handle = s_InvalidHandle;
+   }
+   return *this;
+}
+
+Socket::~Socket()
+{
+   Close();
+}
+
+Socket Socket::Accept()
+{
+   SocketHandle handle = accept((SocketHandle)m_Handle, nullptr, nullptr);
+   Socket connection((intptr_t)handle);
+   if (connection.IsValid())
+   {
+      DisableNagle(handle);
+      EnableKeepAlive(handle);
+   }
+   return connection;
+}
+
+void Socket::SetTimeout(uint32_t milliseconds)
+{
+#if defined(_WIN32)
+   DWORD timeout = milliseconds;
+#else
+   timeval timeout = {};
+   timeout.tv_sec = milliseconds / 1000;
+   timeout.tv_usec = (milliseconds % 1000) * 1000;
+#endif
+   setsockopt((SocketHandle)m_Handle, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+   setsockopt((SocketHandle)m_Handle, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+bool Socket::Send(const void* data, uint64_t size)
+{
+   const char* bytes = (const char*)data;
+   while (size > 0)
+   {
+      // Sent in pieces that fit the int sizes of the Windows API
+      const int chunk = (int)std::min<uint64_t>(size, 1 << 30);
+      const int sent = (int)send((SocketHandle)m_Handle, bytes, chunk, s_SendFlags);
+      if (sent <= 0)
+      {
+         return false;
+      }
+      bytes += sent;
+      size -= (uint64_t)sent;
+   }
+   return true;
+}
+
+bool Socket::Receive(void* data, uint64_t size)
+{
+   char* bytes = (char*)data;
+   while (size > 0)
+   {
+      const int chunk = (int)std::min<uint64_t>(size, 1 << 30);
+      const int received = (int)recv((SocketHandle)m_Handle, bytes, chunk, 0);
+      if (received <= 0)
+      {
+         return false;
+      }
+      bytes += received;
+      size -= (uint64_t)received;
+   }
+   return true;
+}
+
+uint16_t Socket::GetPort() const
+{
+   sockaddr_in address = {};
+   SocketLength length = sizeof(address);
+   if (getsockname((SocketHandle)m_Handle, (sockaddr*)&address, &length) != 0)
+   {
+      return 0;
+   }
+   return ntohs(address.sin_port);
+}
+
+void Socket::Close()
+{
+   if (IsValid())
+   {
+      CloseSocketHandle(m_Handle);
+      m_Handle = s_InvalidHandle;
+   }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A blocking TCP socket, either listening or connected. Closed when destroyed
+class Socket
+{
+public:
+   // Listens on every interface, port 0 picks a free one (see GetPort). Invalid when the port can't be bound
+   static Socket Listen(uint16_t port);
+   // Invalid when nothing accepts the connection
+   static Socket Connect(const std::string& host, uint16_t port);
+
+   // Waits up to timeoutMilliseconds until any of the sockets can be read without blocking: a listening socket has a
+   // connection to accept, a connected one has data or was closed. Returns false on timeout
+   static bool Poll(const std::vector<const Socket*>& sockets, int timeoutMilliseconds, std::vector<bool>& outReadable);
+
+   Socket() = default;
+   Socket(Socket&& other) noexcept;
+   Socket& operator=(Socket&& other) noexcept;
+   Socket(const Socket&) = delete;
+   Socket& operator=(const Socket&) = delete;
+   ~Socket();
+
+   Socket Accept();
+
+   // Send and Receive fail once no bytes moved for this long, instead of waiting on a peer that hangs. 0 waits forever
+   void SetTimeout(uint32_t milliseconds);
+
+   // Block until all the bytes went out or came in. False once the connection is closed or broken
+   bool Send(const void* data, uint64_t size);
+   bool Receive(void* data, uint64_t size);
+
+   bool IsValid() const { return m_Handle != s_InvalidHandle; }
+   uint16_t GetPort() const;
+   void Close();
+private:
+   // A SOCKET on Windows, a file descriptor elsewhere
+   static constexpr intptr_t s_InvalidHandle = -1;
+
+   explicit Socket(intptr_t handle)
+      : m_Handle(handle) {}
+
+   intptr_t m_Handle = s_InvalidHandle;
+};
@@ -0,0 +1,57 @@
+#include "TiledRenderer.h"
+
+#include "ImageWriter.h"
+#include "Renderer.h"
+
+bool TiledRenderer::Render(Scene& scene, const Camera& camera, const Options& options, const std::string& filepath,
+                           const ProgressCallback& progress)
+{
+   TiledImageWriter writer;
+   if (not writer.Open(filepath, options.Width, options.Height, options.TileSize))
+   {
+      return false;
+   }
+
+   Renderer renderer(true);
+   // Without the direction cache the camera doesn't recompute it for every crop window and size
+   Camera tileCamera = camera;
+   tileCamera.SetRayGenerationMode(RayGenerationMode::OnTheFly);
+
+   const uint32_t tilesAcross = writer.GetTilesAcross();
+   const uint32_t tilesDown = writer.GetTilesDown();
+   const uint32_t tileCount = tilesAcross * tilesDown;
+   for (uint32_t tileY = 0; tileY < tilesDown; tileY++)
+   {
+      for (uint32_t tileX = 0; tileX < tilesAcross; tileX++)
+      {
+         // The file counts tile rows from the top, the renderer counts pixel rows from the bottom
+         const uint32_t offsetX = tileX * options.TileSize;
+         const uint32_t top = tileY * options.TileSize;
+         const uint32_t width = glm::min(options.TileSize, options.Width - offsetX);
+         const uint32_t height = glm::min(options.TileSize, options.Height - top);
+         const uint32_t offsetY = options.Height - top - height;
+
+         tileCamera.SetCropWindow(offsetX, offsetY, options.Width, options.Height);
+         tileCamera.Resize(width, height);
+         renderer.Resize(width, height);
+         renderer.ResetFrameIndex();
+
+         for (uint32_t sample = 0; sample < options.Samples; sample++)
+         {
+            renderer.Render(scene, tileCamera);
+         }
+
+         if (not writer.WriteTile(tileX, tileY, renderer.GetImageData(), width, height))
+         {
+            return false;
+         }
+
+         if (progress)
+         {
+            progress(tileY * tilesAcross + tileX + 1, tileCount);
+         }
+      }
+   }
+
+   return writer.Close();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Camera.h"
+#include "Scene/Scene.h"
+
+#include <functional>
+#include <string>
+
+// Renders images larger than the memory of the machine would allow. The image is cut into tiles, every tile is rendered
+// with all its samples by a renderer the size of one tile and streamed to a tiled TIFF, the full image is never in memory
+class TiledRenderer
+{
+public:
+   struct Options
+   {
+      uint32_t Width = 0, Height = 0;
+      uint32_t TileSize = 256; // Pixels, a multiple of 16
+      uint32_t Samples = 64;
+   };
+
+   // Called after each tile
+   using ProgressCallback = std::function<void(uint32_t tilesDone, uint32_t tileCount)>;
+
+   // The tiles match the same image rendered at once (see Camera::SetCropWindow). False if the file can't be written
+   static bool Render(Scene& scene, const Camera& camera, const Options& options, const std::string& filepath,
+                      const ProgressCallback& progress = {});
+};
@@ -1,6 +1,7 @@
 #pragma once
 
-#include <xhash>
+#include <cstdint>
+#include <functional>
 
 class UUID
 {
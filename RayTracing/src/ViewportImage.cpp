@@ -0,0 +1,292 @@
+#include "ViewportImage.h"
+
+#include "Walnut/Application.h"
+
+#include "imgui.h"
+#include "backends/imgui_impl_vulkan.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Utils
+{
+   static uint32_t GetVulkanMemoryType(VkMemoryPropertyFlags properties, uint32_t typeBits)
+   {
+      VkPhysicalDeviceMemoryProperties memoryProperties;
+      vkGetPhysicalDeviceMemoryProperties(Walnut::Application::GetPhysicalDevice(), &memoryProperties);
+      for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+      {
+         if ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties && (typeBits & (1 << i)))
+         {
+            return i;
+         }
+      }
+      return 0xffffffff;
+   }
+}
+
+ViewportImage::ViewportImage(uint32_t width, uint32_t height)
+   : m_Width(width), m_Height(height)
+{
+   Allocate();
+}
+
+ViewportImage::~ViewportImage()
+{
+   Release();
+}
+
+void ViewportImage::Resize(uint32_t width, uint32_t height)
+{
+   if (m_Image != nullptr && m_Width == width && m_Height == height)
+   {
+      return;
+   }
+
+   m_Width = width;
+   m_Height = height;
+
+   Release();
+   Allocate();
+}
+
+void ViewportImage::MarkDirty(uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY)
+{
+   maxX = std::min(maxX, m_Width);
+   maxY = std::min(maxY, m_Height);
+   if (minX >= maxX || minY >= maxY)
+   {
+      return;
+   }
+
+   for (uint32_t tileY = minY / TileSize; tileY <= (maxY - 1) / TileSize; tileY++)
+   {
+      for (uint32_t tileX = minX / TileSize; tileX <= (maxX - 1) / TileSize; tileX++)
+      {
+         m_DirtyTiles[tileX + (tileY * m_TileCountX)] = 1;
+      }
+   }
+}
+
+void ViewportImage::Upload(const uint32_t* data)
+{
+   // Runs of dirty tiles within a tile row become one rectangle
+   m_CopyRegions.clear();
+   m_UploadedBytes = 0;
+   for (uint32_t tileY = 0; tileY < m_TileCountY; tileY++)
+   {
+      uint32_t tileX = 0;
+      while (tileX < m_TileCountX)
+      {
+         if (not m_DirtyTiles[tileX + (tileY * m_TileCountX)])
+         {
+            tileX++;
+            continue;
+         }
+
+         uint32_t endTileX = tileX;
+         while (endTileX < m_TileCountX && m_DirtyTiles[endTileX + (tileY * m_TileCountX)])
+         {
+            m_DirtyTiles[endTileX + (tileY * m_TileCountX)] = 0;
+            endTileX++;
+         }
+
+         const uint32_t minX = tileX * TileSize;
+         const uint32_t minY = tileY * TileSize;
+         const uint32_t maxX = std::min(endTileX * TileSize, m_Width);
+         const uint32_t maxY = std::min(minY + TileSize, m_Height);
+         for (uint32_t y = minY; y < maxY; y++)
+         {
+            const size_t offset = minX + ((size_t)y * m_Width);
+            memcpy(m_StagingData + offset, data + offset, (maxX - minX) * sizeof(uint32_t));
+         }
+
+         VkBufferImageCopy region = {};
+         region.bufferOffset = (minX + ((VkDeviceSize)minY * m_Width)) * sizeof(uint32_t);
+         region.bufferRowLength = m_Width;
+         region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+         region.imageSubresource.layerCount = 1;
+         region.imageOffset = { (int32_t)minX, (int32_t)minY, 0 };
+         region.imageExtent = { maxX - minX, maxY - minY, 1 };
+         m_CopyRegions.push_back(region);
+         m_UploadedBytes += (uint64_t)(maxX - minX) * (maxY - minY) * sizeof(uint32_t);
+
+         tileX = endTileX;
+      }
+   }
+
+   if (m_CopyRegions.empty())
+   {
+      return;
+   }
+
+   // The staging memory is host coherent, the writes above are visible to the copy once it is submitted
+   VkCommandBuffer commandBuffer = Walnut::Application::GetCommandBuffer(true);
+
+   VkImageMemoryBarrier copyBarrier = {};
+   copyBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+   copyBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   // The tiles that aren't uploaded have to survive the transition
+   copyBarrier.oldLayout = m_HasContents ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+   copyBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+   copyBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   copyBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   copyBarrier.image = m_Image;
+   copyBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+   copyBarrier.subresourceRange.levelCount = 1;
+   copyBarrier.subresourceRange.layerCount = 1;
+   vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                        0, nullptr, 0, nullptr, 1, &copyBarrier);
+
+   vkCmdCopyBufferToImage(commandBuffer, m_StagingBuffer, m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)m_CopyRegions.size(), m_CopyRegions.data());
+
+   VkImageMemoryBarrier useBarrier = {};
+   useBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+   useBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   useBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+   useBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+   useBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+   useBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   useBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+   useBarrier.image = m_Image;
+   useBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+   useBarrier.subresourceRange.levelCount = 1;
+   useBarrier.subresourceRange.layerCount = 1;
+   vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                        0, nullptr, 0, nullptr, 1, &useBarrier);
+
+   // Waits for the copy, so the staging buffer can be written again right away
+   Walnut::Application::FlushCommandBuffer(commandBuffer);
+   m_HasContents = true;
+}
+
+void ViewportImage::Allocate()
+{
+   VkDevice device = Walnut::Application::GetDevice();
+   VkResult err;
+
+   // Image
+   {
+      VkImageCreateInfo info = {};
+      info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      info.imageType = VK_IMAGE_TYPE_2D;
+      info.format = VK_FORMAT_R8G8B8A8_UNORM;
+      info.extent.width = m_Width;
+      info.extent.height = m_Height;
+      info.extent.depth = 1;
+      info.mipLevels = 1;
+      info.arrayLayers = 1;
+      info.samples = VK_SAMPLE_COUNT_1_BIT;
+      info.tiling = VK_IMAGE_TILING_OPTIMAL;
+      info.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+      info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      err = vkCreateImage(device, &info, nullptr, &m_Image);
+      check_vk_result(err);
+
+      VkMemoryRequirements requirements;
+      vkGetImageMemoryRequirements(device, m_Image, &requirements);
+      VkMemoryAllocateInfo allocateInfo = {};
+      allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      allocateInfo.allocationSize = requirements.size;
+      allocateInfo.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, requirements.memoryTypeBits);
+      err = vkAllocateMemory(device, &allocateInfo, nullptr, &m_Memory);
+      check_vk_result(err);
+      err = vkBindImageMemory(device, m_Image, m_Memory, 0);
+      check_vk_result(err);
+   }
+
+   // Image view
+   {
+      VkImageViewCreateInfo info = {};
+      info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      info.image = m_Image;
+      info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      info.format = VK_FORMAT_R8G8B8A8_UNORM;
+      info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      info.subresourceRange.levelCount = 1;
+      info.subresourceRange.layerCount = 1;
+      err = vkCreateImageView(device, &info, nullptr, &m_ImageView);
+      check_vk_result(err);
+   }
+
+   // Sampler
+   {
+      VkSamplerCreateInfo info = {};
+      info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+      info.magFilter = VK_FILTER_LINEAR;
+      info.minFilter = VK_FILTER_LINEAR;
+      info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+      info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+      info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+      info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+      info.minLod = -1000;
+      info.maxLod = 1000;
+      info.maxAnisotropy = 1.0f;
+      err = vkCreateSampler(device, &info, nullptr, &m_Sampler);
+      check_vk_result(err);
+   }
+
+   m_DescriptorSet = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture(m_Sampler, m_ImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+   // Staging buffer, mapped until it is released
+   {
+      VkBufferCreateInfo info = {};
+      info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+      info.size = (VkDeviceSize)m_Width * m_Height * sizeof(uint32_t);
+      info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+      info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      err = vkCreateBuffer(device, &info, nullptr, &m_StagingBuffer);
+      check_vk_result(err);
+
+      // Every implementation has a host visible and coherent memory type, so there are no ranges to flush
+      VkMemoryRequirements requirements;
+      vkGetBufferMemoryRequirements(device, m_StagingBuffer, &requirements);
+      VkMemoryAllocateInfo allocateInfo = {};
+      allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      allocateInfo.allocationSize = requirements.size;
+      allocateInfo.memoryTypeIndex = Utils::GetVulkanMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, requirements.memoryTypeBits);
+      err = vkAllocateMemory(device, &allocateInfo, nullptr, &m_StagingBufferMemory);
+      check_vk_result(err);
+      err = vkBindBufferMemory(device, m_StagingBuffer, m_StagingBufferMemory, 0);
+      check_vk_result(err);
+
+      err = vkMapMemory(device, m_StagingBufferMemory, 0, VK_WHOLE_SIZE, 0, (void**)&m_StagingData);
+      check_vk_result(err);
+   }
+
+   m_HasContents = false;
+   m_TileCountX = (m_Width + TileSize - 1) / TileSize;
+   m_TileCountY = (m_Height + TileSize - 1) / TileSize;
+   m_DirtyTiles.assign(m_TileCountX * m_TileCountY, 1);
+}
+
+void ViewportImage::Release()
+{
+   if (m_StagingData != nullptr)
+   {
+      vkUnmapMemory(Walnut::Application::GetDevice(), m_StagingBufferMemory);
+      m_StagingData = nullptr;
+   }
+
+   // The image may still be drawn by a frame in flight
+   Walnut::Application::SubmitResourceFree([sampler = m_Sampler, imageView = m_ImageView, image = m_Image, memory = m_Memory,
+                                            stagingBuffer = m_StagingBuffer, stagingBufferMemory = m_StagingBufferMemory]()
+   {
+      VkDevice device = Walnut::Application::GetDevice();
+
+      vkDestroySampler(device, sampler, nullptr);
+      vkDestroyImageView(device, imageView, nullptr);
+      vkDestroyImage(device, image, nullptr);
+      vkFreeMemory(device, memory, nullptr);
+      vkDestroyBuffer(device, stagingBuffer, nullptr);
+      vkFreeMemory(device, stagingBufferMemory, nullptr);
+   });
+
+   m_Sampler = nullptr;
+   m_ImageView = nullptr;
+   m_Image = nullptr;
+   m_Memory = nullptr;
+   m_StagingBuffer = nullptr;
+   m_StagingBufferMemory = nullptr;
+}
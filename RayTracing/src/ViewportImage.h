@@ -0,0 +1,57 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+#include <cstdint>
+#include <vector>
+
+// The RGBA8 image the viewport shows. Unlike Walnut::Image the staging buffer stays mapped for the lifetime of the image and
+// an upload only copies the tiles marked dirty since the previous one, as a single copy command of several rectangles
+class ViewportImage
+{
+public:
+   static constexpr uint32_t TileSize = 64; // Pixels
+
+   ViewportImage(uint32_t width, uint32_t height);
+   ViewportImage(const ViewportImage&) = delete;
+   ViewportImage& operator=(const ViewportImage&) = delete;
+   ~ViewportImage();
+
+   // All tiles are dirty after a resize
+   void Resize(uint32_t width, uint32_t height);
+
+   // Pixels [Min, Max) changed
+   void MarkDirty(uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY);
+   void MarkAllDirty() { MarkDirty(0, 0, m_Width, m_Height); }
+
+   // data is the whole image, only its dirty tiles are read
+   void Upload(const uint32_t* data);
+
+   VkDescriptorSet GetDescriptorSet() const { return m_DescriptorSet; }
+   uint32_t GetWidth() const { return m_Width; }
+   uint32_t GetHeight() const { return m_Height; }
+   // Of the last Upload
+   uint64_t GetUploadedBytes() const { return m_UploadedBytes; }
+private:
+   void Allocate();
+   void Release();
+
+   uint32_t m_Width = 0, m_Height = 0;
+
+   VkImage m_Image = nullptr;
+   VkImageView m_ImageView = nullptr;
+   VkDeviceMemory m_Memory = nullptr;
+   VkSampler m_Sampler = nullptr;
+   VkDescriptorSet m_DescriptorSet = nullptr;
+   bool m_HasContents = false; // The image is in shader read layout and keeps the tiles that aren't uploaded
+
+   // Laid out like the image, so a tile is copied to the same offset it has in the image data
+   VkBuffer m_StagingBuffer = nullptr;
+   VkDeviceMemory m_StagingBufferMemory = nullptr;
+   uint32_t* m_StagingData = nullptr;
+
+   uint32_t m_TileCountX = 0, m_TileCountY = 0;
+   std::vector<uint8_t> m_DirtyTiles;
+   std::vector<VkBufferImageCopy> m_CopyRegions;
+   uint64_t m_UploadedBytes = 0;
+};
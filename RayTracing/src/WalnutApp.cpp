@@ -7,127 +7,209 @@
 #include "Walnut/Timer.h"
 
 // Raytracing specific
+#include "HeadlessApp.h"
+#include "ImageExporter.h"
+#include "Profiler.h"
+#include "ProfilerPanel.h"
 #include "SceneHierarchyPanel.h"
 #include "Renderer.h"
 #include "Camera.h"
+#include "ViewportImage.h"
 
 // ECS
 #include "Scene/Scene.h"
 #include "Scene/Components.h"
 #include "Scene/Entity.h"
+#include "Scene/SceneBinarySerializer.h"
+#include "Scene/SceneLibrary.h"
+#include "Scene/SceneSerializer.h"
+
+#include <cinttypes>
+#include <cstring>
+#include <filesystem>
 
 using namespace Walnut;
 class ExampleLayer : public Walnut::Layer
 {
 public:
 
-   ExampleLayer()
+   ExampleLayer(const std::string& sceneFilepath)
       :  m_Camera(45.0f, 0.1f, 100.0f), 
-         m_SceneHierarchyPanel(&m_Scene)
+         m_SceneHierarchyPanel(m_Scene.get())
    {
-#pragma region CreateMaterials
+      if (sceneFilepath.empty() || not OpenScene(sceneFilepath))
       {
-         Material purpleMat;
-         purpleMat.m_Albedo = { 1.0f, 0.0f, 1.0f };
-         purpleMat.m_Roughness = 0.4f;
-         purpleMat.m_Metallic = 0.0f;
-         purpleMat.m_EmissionPower = 0.0f;
-         m_Materials.push_back(purpleMat);
+         SceneLibrary::Populate(*m_Scene, CanonicalScene::Default);
       }
+   };
 
+   virtual void OnUpdate(float ts) override
+   {
+      if (m_Camera.Update(ts))
       {
-         Material brownMat;
-         brownMat.m_Albedo = { 0.5f, 0.25f, 0.0f };
-         brownMat.m_Roughness = 0.1f;
-         brownMat.m_Metallic = 1.0f;
-         brownMat.m_EmissionPower = 0.0f;
-         m_Materials.push_back(brownMat);
+         m_Renderer.ResetFrameIndex();
       }
+   }
 
+   virtual void OnUIRender() override
+   {
+      ImGui::Begin("Settings");
+      ImGui::Text("Last render: %.3fms", m_LastRenderTime);
+      if (m_ViewportImage != nullptr)
       {
-         Material sunMat;
-         sunMat.m_Albedo = { 0.8f, 0.5f, 0.2f };
-         sunMat.m_Roughness = 0.1f;
-         sunMat.m_Metallic = 1.0f;
-         sunMat.m_EmissionPower = 30.0f;
-         m_Materials.push_back(sunMat);
+         ImGui::Text("Last upload: %.1f KB", m_ViewportImage->GetUploadedBytes() / 1024.0);
       }
-#pragma endregion
-
-#pragma region CreateMeshes
+      if (m_ImageExporter.IsBusy())
+      {
+         ImGui::Text("Exporting...");
+      }
+      else if (std::string exportStatus = m_ImageExporter.GetStatus(); not exportStatus.empty())
       {
-         Mesh mesh;
-         mesh.m_Vertices = new Vertex[3];
-         mesh.m_Vertices[0].m_Position = glm::vec3(1.0f, 1.0f, 0.0f);    //Top Right
-         mesh.m_Vertices[1].m_Position = glm::vec3(-1.0f, -1.0f, 0.0f);  //Bottom Left
-         mesh.m_Vertices[2].m_Position = glm::vec3(1.0f, -1.0f, 0.0f);   //Bottom Right
+         ImGui::TextUnformatted(exportStatus.c_str());
+      }
+
+#if RT_ENABLE_RAY_STATISTICS
+      const RayStatistics::FrameStatistics& rayStatistics = m_Renderer.GetRayStatistics();
+      ImGui::Text("%.2f Mrays/s", rayStatistics.GetMraysPerSecond());
+      ImGui::Text("Primary: %" PRIu64 "  Secondary: %" PRIu64, rayStatistics.Counters.PrimaryRays, rayStatistics.Counters.SecondaryRays);
+      ImGui::Text("Sphere tests: %" PRIu64 "  Triangle tests: %" PRIu64, rayStatistics.Counters.SphereTests, rayStatistics.Counters.TriangleTests);
+      ImGui::Text("BVH node tests: %" PRIu64, rayStatistics.Counters.NodeTests);
+      ImGui::Text("Avg. bounce depth: %.2f  Miss rate: %.1f%%", rayStatistics.GetAverageBounceDepth(), rayStatistics.GetMissRate() * 100.0);
+#endif
 
-         glm::vec3 normal = glm::cross(mesh.m_Vertices[0].m_Position - mesh.m_Vertices[1].m_Position, mesh.m_Vertices[0].m_Position - mesh.m_Vertices[2].m_Position);
-         mesh.m_Vertices[0].m_Normal = mesh.m_Vertices[1].m_Normal = mesh.m_Vertices[2].m_Normal = glm::normalize(normal); // All vertices got the same normal obv
+      ImGui::Checkbox("Acuumulate", &m_Renderer.GetSettings().Accumulate);
+
+      Renderer::Settings& settings = m_Renderer.GetSettings();
+      bool resetAccumulation = ImGui::Checkbox("Jitter (anti-aliasing)", &settings.Jitter);
 
-         m_Meshes.push_back(mesh);
+      // Jittered rays go through another point of the pixel every sample and never read cached directions. The cache is
+      // dropped while jitter is on, the chosen mode comes back when it is turned off
+      const char* rayGenerationModes[] = { "Cached", "On the fly" };
+      int rayGenerationMode = (int)(settings.Jitter ? RayGenerationMode::OnTheFly : m_RayGenerationMode);
+      ImGui::BeginDisabled(settings.Jitter);
+      if (ImGui::Combo("Ray generation", &rayGenerationMode, rayGenerationModes, IM_ARRAYSIZE(rayGenerationModes)))
+      {
+         m_RayGenerationMode = (RayGenerationMode)rayGenerationMode;
+      }
+      ImGui::EndDisabled();
+      if (settings.Jitter)
+      {
+         ImGui::SameLine();
+         ImGui::TextDisabled("(set by jitter)");
       }
-#pragma endregion
+      m_Camera.SetRayGenerationMode(settings.Jitter ? RayGenerationMode::OnTheFly : m_RayGenerationMode);
 
-      Entity sphere = m_Scene.CreateEntity("Sphere");
-      Entity floor = m_Scene.CreateEntity("Floor");
-      Entity sun  = m_Scene.CreateEntity("Sun");
-      Entity triangle = m_Scene.CreateEntity("Triangle");
+      const char* filters[] = { "Box", "Tent", "Blackman-Harris" };
+      int filter = (int)settings.Filter;
+      if (ImGui::Combo("Filter", &filter, filters, IM_ARRAYSIZE(filters)))
+      {
+         settings.Filter = (ReconstructionFilter)filter;
+         settings.FilterRadius = Renderer::GetDefaultFilterRadius(settings.Filter);
+         resetAccumulation = true;
+      }
+      resetAccumulation |= ImGui::SliderFloat("Filter radius", &settings.FilterRadius, 0.5f, 3.0f);
+
+#if RT_ENABLE_RAY_STATISTICS
+      const char* debugViews[] = { "None", "Cost heatmap (ns)", "Cost heatmap (tests)" };
+#else
+      const char* debugViews[] = { "None", "Cost heatmap (ns)" };
+#endif
+      int debugView = (int)settings.View;
+      if (ImGui::Combo("Debug view", &debugView, debugViews, IM_ARRAYSIZE(debugViews)))
+      {
+         settings.View = (DebugView)debugView;
+         resetAccumulation = true;
+      }
 
-      // Create Sceneobjects
+      // Switching formats restarts the accumulation
+      const char* accumulationFormats[] = { "RGBA32F (16 B/px)", "RGB16F (10 B/px)", "RGB9E5 (8 B/px)" };
+      int accumulationFormat = (int)settings.Accumulation;
+      if (ImGui::Combo("Accumulation", &accumulationFormat, accumulationFormats, IM_ARRAYSIZE(accumulationFormats)))
       {
-         // Sphere
-         sphere.AddComponent<SphereComponent>(glm::vec3(2.5f, 0.0f, 0.5f), 1.0f);
-         sphere.AddComponent<MaterialComponent>(&m_Materials[0]);
-         
-         // Floor (big Sphere moved down)
-         floor.AddComponent<SphereComponent>(glm::vec3(0.0f, -101.f, 0.0f), 100.0f);
-         floor.AddComponent<MaterialComponent>(&m_Materials[1]);
-         
-         // Sun (Sphere with emissive)
-         sun.AddComponent<SphereComponent>(glm::vec3(25.0f, 4.0f, -25.0f), 20.0f);
-         sun.AddComponent<MaterialComponent>(&m_Materials[2]);
-         
-         // Triangle
-         triangle.AddComponent<MeshComponent>(&m_Meshes[0]);
-         triangle.AddComponent<MaterialComponent>(&m_Materials[0]);
+         settings.Accumulation = (AccumulationFormat)accumulationFormat;
       }
-   };
 
-   virtual void OnUpdate(float ts) override
-   {
-      if (m_Camera.Update(ts))
+      // Spheres switch right away, meshes keep the layout they were created with
+      if (ImGui::Checkbox("Wide BVH (SIMD)", &settings.WideBVH))
       {
-         m_Renderer.ResetFrameIndex();
+         m_Scene->SetWideBVH(settings.WideBVH);
       }
-   }
+      ImGui::Checkbox("Re-render edited regions only", &settings.DirtyRegions);
 
-   virtual void OnUIRender() override
-   {
-      ImGui::Begin("Settings");
-      ImGui::Text("Last render: %.3fms", m_LastRenderTime);
+      // Only the sphere BVH is rebuilt right away, meshes keep the BVH they were created with
+      const char* bvhQualities[] = { "High quality (SAH)", "Fast build (LBVH)" };
+      int bvhQuality = (int)m_Scene->GetBVHBuildQuality();
+      if (ImGui::Combo("BVH build", &bvhQuality, bvhQualities, IM_ARRAYSIZE(bvhQualities)))
+      {
+         m_Scene->SetBVHBuildQuality((BVHBuildQuality)bvhQuality);
+      }
 
-      ImGui::Checkbox("Acuumulate", &m_Renderer.GetSettings().Accumulate);
+      ImGui::Separator();
+      Camera::Lens& lens = m_Camera.GetLens();
+      resetAccumulation |= ImGui::DragFloat("Aperture", &lens.Aperture, 0.01f, 0.0f, 2.0f);
+      resetAccumulation |= ImGui::DragFloat("Focus distance", &lens.FocusDistance, 0.05f, 0.01f, 1000.0f);
+      resetAccumulation |= ImGui::DragFloat("Shutter time", &lens.ShutterTime, 0.005f, 0.0f, 1.0f);
+
+      if (resetAccumulation)
+      {
+         m_Renderer.ResetFrameIndex();
+      }
       if (ImGui::Button("Reset"))
       {
          m_Renderer.ResetFrameIndex();
       }
 
+      // Saved every few seconds of rendering, a render resumed from the file carries on where the checkpoint left off
+      ImGui::Separator();
+      ImGui::InputText("Checkpoint", m_CheckpointFilepath, sizeof(m_CheckpointFilepath));
+      ImGui::DragInt("Save every (s, 0 = off)", &m_CheckpointInterval, 1.0f, 0, 3600);
+      if (ImGui::Button("Resume"))
+      {
+         m_CheckpointStatus = m_Renderer.LoadCheckpoint(m_CheckpointFilepath, *m_Scene, m_Camera)
+                            ? "Resumed at sample " + std::to_string(m_Renderer.GetFrameIndex() - 1)
+                            : "Can't resume, the checkpoint is missing or of another scene, camera or viewport size";
+      }
+      if (not m_CheckpointStatus.empty())
+      {
+         ImGui::TextUnformatted(m_CheckpointStatus.c_str());
+      }
+
+      m_ProfilerPanel.Render();
+
       ImGui::End();
 
       m_SceneHierarchyPanel.RenderSceneHierarchy();
 
+      DrawSceneFileDialog();
+      DrawExportDialog();
+
       ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0.0f, 0.0f));
       ImGui::Begin("Viewport");
 
       m_ViewportWidth  = ImGui::GetContentRegionAvail().x;
       m_ViewportHeight = ImGui::GetContentRegionAvail().y;
 
-      if (auto finalImage = m_Renderer.GetFinalImage())
+      if (m_ViewportImage != nullptr)
       {
-         ImGui::Image(  finalImage->GetDescriptorSet(),
-                        { (float)finalImage->GetWidth(), (float)finalImage->GetHeight() },
+         ImGui::Image(  m_ViewportImage->GetDescriptorSet(),
+                        { (float)m_ViewportImage->GetWidth(), (float)m_ViewportImage->GetHeight() },
                         ImVec2(0, 1), ImVec2(1, 0)); // Flip UVs
+
+         // Picking reads the ID buffer of the last frame, no rays are traced for it. The camera uses the right mouse button
+         if (ImGui::IsItemClicked(ImGuiMouseButton_Left))
+         {
+            ImVec2 mouse = ImGui::GetMousePos();
+            ImVec2 imageMin = ImGui::GetItemRectMin();
+            int x = (int)(mouse.x - imageMin.x);
+            int y = (int)m_ViewportImage->GetHeight() - 1 - (int)(mouse.y - imageMin.y); // The image is drawn flipped
+            uint64_t uuid = (x >= 0 && y >= 0) ? m_Renderer.GetEntityAt((uint32_t)x, (uint32_t)y) : 0;
+            m_SceneHierarchyPanel.SetSelectedEntity(uuid != 0 ? m_Scene->GetEntityByUUID(uuid) : Entity());
+         }
+
+         if (m_Renderer.GetSettings().View != DebugView::None)
+         {
+            DrawHeatmapLegend(ImGui::GetItemRectMin());
+         }
       }
 
       ImGui::End();
@@ -136,50 +218,318 @@ public:
       Render();
    }
 
+   void DrawHeatmapLegend(ImVec2 imageMin)
+   {
+      ImDrawList* drawList = ImGui::GetWindowDrawList();
+
+      const ImVec2 barMin = { imageMin.x + 10.0f, imageMin.y + 10.0f };
+      const ImVec2 barSize = { 200.0f, 12.0f };
+      const uint32_t segments = 16;
+
+      for (uint32_t i = 0; i < segments; i++)
+      {
+         glm::vec3 left = Renderer::GetHeatmapColor((float)i / segments);
+         glm::vec3 right = Renderer::GetHeatmapColor((float)(i + 1) / segments);
+         ImU32 leftColor = ImGui::GetColorU32(ImVec4(left.r, left.g, left.b, 1.0f));
+         ImU32 rightColor = ImGui::GetColorU32(ImVec4(right.r, right.g, right.b, 1.0f));
+
+         ImVec2 segmentMin = { barMin.x + barSize.x * i / segments, barMin.y };
+         ImVec2 segmentMax = { barMin.x + barSize.x * (i + 1) / segments, barMin.y + barSize.y };
+         drawList->AddRectFilledMultiColor(segmentMin, segmentMax, leftColor, rightColor, rightColor, leftColor);
+      }
+
+      const char* unit = (m_Renderer.GetSettings().View == DebugView::CostTime) ? "ns" : "tests";
+      glm::vec2 range = m_Renderer.GetCostRange();
+
+      char text[64];
+      snprintf(text, sizeof(text), "%.0f %s", range.x, unit);
+      drawList->AddText({ barMin.x, barMin.y + barSize.y + 2.0f }, IM_COL32(255, 255, 255, 255), text);
+      snprintf(text, sizeof(text), "%.0f %s", range.y, unit);
+      drawList->AddText({ barMin.x + barSize.x - ImGui::CalcTextSize(text).x, barMin.y + barSize.y + 2.0f }, IM_COL32(255, 255, 255, 255), text);
+   }
+
+   enum class SceneFileDialog
+   {
+      None = 0,
+      Open,
+      Save,
+   };
+
+   // Called from the menu bar, the popup itself has to be opened from inside the layer's UI
+   void RequestSceneFileDialog(SceneFileDialog dialog)
+   {
+      m_RequestedDialog = dialog;
+   }
+
+   // The format follows the extension, .rtscene is the binary format and anything else is JSON
+   bool OpenScene(const std::string& filepath)
+   {
+      // Loaded next to the current scene, which is kept when loading fails
+      std::unique_ptr<Scene> scene = std::make_unique<Scene>();
+      scene->SetWideBVH(m_Renderer.GetSettings().WideBVH);
+      if (IsBinarySceneFile(filepath))
+      {
+         if (not SceneBinarySerializer(scene.get()).Deserialize(filepath))
+         {
+            m_SceneFileError = "Failed to load '" + filepath + "'";
+            return false;
+         }
+      }
+      else
+      {
+         SceneSerializer serializer(scene.get());
+         if (not serializer.Deserialize(filepath))
+         {
+            m_SceneFileError = serializer.GetError();
+            return false;
+         }
+      }
+
+      m_Scene = std::move(scene);
+      m_SceneHierarchyPanel.SetScene(m_Scene.get());
+      m_Renderer.ResetFrameIndex();
+      return true;
+   }
+
+   bool SaveScene(const std::string& filepath)
+   {
+      if (IsBinarySceneFile(filepath))
+      {
+         if (not SceneBinarySerializer(m_Scene.get()).Serialize(filepath))
+         {
+            m_SceneFileError = "Failed to write '" + filepath + "'";
+            return false;
+         }
+         return true;
+      }
+
+      SceneSerializer serializer(m_Scene.get());
+      if (not serializer.Serialize(filepath))
+      {
+         m_SceneFileError = serializer.GetError();
+         return false;
+      }
+      return true;
+   }
+
+   static bool IsBinarySceneFile(const std::string& filepath)
+   {
+      return std::filesystem::path(filepath).extension() == ".rtscene";
+   }
+
+   void DrawSceneFileDialog()
+   {
+      if (m_RequestedDialog != SceneFileDialog::None)
+      {
+         m_ActiveDialog = m_RequestedDialog;
+         m_RequestedDialog = SceneFileDialog::None;
+         m_SceneFileError.clear();
+         ImGui::OpenPopup("Scene file");
+      }
+
+      if (ImGui::BeginPopupModal("Scene file", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+      {
+         const bool open = (m_ActiveDialog == SceneFileDialog::Open);
+         ImGui::Text(open ? "Open scene (.json or .rtscene)" : "Save scene as (.json or .rtscene)");
+         ImGui::InputText("Path", m_SceneFilepath, sizeof(m_SceneFilepath));
+
+         if (not m_SceneFileError.empty())
+         {
+            ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%s", m_SceneFileError.c_str());
+         }
+
+         if (ImGui::Button(open ? "Open" : "Save"))
+         {
+            bool succeeded = open ? OpenScene(m_SceneFilepath) : SaveScene(m_SceneFilepath);
+            if (succeeded)
+            {
+               ImGui::CloseCurrentPopup();
+            }
+         }
+         ImGui::SameLine();
+         if (ImGui::Button("Cancel"))
+         {
+            ImGui::CloseCurrentPopup();
+         }
+
+         ImGui::EndPopup();
+      }
+   }
+
+   void RequestExportDialog()
+   {
+      m_ExportDialogRequested = true;
+   }
+
+   void DrawExportDialog()
+   {
+      if (m_ExportDialogRequested)
+      {
+         m_ExportDialogRequested = false;
+         m_ExportError.clear();
+         ImGui::OpenPopup("Export image");
+      }
+
+      if (ImGui::BeginPopupModal("Export image", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+      {
+         ImGui::Text("Export as .png (displayed image), .pfm or .exr (linear color)");
+         ImGui::InputText("Path", m_ExportFilepath, sizeof(m_ExportFilepath));
+         ImGui::Checkbox("Half float (.exr)", &m_ExportHalfFloat);
+
+         if (not m_ExportError.empty())
+         {
+            ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%s", m_ExportError.c_str());
+         }
+
+         // Written in the background, the status shows up in the settings panel
+         if (ImGui::Button("Export"))
+         {
+            if (m_ImageExporter.Export(m_Renderer, m_ExportFilepath, m_ExportHalfFloat))
+            {
+               ImGui::CloseCurrentPopup();
+            }
+            else
+            {
+               m_ExportError = "Can't export to '" + std::string(m_ExportFilepath) + "', use .png, .pfm or .exr";
+            }
+         }
+         ImGui::SameLine();
+         if (ImGui::Button("Cancel"))
+         {
+            ImGui::CloseCurrentPopup();
+         }
+
+         ImGui::EndPopup();
+      }
+   }
+
    void Render()
    {
       Timer timer;
 
       // Render
       {
+         PROFILE_SCOPE(ProfileStage::Frame);
+
          // Resize if needed
          {
             m_Renderer.Resize(m_ViewportWidth, m_ViewportHeight);
             m_Camera.Resize(m_ViewportWidth, m_ViewportHeight);
          }
 
-         m_Renderer.Render(m_Scene, m_Camera);
+         Entity selectedEntity = m_SceneHierarchyPanel.GetSelectedEntity();
+         m_Renderer.SetOutlinedEntity(selectedEntity ? (uint64_t)selectedEntity.GetUUID() : 0);
+         m_Renderer.Render(*m_Scene, m_Camera);
+         UploadViewportImage();
       }
 
       m_LastRenderTime = timer.ElapsedMillis();
+
+      // Between frames, so the accumulation doesn't change while it's written
+      if (m_CheckpointInterval > 0 && m_CheckpointTimer.Elapsed() >= (float)m_CheckpointInterval)
+      {
+         m_CheckpointStatus = m_Renderer.SaveCheckpoint(m_CheckpointFilepath)
+                            ? "Checkpoint saved at sample " + std::to_string(m_Renderer.GetFrameIndex() - 1)
+                            : "Could not write '" + std::string(m_CheckpointFilepath) + "'";
+         m_CheckpointTimer.Reset();
+      }
+
+      Profiler::EndFrame();
+   }
+
+   // Copies the pixels the renderer changed since the last upload to the GPU image the viewport shows
+   void UploadViewportImage()
+   {
+      PROFILE_SCOPE(ProfileStage::Upload);
+
+      if (m_ViewportImage == nullptr)
+      {
+         m_ViewportImage = std::make_unique<ViewportImage>(m_Renderer.GetWidth(), m_Renderer.GetHeight()); // 4 bytes per pixel
+      }
+      else
+      {
+         m_ViewportImage->Resize(m_Renderer.GetWidth(), m_Renderer.GetHeight());
+      }
+
+      bool allChanged = false;
+      for (const Renderer::PixelRegion& region : m_Renderer.ConsumeDisplayChanges(allChanged))
+      {
+         m_ViewportImage->MarkDirty(region.MinX, region.MinY, region.MaxX, region.MaxY);
+      }
+      if (allChanged)
+      {
+         m_ViewportImage->MarkAllDirty();
+      }
+      m_ViewportImage->Upload(m_Renderer.GetDisplayData());
    }
 
 private:
    Renderer m_Renderer;
+   std::unique_ptr<ViewportImage> m_ViewportImage;
    Camera m_Camera;
-   Scene m_Scene;
+   RayGenerationMode m_RayGenerationMode = RayGenerationMode::Cached; // Chosen in the UI, jitter overrides it
+   std::unique_ptr<Scene> m_Scene = std::make_unique<Scene>();
    SceneHierarchyPanel m_SceneHierarchyPanel;
-
-   // Should be in some sort of assetmanager class
-   std::vector<Material> m_Materials;
-   std::vector<Mesh> m_Meshes;
+   ProfilerPanel m_ProfilerPanel;
 
    uint32_t m_ViewportWidth = 0, m_ViewportHeight = 0;
 
    float m_LastRenderTime = 0.0f;
+
+   SceneFileDialog m_RequestedDialog = SceneFileDialog::None;
+   SceneFileDialog m_ActiveDialog = SceneFileDialog::None;
+   char m_SceneFilepath[512] = "scene.json";
+   std::string m_SceneFileError;
+
+   ImageExporter m_ImageExporter;
+   bool m_ExportDialogRequested = false;
+   char m_ExportFilepath[512] = "render.png";
+   bool m_ExportHalfFloat = true;
+   std::string m_ExportError;
+
+   char m_CheckpointFilepath[512] = "render.rtcheckpoint";
+   int m_CheckpointInterval = 0; // Seconds
+   Timer m_CheckpointTimer;
+   std::string m_CheckpointStatus;
 };
 
 Walnut::Application* Walnut::CreateApplication(int argc, char** argv)
 {
+   // The window (and the GPU) is only set up by the application, a headless run never creates one
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "--headless") == 0)
+      {
+         std::exit(HeadlessApp::Run(argc, argv));
+      }
+   }
+
    Walnut::ApplicationSpecification spec;
    spec.Name = "CPU RayTracing";
 
+   // RayTracing [scene.rtscene]
+   std::string sceneFilepath = (argc > 1) ? argv[1] : "";
+
    Walnut::Application* app = new Walnut::Application(spec);
-   app->PushLayer<ExampleLayer>();
-   app->SetMenubarCallback([app]()
+   std::shared_ptr<ExampleLayer> layer = std::make_shared<ExampleLayer>(sceneFilepath);
+   app->PushLayer(layer);
+   app->SetMenubarCallback([app, layer]()
    {
       if (ImGui::BeginMenu("File"))
       {
+         if (ImGui::MenuItem("Open..."))
+         {
+            layer->RequestSceneFileDialog(ExampleLayer::SceneFileDialog::Open);
+         }
+         if (ImGui::MenuItem("Save As..."))
+         {
+            layer->RequestSceneFileDialog(ExampleLayer::SceneFileDialog::Save);
+         }
+         if (ImGui::MenuItem("Export Image..."))
+         {
+            layer->RequestExportDialog();
+         }
+         ImGui::Separator();
          if (ImGui::MenuItem("Exit"))
          {
             app->Close();
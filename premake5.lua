@@ -7,4 +7,5 @@ workspace "RayTracing"
 outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
 include "Walnut/WalnutExternal.lua"
 
-include "RayTracing"
\ No newline at end of file
+include "RayTracing"
+include "Benchmarks"
\ No newline at end of file